@@ -1,6 +1,10 @@
 #include <SFML/Graphics.hpp>
 #include <vector>
 #include <optional> // SFML 3 uses std::optional for events + intersections
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "ShapeBatch.h"
 
 struct RoomExit {
     int left = -1, right = -1, up = -1, down = -1;
@@ -116,9 +120,43 @@ static void addBorderWallsWithDoors(Room& r, sf::Vector2u win, float thick = 8.f
     }
 }
 
-int main() {
-    sf::RenderWindow window(sf::VideoMode({320u, 210u}), "Adventure Clone");
-    window.setFramerateLimit(60);
+// Headless runs walk a fixed loop instead of reading the keyboard: out of
+// the center room through its bottom gap, through the doors left and back,
+// then up into the box again, so each lap visits rooms 4, 7, 6, 7 and 4
+sf::Vector2f scriptedMove(long long frame) {
+    switch (frame / 100 % 4) {
+        case 0: return {0.f, 1.f};
+        case 1: return {-1.f, 0.f};
+        case 2: return {1.f, 0.f};
+        default: return {0.f, -1.f};
+    }
+}
+
+// Usage: Adventure [--headless <frames>] [--save-frame <file.png>]
+// --headless renders that many frames into an offscreen texture instead of
+// a window, at a fixed 60 Hz step with the scripted walk above;
+// --save-frame then writes the last frame out. The texture still needs an
+// OpenGL context, so on a machine without a display run it under Xvfb
+// (xvfb-run -a) or with an EGL build of SFML.
+int main(int argc, char* argv[]) {
+    long long headlessFrames = -1;
+    const char* saveFramePath = nullptr;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0) headlessFrames = std::atoll(argv[++i]);
+        else if (std::strcmp(argv[i], "--save-frame") == 0) saveFramePath = argv[++i];
+    }
+    const bool headless = headlessFrames >= 0;
+
+    // Both are render targets; the game only draws to whichever is in use
+    std::optional<sf::RenderWindow> window;
+    std::optional<sf::RenderTexture> offscreen;
+    if (headless) {
+        offscreen.emplace(sf::Vector2u{320u, 210u});
+    } else {
+        window.emplace(sf::VideoMode({320u, 210u}), "Adventure Clone");
+        window->setFramerateLimit(60);
+    }
+    sf::RenderTarget& target = headless ? static_cast<sf::RenderTarget&>(*offscreen) : *window;
 
     World world;
     world.rooms.reserve(9);
@@ -140,7 +178,7 @@ int main() {
     }
 
     auto idx = [](int x, int y) { return y * 3 + x; };
-    const auto winSize = window.getSize();
+    const auto winSize = target.getSize();
 
     // exits + border walls
     for (int y = 0; y < 3; y++) {
@@ -203,41 +241,44 @@ int main() {
     world.currentRoom = 4;
 
     Player player;
-    player.pos = {155.f, 105.f};
+    player.pos = {155.f, 122.f}; // Below the pillar, above the gap out of the box
+
+    ShapeBatch shapes;
 
     sf::Clock clock;
-    while (window.isOpen()) {
+    for (long long frame = 0; headless ? frame < headlessFrames : window->isOpen(); ++frame) {
 
-        while (const std::optional<sf::Event> event = window.pollEvent()) {
-            if (event->is<sf::Event::Closed>()) window.close();
-        }
+        sf::Vector2f move(0.f, 0.f);
+        float dt = 1.f / 60.f;
+        if (headless) {
+            move = scriptedMove(frame);
+        } else {
+            while (const std::optional<sf::Event> event = window->pollEvent()) {
+                if (event->is<sf::Event::Closed>()) window->close();
+            }
 
-        float dt = clock.restart().asSeconds();
+            dt = clock.restart().asSeconds();
 
-        sf::Vector2f move(0.f, 0.f);
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Left))  { move.x -= 1.f; }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Right)) { move.x += 1.f; }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Up))    { move.y -= 1.f; }
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Down))  { move.y += 1.f; }
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Left))  { move.x -= 1.f; }
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Right)) { move.x += 1.f; }
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Up))    { move.y -= 1.f; }
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Down))  { move.y += 1.f; }
+        }
 
         if (move.x != 0 && move.y != 0) move *= 0.7071f;
 
         moveWithCollision(player, world.room(), move * player.speed * dt);
-        handleRoomTransition(player, world, window.getSize());
+        handleRoomTransition(player, world, target.getSize());
 
-        window.clear(world.room().bg);
+        target.clear(world.room().bg);
 
+        // Walls, player and minimap all go out in one draw call
+        shapes.Clear();
         for (const auto& w : world.room().walls) {
-            sf::RectangleShape wall(w.size);
-            wall.setPosition(w.position);
-            wall.setFillColor(sf::Color(200, 200, 200));
-            window.draw(wall);
+            shapes.AddRect(w.position, w.size, sf::Color(200, 200, 200));
         }
 
-        sf::RectangleShape pr(player.size);
-        pr.setPosition(player.pos);
-        pr.setFillColor(sf::Color::Yellow);
-        window.draw(pr);
+        shapes.AddRect(player.pos, player.size, sf::Color::Yellow);
 
         // minimap
         {
@@ -248,14 +289,22 @@ int main() {
             for (int y = 0; y < gridH; y++) {
                 for (int x = 0; x < gridW; x++) {
                     int id = y * gridW + x;
-                    sf::RectangleShape c({cell, cell});
-                    c.setPosition({origin.x + x * (cell + 2.f), origin.y + y * (cell + 2.f)});
-                    c.setFillColor(id == world.currentRoom ? sf::Color::Yellow : sf::Color(120, 120, 120));
-                    window.draw(c);
+                    shapes.AddRect({origin.x + x * (cell + 2.f), origin.y + y * (cell + 2.f)}, {cell, cell},
+                                   id == world.currentRoom ? sf::Color::Yellow : sf::Color(120, 120, 120));
                 }
             }
         }
 
-        window.display();
+        target.draw(shapes);
+
+        if (headless) offscreen->display();
+        else window->display();
+    }
+
+    if (saveFramePath && headless && !offscreen->getTexture().copyToImage().saveToFile(saveFramePath)) {
+        std::cerr << "Could not write " << saveFramePath << std::endl;
+        return 1;
     }
+
+    return 0;
 }
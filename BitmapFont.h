@@ -0,0 +1,279 @@
+#ifndef BITMAPFONT_H
+#define BITMAPFONT_H
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Fixed-width 8x8 font covering printable ASCII (font8x8_basic, public
+// domain). The glyph bits are what Graphics::DrawText blits into the CPU
+// back buffer; for SFML render targets the constructor bakes them once into
+// a white-on-transparent atlas texture that TextBatch draws quads from.
+class BitmapFont
+{
+public:
+    static constexpr int GlyphSize = 8;
+    static constexpr char FirstChar = ' ';
+    static constexpr char LastChar = '~';
+    static constexpr int GlyphCount = LastChar - FirstChar + 1;
+    static constexpr int AtlasColumns = 16;
+    static constexpr int AtlasRows = (GlyphCount + AtlasColumns - 1) / AtlasColumns;
+
+    // Eight rows for c, one byte each with bit 0 the leftmost pixel;
+    // characters outside the font get '?'
+    static const std::uint8_t* GetGlyph( char c )
+    {
+        if( c < FirstChar || c > LastChar )
+        {
+            c = '?';
+        }
+        return Glyphs[c - FirstChar];
+    }
+    // Top-left of c's cell in the atlas texture
+    static sf::Vector2f GetAtlasPosition( char c )
+    {
+        if( c < FirstChar || c > LastChar )
+        {
+            c = '?';
+        }
+        const int i = c - FirstChar;
+        return { static_cast<float>(i % AtlasColumns * GlyphSize), static_cast<float>(i / AtlasColumns * GlyphSize) };
+    }
+
+public:
+    // Needs a GL context, so construct it after the window
+    BitmapFont()
+        : texture( sf::Vector2u( AtlasColumns * GlyphSize, AtlasRows * GlyphSize ) )
+    {
+        const int atlasWidth = AtlasColumns * GlyphSize;
+        std::vector<std::uint32_t> pixels( std::size_t( atlasWidth ) * AtlasRows * GlyphSize, 0u );
+        for( int i = 0; i < GlyphCount; ++i )
+        {
+            const int left = i % AtlasColumns * GlyphSize;
+            const int top = i / AtlasColumns * GlyphSize;
+            for( int row = 0; row < GlyphSize; ++row )
+            {
+                for( int col = 0; col < GlyphSize; ++col )
+                {
+                    if( (Glyphs[i][row] >> col & 1u) != 0u )
+                    {
+                        // Opaque white; vertex colors tint it
+                        pixels[(top + row) * atlasWidth + left + col] = 0xFFFFFFFFu;
+                    }
+                }
+            }
+        }
+        texture.update( reinterpret_cast<const std::uint8_t*>(pixels.data()), texture.getSize(), { 0u, 0u } );
+    }
+    const sf::Texture& GetTexture() const
+    {
+        return texture;
+    }
+
+private:
+    static constexpr std::uint8_t Glyphs[GlyphCount][GlyphSize] = {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },    // ' '
+        { 0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00 },    // '!'
+        { 0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },    // '"'
+        { 0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00 },    // '#'
+        { 0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00 },    // '$'
+        { 0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00 },    // '%'
+        { 0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00 },    // '&'
+        { 0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00 },    // '''
+        { 0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00 },    // '('
+        { 0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00 },    // ')'
+        { 0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00 },    // '*'
+        { 0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00 },    // '+'
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06 },    // ','
+        { 0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00 },    // '-'
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00 },    // '.'
+        { 0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00 },    // '/'
+        { 0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00 },    // '0'
+        { 0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00 },    // '1'
+        { 0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00 },    // '2'
+        { 0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00 },    // '3'
+        { 0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00 },    // '4'
+        { 0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00 },    // '5'
+        { 0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00 },    // '6'
+        { 0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00 },    // '7'
+        { 0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00 },    // '8'
+        { 0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00 },    // '9'
+        { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00 },    // ':'
+        { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06 },    // ';'
+        { 0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00 },    // '<'
+        { 0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00 },    // '='
+        { 0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00 },    // '>'
+        { 0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00 },    // '?'
+        { 0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00 },    // '@'
+        { 0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00 },    // 'A'
+        { 0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00 },    // 'B'
+        { 0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00 },    // 'C'
+        { 0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00 },    // 'D'
+        { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00 },    // 'E'
+        { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00 },    // 'F'
+        { 0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00 },    // 'G'
+        { 0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00 },    // 'H'
+        { 0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },    // 'I'
+        { 0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00 },    // 'J'
+        { 0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00 },    // 'K'
+        { 0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00 },    // 'L'
+        { 0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00 },    // 'M'
+        { 0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00 },    // 'N'
+        { 0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00 },    // 'O'
+        { 0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00 },    // 'P'
+        { 0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00 },    // 'Q'
+        { 0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00 },    // 'R'
+        { 0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00 },    // 'S'
+        { 0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },    // 'T'
+        { 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00 },    // 'U'
+        { 0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 },    // 'V'
+        { 0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00 },    // 'W'
+        { 0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00 },    // 'X'
+        { 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00 },    // 'Y'
+        { 0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00 },    // 'Z'
+        { 0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00 },    // '['
+        { 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00 },    // backslash
+        { 0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00 },    // ']'
+        { 0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00 },    // '^'
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF },    // '_'
+        { 0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },    // '`'
+        { 0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00 },    // 'a'
+        { 0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00 },    // 'b'
+        { 0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00 },    // 'c'
+        { 0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00 },    // 'd'
+        { 0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00 },    // 'e'
+        { 0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00 },    // 'f'
+        { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F },    // 'g'
+        { 0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00 },    // 'h'
+        { 0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },    // 'i'
+        { 0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E },    // 'j'
+        { 0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00 },    // 'k'
+        { 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },    // 'l'
+        { 0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00 },    // 'm'
+        { 0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00 },    // 'n'
+        { 0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00 },    // 'o'
+        { 0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F },    // 'p'
+        { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78 },    // 'q'
+        { 0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00 },    // 'r'
+        { 0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00 },    // 's'
+        { 0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00 },    // 't'
+        { 0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00 },    // 'u'
+        { 0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 },    // 'v'
+        { 0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00 },    // 'w'
+        { 0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00 },    // 'x'
+        { 0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F },    // 'y'
+        { 0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00 },    // 'z'
+        { 0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00 },    // '{'
+        { 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00 },    // '|'
+        { 0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00 },    // '}'
+        { 0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },    // '~'
+    };
+
+private:
+    sf::Texture texture;
+};
+
+// Glyph quads for any number of strings, drawn with a single draw call.
+// Clear keeps the vertex storage, so a batch rebuilt every frame stops
+// allocating once it has seen its largest frame.
+class TextBatch : public sf::Drawable
+{
+public:
+    explicit TextBatch( const BitmapFont& font )
+        : font( font ),
+          vertices( sf::PrimitiveType::Triangles )
+    {
+    }
+    void Clear()
+    {
+        vertices.clear();
+    }
+    // Top-left of the first glyph at pos; '\n' starts a new line
+    void Add( std::string_view text, sf::Vector2f pos, sf::Color color = sf::Color::White, float scale = 1.0f )
+    {
+        const float size = BitmapFont::GlyphSize * scale;
+        const float cell = static_cast<float>(BitmapFont::GlyphSize);
+        sf::Vector2f pen = pos;
+        for( const char c : text )
+        {
+            if( c == '\n' )
+            {
+                pen = { pos.x, pen.y + size };
+                continue;
+            }
+            if( c != ' ' )
+            {
+                const sf::Vector2f uv = BitmapFont::GetAtlasPosition( c );
+                const sf::Vertex topLeft{ pen, color, uv };
+                const sf::Vertex topRight{ { pen.x + size, pen.y }, color, { uv.x + cell, uv.y } };
+                const sf::Vertex bottomLeft{ { pen.x, pen.y + size }, color, { uv.x, uv.y + cell } };
+                const sf::Vertex bottomRight{ { pen.x + size, pen.y + size }, color, { uv.x + cell, uv.y + cell } };
+                vertices.append( topLeft );
+                vertices.append( topRight );
+                vertices.append( bottomLeft );
+                vertices.append( bottomLeft );
+                vertices.append( topRight );
+                vertices.append( bottomRight );
+            }
+            pen.x += size;
+        }
+    }
+    std::size_t GetGlyphCount() const
+    {
+        return vertices.getVertexCount() / 6u;
+    }
+
+private:
+    void draw( sf::RenderTarget& target, sf::RenderStates states ) const override
+    {
+        states.texture = &font.GetTexture();
+        target.draw( vertices, states );
+    }
+
+private:
+    const BitmapFont& font;
+    sf::VertexArray vertices;
+};
+
+// A label that keeps its quads between frames and only rebuilds them when
+// its text, position, color or scale actually change
+class CachedText : public sf::Drawable
+{
+public:
+    explicit CachedText( const BitmapFont& font )
+        : batch( font )
+    {
+    }
+    void Set( std::string_view newText, sf::Vector2f newPos, sf::Color newColor = sf::Color::White, float newScale = 1.0f )
+    {
+        if( built && newText == text && newPos == pos && newColor == color && newScale == scale )
+        {
+            return;
+        }
+        text.assign( newText );
+        pos = newPos;
+        color = newColor;
+        scale = newScale;
+        batch.Clear();
+        batch.Add( text, pos, color, scale );
+        built = true;
+    }
+
+private:
+    void draw( sf::RenderTarget& target, sf::RenderStates states ) const override
+    {
+        target.draw( batch, states );
+    }
+
+private:
+    TextBatch batch;
+    std::string text;
+    sf::Vector2f pos;
+    sf::Color color;
+    float scale = 1.0f;
+    bool built = false;
+};
+
+#endif
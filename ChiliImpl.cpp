@@ -1,11 +1,45 @@
 #include "Mainwindow.h"
 #include "Game.h"
 #include "Graphics.h"
+#include "Surface.h"
+#include "WorkerPool.h"
+#include "FrameProfiler.h"
+#include "PostProcess.h"
+#include "FrameRecorder.h"
+#include "BitmapFont.h"
+#include "Raster.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+#include <immintrin.h>
+#endif
 
 // Mainwindow Implementation
-MainWindow::MainWindow( int width, int height, const char* title )
-    : window( sf::VideoMode( {static_cast<unsigned int>(width), static_cast<unsigned int>(height)} ), title )
+MainWindow::MainWindow( int width, int height, const char* title, Backend backend )
+    : width( width ),
+      height( height )
 {
+    if( backend == Backend::Window )
+    {
+        window.emplace( sf::VideoMode( {static_cast<unsigned int>(width), static_cast<unsigned int>(height)} ), title );
+    }
+    else
+    {
+        headlessFrame.assign( std::size_t( width ) * height, Colors::Black.dword );
+    }
 }
 
 MainWindow::~MainWindow()
@@ -14,84 +48,3704 @@ MainWindow::~MainWindow()
 
 bool MainWindow::IsOpen() const
 {
-    return window.isOpen();
+    return window ? window->isOpen() : open;
 }
 
 void MainWindow::Close()
 {
-    window.close();
+    if( window )
+    {
+        window->close();
+    }
+    open = false;
+}
+
+bool MainWindow::IsHeadless() const
+{
+    return !window;
+}
+
+int MainWindow::GetWidth() const
+{
+    return width;
+}
+
+int MainWindow::GetHeight() const
+{
+    return height;
 }
 
 sf::RenderWindow& MainWindow::GetWindow()
 {
-    return window;
+    return *window;
+}
+
+std::optional<sf::Event> MainWindow::PollEvent()
+{
+    std::optional<sf::Event> event;
+    if( nextScripted < scriptedEvents.size() && scriptedEvents[nextScripted].first <= frameIndex )
+    {
+        event = scriptedEvents[nextScripted++].second;
+    }
+    else if( window )
+    {
+        event = window->pollEvent();
+    }
+    if( event )
+    {
+        input.Feed( *event );
+    }
+    return event;
+}
+
+void MainWindow::ScriptEvent( std::uint64_t frame, const sf::Event& event )
+{
+    const auto pos = std::upper_bound( scriptedEvents.begin() + nextScripted, scriptedEvents.end(), frame,
+        []( std::uint64_t f, const std::pair<std::uint64_t, sf::Event>& e ) { return f < e.first; } );
+    scriptedEvents.insert( pos, { frame, event } );
+}
+
+std::uint64_t MainWindow::GetFrameIndex() const
+{
+    return frameIndex;
+}
+
+void MainWindow::PresentRect( const std::uint32_t* pSrc, int srcPitch, int x, int y, int w, int h )
+{
+    std::uint32_t* pDst = headlessFrame.data() + std::size_t( y ) * width + x;
+    for( int row = 0; row < h; ++row, pSrc += srcPitch, pDst += width )
+    {
+        std::memcpy( pDst, pSrc, sizeof( std::uint32_t ) * w );
+    }
+}
+
+void MainWindow::Display()
+{
+    if( window )
+    {
+        window->display();
+    }
+}
+
+void MainWindow::FinishFrame()
+{
+    ++frameIndex;
+}
+
+const std::vector<std::uint32_t>& MainWindow::GetFrame() const
+{
+    return headlessFrame;
+}
+
+bool MainWindow::SaveFrame( const std::string& path ) const
+{
+    std::ofstream out( path, std::ios::binary );
+    if( !out || headlessFrame.empty() )
+    {
+        return false;
+    }
+    out << "P6\n" << width << ' ' << height << "\n255\n";
+    std::vector<char> row( std::size_t( width ) * 3 );
+    for( int y = 0; y < height; ++y )
+    {
+        for( int x = 0; x < width; ++x )
+        {
+            const Color c( headlessFrame[std::size_t( y ) * width + x] );
+            row[x * 3] = static_cast<char>(c.GetR());
+            row[x * 3 + 1] = static_cast<char>(c.GetG());
+            row[x * 3 + 2] = static_cast<char>(c.GetB());
+        }
+        out.write( row.data(), static_cast<std::streamsize>(row.size()) );
+    }
+    return static_cast<bool>(out);
 }
 
 // Graphics Implementation
+namespace
+{
+    // Cache-line alignment keeps every row start friendly to wide stores
+    constexpr std::size_t SysBufferAlignment = 64u;
+
+    using namespace Raster;
+
+    // Exact round( x / 255 ) for x in [0, 255 * 255]; the SIMD kernels use
+    // the same sequence so every path produces identical bytes
+    inline std::uint32_t Div255( std::uint32_t x )
+    {
+        x += 128u;
+        return (x + (x >> 8)) >> 8;
+    }
+
+    // Premultiplied "over": dst = src + dst * (255 - srcAlpha) / 255, per channel
+    inline std::uint32_t BlendOver( std::uint32_t src, std::uint32_t dst )
+    {
+        const std::uint32_t inv = 255u - (src >> 24);
+        std::uint32_t out = 0u;
+        for( int shift = 0; shift < 32; shift += 8 )
+        {
+            const std::uint32_t channel = ((src >> shift) & 0xFFu) + Div255( ((dst >> shift) & 0xFFu) * inv );
+            out |= std::min( channel, 255u ) << shift;
+        }
+        return out;
+    }
+
+    void BlitRowColorKey( std::uint32_t* pDst, const std::uint32_t* pSrc, int count, std::uint32_t key )
+    {
+#if defined( __AVX2__ )
+        const __m256i keys = _mm256_set1_epi32( static_cast<int>(key) );
+        for( ; count >= 8; count -= 8, pDst += 8, pSrc += 8 )
+        {
+            const __m256i src = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pSrc) );
+            const __m256i dst = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pDst) );
+            const __m256i isKey = _mm256_cmpeq_epi32( src, keys );
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDst), _mm256_blendv_epi8( src, dst, isKey ) );
+        }
+#elif defined( __SSE2__ )
+        const __m128i keys = _mm_set1_epi32( static_cast<int>(key) );
+        for( ; count >= 4; count -= 4, pDst += 4, pSrc += 4 )
+        {
+            const __m128i src = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pSrc) );
+            const __m128i dst = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pDst) );
+            const __m128i isKey = _mm_cmpeq_epi32( src, keys );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst),
+                _mm_or_si128( _mm_and_si128( isKey, dst ), _mm_andnot_si128( isKey, src ) ) );
+        }
+#endif
+        for( ; count > 0; --count, ++pDst, ++pSrc )
+        {
+            if( *pSrc != key )
+            {
+                *pDst = *pSrc;
+            }
+        }
+    }
+
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+    // dst * (255 - srcAlpha) / 255 + src for four pixels
+    inline __m128i BlendOver4( __m128i src, __m128i dst )
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i inv = _mm_srli_epi32( src, 24 );
+        inv = _mm_sub_epi16( _mm_set1_epi16( 255 ), _mm_or_si128( inv, _mm_slli_epi32( inv, 16 ) ) );
+        const __m128i bias = _mm_set1_epi16( 128 );
+        __m128i lo = _mm_mullo_epi16( _mm_unpacklo_epi8( dst, zero ), _mm_unpacklo_epi32( inv, inv ) );
+        __m128i hi = _mm_mullo_epi16( _mm_unpackhi_epi8( dst, zero ), _mm_unpackhi_epi32( inv, inv ) );
+        lo = _mm_add_epi16( lo, bias );
+        hi = _mm_add_epi16( hi, bias );
+        lo = _mm_srli_epi16( _mm_add_epi16( lo, _mm_srli_epi16( lo, 8 ) ), 8 );
+        hi = _mm_srli_epi16( _mm_add_epi16( hi, _mm_srli_epi16( hi, 8 ) ), 8 );
+        return _mm_adds_epu8( src, _mm_packus_epi16( lo, hi ) );
+    }
+#endif
+
+#if defined( __AVX2__ )
+    inline __m256i BlendOver8( __m256i src, __m256i dst )
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i inv = _mm256_srli_epi32( src, 24 );
+        inv = _mm256_sub_epi16( _mm256_set1_epi16( 255 ), _mm256_or_si256( inv, _mm256_slli_epi32( inv, 16 ) ) );
+        const __m256i bias = _mm256_set1_epi16( 128 );
+        __m256i lo = _mm256_mullo_epi16( _mm256_unpacklo_epi8( dst, zero ), _mm256_unpacklo_epi32( inv, inv ) );
+        __m256i hi = _mm256_mullo_epi16( _mm256_unpackhi_epi8( dst, zero ), _mm256_unpackhi_epi32( inv, inv ) );
+        lo = _mm256_add_epi16( lo, bias );
+        hi = _mm256_add_epi16( hi, bias );
+        lo = _mm256_srli_epi16( _mm256_add_epi16( lo, _mm256_srli_epi16( lo, 8 ) ), 8 );
+        hi = _mm256_srli_epi16( _mm256_add_epi16( hi, _mm256_srli_epi16( hi, 8 ) ), 8 );
+        return _mm256_adds_epu8( src, _mm256_packus_epi16( lo, hi ) );
+    }
+#endif
+
+    void BlitRowAlpha( std::uint32_t* pDst, const std::uint32_t* pSrc, int count )
+    {
+        // Sprites are mostly fully opaque or fully clear, so check alpha of
+        // a whole group first and only do the multiply when it is mixed
+#if defined( __AVX2__ )
+        const __m256i alphaMask = _mm256_set1_epi32( static_cast<int>(0xFF000000u) );
+        for( ; count >= 8; count -= 8, pDst += 8, pSrc += 8 )
+        {
+            const __m256i src = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pSrc) );
+            const __m256i alpha = _mm256_and_si256( src, alphaMask );
+            if( _mm256_movemask_epi8( _mm256_cmpeq_epi32( alpha, alphaMask ) ) == -1 )
+            {
+                _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDst), src );
+            }
+            else if( _mm256_testz_si256( src, src ) == 0 )
+            {
+                const __m256i dst = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pDst) );
+                _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDst), BlendOver8( src, dst ) );
+            }
+        }
+#endif
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+        const __m128i alphaMask4 = _mm_set1_epi32( static_cast<int>(0xFF000000u) );
+        for( ; count >= 4; count -= 4, pDst += 4, pSrc += 4 )
+        {
+            const __m128i src = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pSrc) );
+            const __m128i alpha = _mm_and_si128( src, alphaMask4 );
+            if( _mm_movemask_epi8( _mm_cmpeq_epi32( alpha, alphaMask4 ) ) == 0xFFFF )
+            {
+                _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst), src );
+            }
+            else if( _mm_movemask_epi8( _mm_cmpeq_epi32( src, _mm_setzero_si128() ) ) != 0xFFFF )
+            {
+                const __m128i dst = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pDst) );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst), BlendOver4( src, dst ) );
+            }
+        }
+#endif
+        for( ; count > 0; --count, ++pDst, ++pSrc )
+        {
+            const std::uint32_t src = *pSrc;
+            if( src >= 0xFF000000u )
+            {
+                *pDst = src;
+            }
+            else if( src != 0u )
+            {
+                *pDst = BlendOver( src, *pDst );
+            }
+        }
+    }
+
+    void RasterSprite( const Graphics::RawSurface& s, const ClipRect& clip, int x, int y, const Surface& surf,
+        int srcX, int srcY, int w, int h, Graphics::SpriteBlend blend, std::uint32_t key )
+    {
+        const int left = std::max( x, clip.left );
+        const int top = std::max( y, clip.top );
+        const int right = std::min( x + w, clip.right );
+        const int bottom = std::min( y + h, clip.bottom );
+        if( left >= right || top >= bottom )
+        {
+            return;
+        }
+        const int count = right - left;
+        const std::uint32_t* pSrc = reinterpret_cast<const std::uint32_t*>(surf.Data()) +
+            (srcY + top - y) * surf.GetPitch() + srcX + left - x;
+        std::uint32_t* pDst = s.pixels + top * s.pitch + left;
+        for( int py = top; py < bottom; ++py, pSrc += surf.GetPitch(), pDst += s.pitch )
+        {
+            switch( blend )
+            {
+            case Graphics::SpriteBlend::Copy:
+                std::memcpy( pDst, pSrc, sizeof( std::uint32_t ) * count );
+                break;
+            case Graphics::SpriteBlend::ColorKey:
+                BlitRowColorKey( pDst, pSrc, count, key );
+                break;
+            case Graphics::SpriteBlend::Alpha:
+                BlitRowAlpha( pDst, pSrc, count );
+                break;
+            }
+        }
+    }
+
+    // Textured triangles: texture positions are 16.16 fixed point in texels
+    // and step with wrapping 32-bit adds, so every path computes the same
+    // bits. Texels are clamped to tex (half-open) before they are read.
+    inline int ClampTexel( std::int32_t t, int lo, int hi )
+    {
+        return std::min( std::max( static_cast<int>(t), lo ), hi - 1 );
+    }
+
+    inline std::uint32_t SampleNearest( const std::uint32_t* pTex, int texPitch, const ClipRect& tex, std::uint32_t u, std::uint32_t v )
+    {
+        const int tx = ClampTexel( static_cast<std::int32_t>(u) >> 16, tex.left, tex.right );
+        const int ty = ClampTexel( static_cast<std::int32_t>(v) >> 16, tex.top, tex.bottom );
+        return pTex[ty * texPitch + tx];
+    }
+
+    // (a * (256 - w) + b * w) / 256 per channel, rounded; two channels at a
+    // time since the sums stay below 16 bits
+    inline std::uint32_t LerpTexels( std::uint32_t a, std::uint32_t b, std::uint32_t w )
+    {
+        const std::uint32_t iw = 256u - w;
+        const std::uint32_t rb = (((a & 0x00FF00FFu) * iw + (b & 0x00FF00FFu) * w + 0x00800080u) >> 8) & 0x00FF00FFu;
+        const std::uint32_t ga = ((((a >> 8) & 0x00FF00FFu) * iw + ((b >> 8) & 0x00FF00FFu) * w + 0x00800080u) >> 8) & 0x00FF00FFu;
+        return rb | ga << 8;
+    }
+
+    // Texel centers sit at .5, so the four around (u, v) start half a texel
+    // up and left; fx and fy are the 8-bit weights of the far texels
+    inline std::uint32_t SampleBilinear( const std::uint32_t* pTex, int texPitch, const ClipRect& tex, std::uint32_t u, std::uint32_t v )
+    {
+        u -= 0x8000u;
+        v -= 0x8000u;
+        const std::int32_t x = static_cast<std::int32_t>(u) >> 16;
+        const std::int32_t y = static_cast<std::int32_t>(v) >> 16;
+        const int x0 = ClampTexel( x, tex.left, tex.right );
+        const int x1 = ClampTexel( x + 1, tex.left, tex.right );
+        const std::uint32_t* pRow0 = pTex + ClampTexel( y, tex.top, tex.bottom ) * texPitch;
+        const std::uint32_t* pRow1 = pTex + ClampTexel( y + 1, tex.top, tex.bottom ) * texPitch;
+        const std::uint32_t fx = (u >> 8) & 0xFFu;
+        const std::uint32_t fy = (v >> 8) & 0xFFu;
+        return LerpTexels( LerpTexels( pRow0[x0], pRow0[x1], fx ), LerpTexels( pRow1[x0], pRow1[x1], fx ), fy );
+    }
+
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+    // LerpTexels for four pixels, w holding each pixel's weight in its lane
+    inline __m128i LerpTexels4( __m128i a, __m128i b, __m128i w )
+    {
+        const __m128i zero = _mm_setzero_si128();
+        w = _mm_or_si128( w, _mm_slli_epi32( w, 16 ) );
+        const __m128i wLo = _mm_unpacklo_epi32( w, w );
+        const __m128i wHi = _mm_unpackhi_epi32( w, w );
+        const __m128i full = _mm_set1_epi16( 256 );
+        const __m128i bias = _mm_set1_epi16( 128 );
+        __m128i lo = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( a, zero ), _mm_sub_epi16( full, wLo ) ),
+            _mm_mullo_epi16( _mm_unpacklo_epi8( b, zero ), wLo ) );
+        __m128i hi = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( a, zero ), _mm_sub_epi16( full, wHi ) ),
+            _mm_mullo_epi16( _mm_unpackhi_epi8( b, zero ), wHi ) );
+        lo = _mm_srli_epi16( _mm_add_epi16( lo, bias ), 8 );
+        hi = _mm_srli_epi16( _mm_add_epi16( hi, bias ), 8 );
+        return _mm_packus_epi16( lo, hi );
+    }
+#endif
+
+#if defined( __AVX2__ )
+    inline __m256i LerpTexels8( __m256i a, __m256i b, __m256i w )
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        w = _mm256_or_si256( w, _mm256_slli_epi32( w, 16 ) );
+        const __m256i wLo = _mm256_unpacklo_epi32( w, w );
+        const __m256i wHi = _mm256_unpackhi_epi32( w, w );
+        const __m256i full = _mm256_set1_epi16( 256 );
+        const __m256i bias = _mm256_set1_epi16( 128 );
+        __m256i lo = _mm256_add_epi16( _mm256_mullo_epi16( _mm256_unpacklo_epi8( a, zero ), _mm256_sub_epi16( full, wLo ) ),
+            _mm256_mullo_epi16( _mm256_unpacklo_epi8( b, zero ), wLo ) );
+        __m256i hi = _mm256_add_epi16( _mm256_mullo_epi16( _mm256_unpackhi_epi8( a, zero ), _mm256_sub_epi16( full, wHi ) ),
+            _mm256_mullo_epi16( _mm256_unpackhi_epi8( b, zero ), wHi ) );
+        lo = _mm256_srli_epi16( _mm256_add_epi16( lo, bias ), 8 );
+        hi = _mm256_srli_epi16( _mm256_add_epi16( hi, bias ), 8 );
+        return _mm256_packus_epi16( lo, hi );
+    }
+
+    inline __m256i ClampTexels8( __m256i t, __m256i lo, __m256i hi )
+    {
+        return _mm256_min_epi32( _mm256_max_epi32( t, lo ), hi );
+    }
+#endif
+
+    // Samples rows of a triangle's texture into a pixel buffer. Built once
+    // per triangle so the per-row calls only step positions. AVX2 computes
+    // eight texel addresses at once and gathers; SSE2 gathers four with
+    // scalar loads and filters them together.
+    class TexelSampler
+    {
+    public:
+        TexelSampler( const Surface& surf, const ClipRect& tex, Graphics::TextureFilter filter, std::uint32_t du, std::uint32_t dv )
+            : pTex( reinterpret_cast<const std::uint32_t*>(surf.Data()) ),
+              texPitch( surf.GetPitch() ),
+              tex( tex ),
+              filter( filter ),
+              du( du ),
+              dv( dv )
+#if defined( __AVX2__ )
+              ,
+              stepU( _mm256_mullo_epi32( _mm256_set1_epi32( static_cast<int>(du) ), _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) ) ),
+              stepV( _mm256_mullo_epi32( _mm256_set1_epi32( static_cast<int>(dv) ), _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) ) ),
+              left( _mm256_set1_epi32( tex.left ) ),
+              right( _mm256_set1_epi32( tex.right - 1 ) ),
+              top( _mm256_set1_epi32( tex.top ) ),
+              bottom( _mm256_set1_epi32( tex.bottom - 1 ) ),
+              pitch( _mm256_set1_epi32( texPitch ) )
+#endif
+        {
+        }
+        // SampleRow may write up to this many pixels past count, so partial
+        // groups at the end of a row still take the vector path
+#if defined( __AVX2__ )
+        static constexpr int Overrun = 7;
+#elif defined( __SSE2__ )
+        static constexpr int Overrun = 3;
+#else
+        static constexpr int Overrun = 0;
+#endif
+        // count pixels from (u, v) into pDst
+        void SampleRow( std::uint32_t* pDst, int count, std::uint32_t u, std::uint32_t v ) const
+        {
+            if( filter == Graphics::TextureFilter::Nearest )
+            {
+                SampleNearestRow( pDst, count, u, v );
+            }
+            else
+            {
+                SampleBilinearRow( pDst, count, u, v );
+            }
+        }
+
+    private:
+        void SampleNearestRow( std::uint32_t* pDst, int count, std::uint32_t u, std::uint32_t v ) const
+        {
+#if defined( __AVX2__ )
+            for( ; count > 0; count -= 8, pDst += 8, u += 8u * du, v += 8u * dv )
+            {
+                const __m256i us = _mm256_add_epi32( _mm256_set1_epi32( static_cast<int>(u) ), stepU );
+                const __m256i vs = _mm256_add_epi32( _mm256_set1_epi32( static_cast<int>(v) ), stepV );
+                const __m256i tx = ClampTexels8( _mm256_srai_epi32( us, 16 ), left, right );
+                const __m256i ty = ClampTexels8( _mm256_srai_epi32( vs, 16 ), top, bottom );
+                const __m256i index = _mm256_add_epi32( _mm256_mullo_epi32( ty, pitch ), tx );
+                _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDst),
+                    _mm256_i32gather_epi32( reinterpret_cast<const int*>(pTex), index, 4 ) );
+            }
+#endif
+            for( ; count > 0; --count, ++pDst, u += du, v += dv )
+            {
+                *pDst = SampleNearest( pTex, texPitch, tex, u, v );
+            }
+        }
+
+        void SampleBilinearRow( std::uint32_t* pDst, int count, std::uint32_t u, std::uint32_t v ) const
+        {
+#if defined( __AVX2__ )
+            const __m256i one = _mm256_set1_epi32( 1 );
+            const __m256i weight = _mm256_set1_epi32( 0xFF );
+            const int* pBase = reinterpret_cast<const int*>(pTex);
+            for( ; count > 0; count -= 8, pDst += 8, u += 8u * du, v += 8u * dv )
+            {
+                const __m256i us = _mm256_add_epi32( _mm256_set1_epi32( static_cast<int>(u - 0x8000u) ), stepU );
+                const __m256i vs = _mm256_add_epi32( _mm256_set1_epi32( static_cast<int>(v - 0x8000u) ), stepV );
+                const __m256i x = _mm256_srai_epi32( us, 16 );
+                const __m256i y = _mm256_srai_epi32( vs, 16 );
+                const __m256i x0 = ClampTexels8( x, left, right );
+                const __m256i x1 = ClampTexels8( _mm256_add_epi32( x, one ), left, right );
+                const __m256i row0 = _mm256_mullo_epi32( ClampTexels8( y, top, bottom ), pitch );
+                const __m256i row1 = _mm256_mullo_epi32( ClampTexels8( _mm256_add_epi32( y, one ), top, bottom ), pitch );
+                const __m256i c00 = _mm256_i32gather_epi32( pBase, _mm256_add_epi32( row0, x0 ), 4 );
+                const __m256i c10 = _mm256_i32gather_epi32( pBase, _mm256_add_epi32( row0, x1 ), 4 );
+                const __m256i c01 = _mm256_i32gather_epi32( pBase, _mm256_add_epi32( row1, x0 ), 4 );
+                const __m256i c11 = _mm256_i32gather_epi32( pBase, _mm256_add_epi32( row1, x1 ), 4 );
+                const __m256i fx = _mm256_and_si256( _mm256_srli_epi32( us, 8 ), weight );
+                const __m256i fy = _mm256_and_si256( _mm256_srli_epi32( vs, 8 ), weight );
+                _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDst),
+                    LerpTexels8( LerpTexels8( c00, c10, fx ), LerpTexels8( c01, c11, fx ), fy ) );
+            }
+#elif defined( __SSE2__ )
+            for( ; count > 0; count -= 4, pDst += 4 )
+            {
+                alignas( 16 ) std::uint32_t c[4][4];
+                alignas( 16 ) std::uint32_t fx[4];
+                alignas( 16 ) std::uint32_t fy[4];
+                for( int i = 0; i < 4; ++i, u += du, v += dv )
+                {
+                    const std::uint32_t su = u - 0x8000u;
+                    const std::uint32_t sv = v - 0x8000u;
+                    const std::int32_t x = static_cast<std::int32_t>(su) >> 16;
+                    const std::int32_t y = static_cast<std::int32_t>(sv) >> 16;
+                    const int x0 = ClampTexel( x, tex.left, tex.right );
+                    const int x1 = ClampTexel( x + 1, tex.left, tex.right );
+                    const std::uint32_t* pRow0 = pTex + ClampTexel( y, tex.top, tex.bottom ) * texPitch;
+                    const std::uint32_t* pRow1 = pTex + ClampTexel( y + 1, tex.top, tex.bottom ) * texPitch;
+                    c[0][i] = pRow0[x0];
+                    c[1][i] = pRow0[x1];
+                    c[2][i] = pRow1[x0];
+                    c[3][i] = pRow1[x1];
+                    fx[i] = (su >> 8) & 0xFFu;
+                    fy[i] = (sv >> 8) & 0xFFu;
+                }
+                const __m128i wx = _mm_load_si128( reinterpret_cast<const __m128i*>(fx) );
+                const __m128i upper = LerpTexels4( _mm_load_si128( reinterpret_cast<const __m128i*>(c[0]) ),
+                    _mm_load_si128( reinterpret_cast<const __m128i*>(c[1]) ), wx );
+                const __m128i lower = LerpTexels4( _mm_load_si128( reinterpret_cast<const __m128i*>(c[2]) ),
+                    _mm_load_si128( reinterpret_cast<const __m128i*>(c[3]) ), wx );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst),
+                    LerpTexels4( upper, lower, _mm_load_si128( reinterpret_cast<const __m128i*>(fy) ) ) );
+            }
+#endif
+            for( ; count > 0; --count, ++pDst, u += du, v += dv )
+            {
+                *pDst = SampleBilinear( pTex, texPitch, tex, u, v );
+            }
+        }
+
+    private:
+        const std::uint32_t* pTex;
+        int texPitch;
+        ClipRect tex;
+        Graphics::TextureFilter filter;
+        std::uint32_t du;
+        std::uint32_t dv;
+#if defined( __AVX2__ )
+        // Lane offsets of the positions and the clamp bounds, broadcast
+        __m256i stepU;
+        __m256i stepV;
+        __m256i left;
+        __m256i right;
+        __m256i top;
+        __m256i bottom;
+        __m256i pitch;
+#endif
+    };
+
+    // floor( n / d ) and ceil( n / d ) for d > 0
+    inline std::int64_t FloorDiv( std::int64_t n, std::int64_t d )
+    {
+        return n >= 0 ? n / d : -((-n + d - 1) / d);
+    }
+
+    inline std::int64_t CeilDiv( std::int64_t n, std::int64_t d )
+    {
+        return -FloorDiv( -n, d );
+    }
+
+    // floor( n / d ) for d > 0 while n grows by a fixed step, kept as a
+    // quotient and a remainder in [0, d) so that stepping never divides
+    class FloorStepper
+    {
+    public:
+        FloorStepper() = default;
+        FloorStepper( std::int64_t n, std::int64_t d, std::int64_t step )
+            : quotient( FloorDiv( n, d ) ),
+              remainder( n - quotient * d ),
+              divisor( d ),
+              stepQuotient( FloorDiv( step, d ) ),
+              stepRemainder( step - stepQuotient * d )
+        {
+        }
+        void Step()
+        {
+            quotient += stepQuotient;
+            remainder += stepRemainder;
+            if( remainder >= divisor )
+            {
+                remainder -= divisor;
+                ++quotient;
+            }
+        }
+        // Same as count calls to Step
+        void Advance( std::int64_t count )
+        {
+            const std::int64_t r = remainder + stepRemainder * count;
+            quotient += stepQuotient * count + r / divisor;
+            remainder = r % divisor;
+        }
+        std::int64_t Floor() const
+        {
+            return quotient;
+        }
+        std::int64_t Ceil() const
+        {
+            return remainder != 0 ? quotient + 1 : quotient;
+        }
+
+    private:
+        std::int64_t quotient = 0;
+        std::int64_t remainder = 0;
+        std::int64_t divisor = 1;
+        std::int64_t stepQuotient = 0;
+        std::int64_t stepRemainder = 0;
+    };
+
+    // Corners of srcRect scaled and rotated about its center, clockwise from
+    // the top-left
+    void SpriteCorners( float cx, float cy, const sf::IntRect& srcRect, float angle, float scale, Graphics::TexVertex (&corners)[4] )
+    {
+        const float c = std::cos( angle );
+        const float s = std::sin( angle );
+        const float halfW = 0.5f * scale * static_cast<float>(srcRect.size.x);
+        const float halfH = 0.5f * scale * static_cast<float>(srcRect.size.y);
+        const float u0 = static_cast<float>(srcRect.position.x);
+        const float v0 = static_cast<float>(srcRect.position.y);
+        const float u1 = u0 + static_cast<float>(srcRect.size.x);
+        const float v1 = v0 + static_cast<float>(srcRect.size.y);
+        const float dx[4] = { -halfW, halfW, halfW, -halfW };
+        const float dy[4] = { -halfH, -halfH, halfH, halfH };
+        const float us[4] = { u0, u1, u1, u0 };
+        const float vs[4] = { v0, v0, v1, v1 };
+        for( int i = 0; i < 4; ++i )
+        {
+            corners[i] = { cx + dx[i] * c - dy[i] * s, cy + dx[i] * s + dy[i] * c, us[i], vs[i] };
+        }
+    }
+
+    // Palette expansion, index -> packed color. A 256-entry table is too big
+    // for byte shuffles, so AVX2 uses an eight-wide gather; elsewhere the
+    // table lookup stays scalar, where it is load-bound anyway.
+    void ExpandIndexedRow( std::uint32_t* pDst, const std::uint8_t* pSrc, int count, const std::uint32_t* pPalette )
+    {
+#if defined( __AVX2__ )
+        for( ; count >= 8; count -= 8, pDst += 8, pSrc += 8 )
+        {
+            const __m256i indices = _mm256_cvtepu8_epi32( _mm_loadl_epi64( reinterpret_cast<const __m128i*>(pSrc) ) );
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDst),
+                _mm256_i32gather_epi32( reinterpret_cast<const int*>(pPalette), indices, 4 ) );
+        }
+#endif
+        for( ; count >= 4; count -= 4, pDst += 4, pSrc += 4 )
+        {
+            pDst[0] = pPalette[pSrc[0]];
+            pDst[1] = pPalette[pSrc[1]];
+            pDst[2] = pPalette[pSrc[2]];
+            pDst[3] = pPalette[pSrc[3]];
+        }
+        for( ; count > 0; --count )
+        {
+            *pDst++ = pPalette[*pSrc++];
+        }
+    }
+
+    // Nearest-neighbor horizontal upscale: every source pixel repeated
+    // scale times. 2x, the common case, interleaves each pixel with itself.
+    void UpscaleRow( std::uint32_t* pDst, const std::uint32_t* pSrc, int count, int scale )
+    {
+        if( scale == 2 )
+        {
+#if defined( __AVX2__ )
+            for( ; count >= 8; count -= 8, pSrc += 8, pDst += 16 )
+            {
+                const __m256i v = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pSrc) );
+                // Lane-local unpacks, then put the 128-bit halves in order
+                const __m256i lo = _mm256_unpacklo_epi32( v, v );
+                const __m256i hi = _mm256_unpackhi_epi32( v, v );
+                _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDst), _mm256_permute2x128_si256( lo, hi, 0x20 ) );
+                _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDst + 8), _mm256_permute2x128_si256( lo, hi, 0x31 ) );
+            }
+#elif defined( __SSE2__ )
+            for( ; count >= 4; count -= 4, pSrc += 4, pDst += 8 )
+            {
+                const __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pSrc) );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst), _mm_unpacklo_epi32( v, v ) );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst + 4), _mm_unpackhi_epi32( v, v ) );
+            }
+#endif
+            for( ; count > 0; --count, ++pSrc, pDst += 2 )
+            {
+                pDst[0] = *pSrc;
+                pDst[1] = *pSrc;
+            }
+            return;
+        }
+        for( ; count > 0; --count, ++pSrc )
+        {
+            FillSpan( pDst, scale, *pSrc );
+            pDst += scale;
+        }
+    }
+
+    // Calls fn( x, y, w, h ) for each horizontal run of set tiles in a tile
+    // bitset, clipped to the surface
+    template<typename F>
+    void ForEachTileRun( const std::vector<std::uint64_t>& tiles, int tilesX, int tilesY, int width, int height, F&& fn )
+    {
+        for( int ty = 0; ty < tilesY; ++ty )
+        {
+            const int y = ty * Graphics::TileSize;
+            const int h = std::min( Graphics::TileSize, height - y );
+            int tx = 0;
+            while( tx < tilesX )
+            {
+                int tile = ty * tilesX + tx;
+                if( (tiles[tile >> 6] >> (tile & 63) & 1u) == 0u )
+                {
+                    ++tx;
+                    continue;
+                }
+                const int runStart = tx;
+                do
+                {
+                    ++tx;
+                    ++tile;
+                } while( tx < tilesX && (tiles[tile >> 6] >> (tile & 63) & 1u) != 0u );
+
+                const int x = runStart * Graphics::TileSize;
+                fn( x, y, std::min( tx * Graphics::TileSize, width ) - x, h );
+            }
+        }
+    }
+}
+
 Graphics::Graphics( MainWindow& wnd )
+    : Graphics( wnd, wnd.GetWidth(), wnd.GetHeight() )
+{
+}
+
+Graphics::Graphics( MainWindow& wnd, int width, int height )
     : wnd( wnd ),
-      window( wnd.GetWindow() )
+      width( width ),
+      height( height ),
+      pitch( width ),
+      tilesX( (width + TileSize - 1) / TileSize ),
+      tilesY( (height + TileSize - 1) / TileSize ),
+      dirtyTiles( (tilesX * tilesY + 63) / 64, 0u ),
+      drawnTiles( (tilesX * tilesY + 63) / 64, 0u ),
+      uploadStaging( std::size_t( width ) * TileSize ),
+      presentScale( std::min( wnd.GetWidth() / std::max( width, 1 ), wnd.GetHeight() / std::max( height, 1 ) ) ),
+      presentX( (wnd.GetWidth() - width * presentScale) / 2 ),
+      presentY( (wnd.GetHeight() - height * presentScale) / 2 ),
+      indexPitch( int( (width + SysBufferAlignment - 1) & ~(SysBufferAlignment - 1) ) ),
+      rasterThreads( std::max( 1u, std::thread::hardware_concurrency() ) ),
+      tileBins( std::size_t( tilesX ) * tilesY )
 {
+    if( width <= 0 || height <= 0 || presentScale < 1 )
+    {
+        throw std::runtime_error( "Graphics: surface of " + std::to_string( width ) + "x" + std::to_string( height ) +
+            " does not fit the window" );
+    }
+    for( int i = 0; i < 256; ++i )
+    {
+        palette[i] = Colors::MakeRGB( static_cast<unsigned char>(i), static_cast<unsigned char>(i), static_cast<unsigned char>(i) );
+    }
+    if( !wnd.IsHeadless() )
+    {
+        // Headless has no GL context, so it gets no texture at all
+        pWindow = &wnd.GetWindow();
+        texture.emplace( sf::Vector2u( static_cast<unsigned int>(width), static_cast<unsigned int>(height) ) );
+        // Nearest-neighbor sampling keeps the integer upscale pixel-exact
+        texture->setSmooth( false );
+        sprite.emplace( *texture );
+        sprite->setScale( { static_cast<float>(presentScale), static_cast<float>(presentScale) } );
+        sprite->setPosition( { static_cast<float>(presentX), static_cast<float>(presentY) } );
+    }
+    else if( presentScale > 1 )
+    {
+        scaledRow.resize( std::size_t( width ) * presentScale );
+    }
+    pSysBuffer = static_cast<std::uint32_t*>(::operator new[](
+        sizeof( std::uint32_t ) * pitch * height, std::align_val_t( SysBufferAlignment ) ));
+    FillSpan( pSysBuffer, pitch * height, Colors::Black.dword );
+    // Texture contents start out undefined, so the first present sends everything
+    MarkDirty( 0, 0, width, height );
 }
 
 Graphics::~Graphics()
 {
+    StopRenderThread();
+    ::operator delete[]( pSysBuffer, std::align_val_t( SysBufferAlignment ) );
+    pSysBuffer = nullptr;
+    if( pIndexBuffer != nullptr )
+    {
+        ::operator delete[]( pIndexBuffer, std::align_val_t( SysBufferAlignment ) );
+        pIndexBuffer = nullptr;
+    }
 }
 
 void Graphics::BeginFrame()
 {
-    window.clear( sf::Color::Black );
+    if( persistentCanvas )
+    {
+        return;
+    }
+    // Only tiles drawn into since the last clear can hold anything but
+    // black (index 0 when indexed), so those are the only ones that need
+    // clearing and re-uploading
+    const std::uint32_t clearValue = pixelFormat == PixelFormat::Indexed8 ? 0u : Colors::Black.dword;
+    Rasterize( [&]( const auto& s )
+    {
+        for( int ty = 0; ty < tilesY; ++ty )
+        {
+            for( int tx = 0; tx < tilesX; ++tx )
+            {
+                const int tile = ty * tilesX + tx;
+                if( (drawnTiles[tile >> 6] >> (tile & 63) & 1u) == 0u )
+                {
+                    continue;
+                }
+                RasterRect( s, { 0, 0, width, height }, tx * TileSize, ty * TileSize, TileSize, TileSize, clearValue );
+                dirtyTiles[tile >> 6] |= std::uint64_t( 1 ) << (tile & 63);
+            }
+        }
+    } );
+    std::fill( drawnTiles.begin(), drawnTiles.end(), 0u );
 }
 
 void Graphics::EndFrame()
 {
-    window.display();
+    SubmitDrawLists();
+    FlushCommands();
+    if( pixelFormat == PixelFormat::Indexed8 )
+    {
+        ExpandDirtyTiles();
+    }
+    // Post effects write to their own buffer, so the back buffer keeps the
+    // plain frame for the next one. Glow and blur spread past the tiles
+    // that were drawn, so a processed frame goes up whole, and so does the
+    // first frame after effects are turned off.
+    const std::uint32_t* pFrame = pSysBuffer;
+    const bool postProcess = pPostProcess != nullptr && pPostProcess->IsActive();
+    if( postProcess || postProcessed )
+    {
+        std::fill( dirtyTiles.begin(), dirtyTiles.end(), ~std::uint64_t( 0 ) );
+    }
+    if( postProcess )
+    {
+        pFrame = pPostProcess->Apply( SysSurface() ).pixels;
+    }
+    postProcessed = postProcess;
+    if( pRecorder != nullptr )
+    {
+        pRecorder->Capture( pFrame, pitch );
+    }
+    if( renderThread.joinable() )
+    {
+        SubmitPresentSlot( pFrame );
+    }
+    else
+    {
+        UploadDirtyTiles( pFrame, dirtyTiles );
+        Present();
+    }
+    wnd.FinishFrame();
 }
 
 void Graphics::PutPixel( int x, int y, int r, int g, int b )
 {
-    sf::RectangleShape pixel( {1.0f, 1.0f} );
-    pixel.setPosition( {static_cast<float>(x), static_cast<float>(y)} );
-    pixel.setFillColor( sf::Color( r, g, b ) );
-    window.draw( pixel );
+    PutPixel( x, y, Color( static_cast<unsigned char>(r), static_cast<unsigned char>(g), static_cast<unsigned char>(b) ) );
 }
 
-// Game Implementation
-Game::Game( MainWindow& wnd )
-    : wnd( wnd ),
-      gfx( wnd )
+void Graphics::PutPixel( int x, int y, Color c )
 {
+    PutPixelValue( x, y, PixelValue( c ) );
 }
 
-Game::~Game()
+void Graphics::PutPixel( int x, int y, std::uint8_t index )
 {
+    PutPixelValue( x, y, PixelValue( index ) );
 }
 
-void Game::Go()
+void Graphics::Clear( Color c )
+{
+    ClearValue( PixelValue( c ) );
+}
+
+void Graphics::Clear( std::uint8_t index )
+{
+    ClearValue( PixelValue( index ) );
+}
+
+void Graphics::DrawHLine( int x0, int x1, int y, Color c )
+{
+    HLineValue( x0, x1, y, PixelValue( c ) );
+}
+
+void Graphics::DrawHLine( int x0, int x1, int y, std::uint8_t index )
+{
+    HLineValue( x0, x1, y, PixelValue( index ) );
+}
+
+void Graphics::DrawRect( int x, int y, int w, int h, Color c )
+{
+    RectValue( x, y, w, h, PixelValue( c ) );
+}
+
+void Graphics::DrawRect( int x, int y, int w, int h, std::uint8_t index )
+{
+    RectValue( x, y, w, h, PixelValue( index ) );
+}
+
+void Graphics::DrawLine( int x0, int y0, int x1, int y1, Color c )
+{
+    LineValue( x0, y0, x1, y1, PixelValue( c ) );
+}
+
+void Graphics::DrawLine( int x0, int y0, int x1, int y1, std::uint8_t index )
+{
+    LineValue( x0, y0, x1, y1, PixelValue( index ) );
+}
+
+void Graphics::DrawCircle( int cx, int cy, int radius, Color c )
+{
+    CircleValue( cx, cy, radius, PixelValue( c ) );
+}
+
+void Graphics::DrawCircle( int cx, int cy, int radius, std::uint8_t index )
+{
+    CircleValue( cx, cy, radius, PixelValue( index ) );
+}
+
+void Graphics::FillCircle( int cx, int cy, int radius, Color c )
+{
+    FilledCircleValue( cx, cy, radius, PixelValue( c ) );
+}
+
+void Graphics::FillCircle( int cx, int cy, int radius, std::uint8_t index )
+{
+    FilledCircleValue( cx, cy, radius, PixelValue( index ) );
+}
+
+void Graphics::DrawText( int x, int y, std::string_view text, Color c, int scale )
+{
+    TextValue( x, y, text, PixelValue( c ), scale );
+}
+
+void Graphics::DrawText( int x, int y, std::string_view text, std::uint8_t index, int scale )
+{
+    TextValue( x, y, text, PixelValue( index ), scale );
+}
+
+void Graphics::DrawSprite( int x, int y, const Surface& s, SpriteBlend blend, Color key )
+{
+    DrawSprite( x, y, s, { { 0, 0 }, { s.GetWidth(), s.GetHeight() } }, blend, key );
+}
+
+void Graphics::DrawSprite( int x, int y, const Surface& s, const sf::IntRect& srcRect, SpriteBlend blend, Color key )
+{
+    // Trim the source rect to the surface, shifting the destination along
+    int srcX = srcRect.position.x;
+    int srcY = srcRect.position.y;
+    int w = srcRect.size.x;
+    int h = srcRect.size.y;
+    if( srcX < 0 )
+    {
+        x -= srcX;
+        w += srcX;
+        srcX = 0;
+    }
+    if( srcY < 0 )
+    {
+        y -= srcY;
+        h += srcY;
+        srcY = 0;
+    }
+    w = std::min( w, s.GetWidth() - srcX );
+    h = std::min( h, s.GetHeight() - srcY );
+    if( w <= 0 || h <= 0 )
+    {
+        return;
+    }
+    if( rasterMode == RasterMode::Binned )
+    {
+        DrawCommand cmd = { DrawCommand::Type::Sprite, blend, key.dword, x, y, w, h };
+        cmd.e = srcX;
+        cmd.f = srcY;
+        cmd.pSurface = &s;
+        Record( cmd, x, y, w, h );
+    }
+    else if( pixelFormat == PixelFormat::Indexed8 )
+    {
+        RasterThroughPalette( x, y, x + w, y + h, [&]( const RawSurface& rgba, const ClipRect& clip )
+        {
+            RasterSprite( rgba, clip, x, y, s, srcX, srcY, w, h, blend, key.dword );
+        } );
+    }
+    else
+    {
+        RasterSprite( SysSurface(), { 0, 0, width, height }, x, y, s, srcX, srcY, w, h, blend, key.dword );
+    }
+    MarkDirty( x, y, w, h );
+}
+
+void Graphics::DrawTexturedTriangle( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const Surface& s,
+    TextureFilter filter, SpriteBlend blend, Color key )
+{
+    TexturedTriangleValue( v0, v1, v2, s, { { 0, 0 }, { s.GetWidth(), s.GetHeight() } }, filter, blend, key );
+}
+
+void Graphics::DrawTexturedQuad( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const TexVertex& v3, const Surface& s,
+    TextureFilter filter, SpriteBlend blend, Color key )
+{
+    DrawTexturedTriangle( v0, v1, v2, s, filter, blend, key );
+    DrawTexturedTriangle( v0, v2, v3, s, filter, blend, key );
+}
+
+void Graphics::DrawSpriteTransformed( float cx, float cy, const Surface& s, float angle, float scale,
+    TextureFilter filter, SpriteBlend blend, Color key )
+{
+    DrawSpriteTransformed( cx, cy, s, { { 0, 0 }, { s.GetWidth(), s.GetHeight() } }, angle, scale, filter, blend, key );
+}
+
+void Graphics::DrawSpriteTransformed( float cx, float cy, const Surface& s, const sf::IntRect& srcRect, float angle, float scale,
+    TextureFilter filter, SpriteBlend blend, Color key )
+{
+    // The quad keeps srcRect's size even where it hangs off the surface;
+    // only the sampling is trimmed
+    const std::optional<sf::IntRect> texRect = srcRect.findIntersection( { { 0, 0 }, { s.GetWidth(), s.GetHeight() } } );
+    if( !texRect )
+    {
+        return;
+    }
+    TexVertex corners[4];
+    SpriteCorners( cx, cy, srcRect, angle, scale, corners );
+    TexturedTriangleValue( corners[0], corners[1], corners[2], s, *texRect, filter, blend, key );
+    TexturedTriangleValue( corners[0], corners[2], corners[3], s, *texRect, filter, blend, key );
+}
+
+Graphics::RawSurface Graphics::GetRawSurface()
+{
+    // Recorded draws must land before the caller writes over them
+    FlushCommands();
+    MarkDirty( 0, 0, width, height );
+    return SysSurface();
+}
+
+Graphics::RawSurface Graphics::GetRawSurface( int x, int y, int w, int h )
+{
+    FlushCommands();
+    MarkDirty( x, y, w, h );
+    return SysSurface();
+}
+
+Graphics::RawIndexSurface Graphics::GetRawIndexSurface()
+{
+    FlushCommands();
+    MarkDirty( 0, 0, width, height );
+    return IndexSurface();
+}
+
+Graphics::RawIndexSurface Graphics::GetRawIndexSurface( int x, int y, int w, int h )
+{
+    FlushCommands();
+    MarkDirty( x, y, w, h );
+    return IndexSurface();
+}
+
+void Graphics::MarkDirty( int x, int y, int w, int h )
+{
+    const int left = std::max( x, 0 );
+    const int top = std::max( y, 0 );
+    const int right = std::min( x + w, width );
+    const int bottom = std::min( y + h, height );
+    if( left >= right || top >= bottom )
+    {
+        return;
+    }
+    for( int ty = top / TileSize; ty <= (bottom - 1) / TileSize; ++ty )
+    {
+        for( int tx = left / TileSize; tx <= (right - 1) / TileSize; ++tx )
+        {
+            MarkTile( tx, ty );
+        }
+    }
+}
+
+void Graphics::SetPersistentCanvas( bool persistent )
+{
+    persistentCanvas = persistent;
+}
+
+bool Graphics::IsPersistentCanvas() const
+{
+    return persistentCanvas;
+}
+
+void Graphics::SetPixelFormat( PixelFormat format )
+{
+    if( format == pixelFormat )
+    {
+        return;
+    }
+    FlushCommands();
+    pixelFormat = format;
+    if( format == PixelFormat::Indexed8 )
+    {
+        if( pIndexBuffer == nullptr )
+        {
+            pIndexBuffer = static_cast<std::uint8_t*>(::operator new[](
+                std::size_t( indexPitch ) * height, std::align_val_t( SysBufferAlignment ) ));
+        }
+        std::memset( pIndexBuffer, 0, std::size_t( indexPitch ) * height );
+    }
+    MarkDirty( 0, 0, width, height );
+}
+
+Graphics::PixelFormat Graphics::GetPixelFormat() const
+{
+    return pixelFormat;
+}
+
+void Graphics::SetPaletteEntry( std::uint8_t index, Color c )
+{
+    SetPalette( &c, 1, index );
+}
+
+void Graphics::SetPalette( const Color* pColors, int count, int firstIndex )
+{
+    // Clipped to the table like a rect to the screen: entries before 0 or
+    // past 255 are dropped along with their colors
+    if( firstIndex < 0 )
+    {
+        pColors -= firstIndex;
+        count += firstIndex;
+        firstIndex = 0;
+    }
+    count = std::min( count, 256 - firstIndex );
+    if( count <= 0 )
+    {
+        return;
+    }
+    // Recorded sprites are matched against the palette when they replay,
+    // so they have to land under the one they were drawn with
+    FlushCommands();
+    for( int i = 0; i < count; ++i )
+    {
+        paletteChanged |= palette[firstIndex + i] != pColors[i];
+        palette[firstIndex + i] = pColors[i];
+    }
+    // Entry 0 is always its own nearest match, so this resets the lookup
+    lastNearestColor = palette[0];
+    lastNearestIndex = 0u;
+}
+
+Color Graphics::GetPaletteEntry( std::uint8_t index ) const
+{
+    return palette[index];
+}
+
+void Graphics::SetRasterMode( RasterMode mode )
+{
+    FlushCommands();
+    rasterMode = mode;
+}
+
+Graphics::RasterMode Graphics::GetRasterMode() const
+{
+    return rasterMode;
+}
+
+void Graphics::SetRasterThreads( unsigned int count )
+{
+    FlushCommands();
+    rasterThreads = count != 0u ? count : std::max( 1u, std::thread::hardware_concurrency() );
+    pRasterPool.reset();
+}
+
+unsigned int Graphics::GetRasterThreads() const
+{
+    return rasterThreads;
+}
+
+void Graphics::SetPipelining( int framesInFlight )
+{
+    framesInFlight = std::max( framesInFlight, 0 );
+    if( framesInFlight == static_cast<int>(presentSlots.size()) )
+    {
+        return;
+    }
+    StopRenderThread();
+    presentSlots.resize( std::size_t( framesInFlight ) );
+    for( PresentSlot& slot : presentSlots )
+    {
+        slot.pixels.resize( std::size_t( pitch ) * height );
+        slot.dirtyTiles.assign( dirtyTiles.size(), 0u );
+    }
+    presentRead = 0;
+    presentQueued = 0;
+    if( framesInFlight > 0 )
+    {
+        // The GL context can only be current on one thread at a time, so
+        // the render thread takes it over until the pipeline is stopped
+        if( pWindow != nullptr )
+        {
+            (void)pWindow->setActive( false );
+        }
+        renderThread = std::thread( &Graphics::RenderThreadMain, this );
+    }
+}
+
+int Graphics::GetPipelining() const
+{
+    return static_cast<int>(presentSlots.size());
+}
+
+void Graphics::WaitForPresent()
+{
+    std::unique_lock<std::mutex> lock( presentMutex );
+    presentCv.wait( lock, [this] { return presentQueued == 0; } );
+}
+
+void Graphics::SetPostProcess( PostProcess* pPost )
+{
+    pPostProcess = pPost;
+}
+
+void Graphics::SetFrameRecorder( FrameRecorder* pRec )
+{
+    pRecorder = pRec;
+}
+
+void Graphics::SetDrawListCount( int count )
+{
+    drawLists.resize( std::size_t( std::max( count, 0 ) ) );
+}
+
+int Graphics::GetDrawListCount() const
+{
+    return static_cast<int>(drawLists.size());
+}
+
+Graphics::DrawList& Graphics::GetDrawList( int index )
+{
+    return drawLists.at( std::size_t( index ) );
+}
+
+void Graphics::RecordParallel( int count, const std::function<void( DrawList&, int )>& fn )
+{
+    if( count > GetDrawListCount() )
+    {
+        SetDrawListCount( count );
+    }
+    if( !pRasterPool )
+    {
+        pRasterPool = std::make_unique<WorkerPool>( rasterThreads );
+    }
+    pRasterPool->ParallelFor( count, [&]( int i )
+    {
+        fn( drawLists[i], i );
+    } );
+}
+
+void Graphics::SubmitDrawLists()
+{
+    for( DrawList& list : drawLists )
+    {
+        for( const DrawCommand& cmd : list.commands )
+        {
+            // Colors are matched to the palette here, on the owning thread,
+            // so the nearest-index cache never sees two threads
+            const std::uint32_t value = cmd.indexed
+                ? PixelValue( static_cast<std::uint8_t>(cmd.color) )
+                : PixelValue( Color( cmd.color ) );
+            switch( cmd.type )
+            {
+            case DrawCommand::Type::Pixel:
+                PutPixelValue( cmd.a, cmd.b, value );
+                break;
+            case DrawCommand::Type::Span:
+                HLineValue( cmd.a, cmd.b, cmd.c, value );
+                break;
+            case DrawCommand::Type::Rect:
+                RectValue( cmd.a, cmd.b, cmd.c, cmd.d, value );
+                break;
+            case DrawCommand::Type::Line:
+                LineValue( cmd.a, cmd.b, cmd.c, cmd.d, value );
+                break;
+            case DrawCommand::Type::Circle:
+                CircleValue( cmd.a, cmd.b, cmd.c, value );
+                break;
+            case DrawCommand::Type::FilledCircle:
+                FilledCircleValue( cmd.a, cmd.b, cmd.c, value );
+                break;
+            case DrawCommand::Type::Sprite:
+                DrawSprite( cmd.a, cmd.b, *cmd.pSurface, { { cmd.c, cmd.d }, { cmd.e, cmd.f } }, cmd.blend, Color( cmd.color ) );
+                break;
+            case DrawCommand::Type::Glyph:
+                GlyphValue( cmd.a, cmd.b, static_cast<char>(cmd.c), value, cmd.d );
+                break;
+            case DrawCommand::Type::TexturedTriangle:
+                TexturedTriangleValue( list.vertices[cmd.a], list.vertices[cmd.a + 1], list.vertices[cmd.a + 2], *cmd.pSurface,
+                    { { cmd.c, cmd.d }, { cmd.e, cmd.f } }, static_cast<TextureFilter>(cmd.b), cmd.blend, Color( cmd.color ) );
+                break;
+            }
+        }
+        list.Reset();
+    }
+}
+
+int Graphics::GetWidth() const
+{
+    return width;
+}
+
+int Graphics::GetHeight() const
+{
+    return height;
+}
+
+sf::IntRect Graphics::GetViewport() const
+{
+    return { { presentX, presentY }, { width * presentScale, height * presentScale } };
+}
+
+int Graphics::GetPresentScale() const
+{
+    return presentScale;
+}
+
+Graphics::RawSurface Graphics::SysSurface() const
+{
+    return { pSysBuffer, pitch, width, height };
+}
+
+Graphics::RawIndexSurface Graphics::IndexSurface() const
+{
+    return { pIndexBuffer, indexPitch, width, height };
+}
+
+template<typename F>
+void Graphics::Rasterize( F&& fn )
+{
+    if( pixelFormat == PixelFormat::Indexed8 )
+    {
+        fn( IndexSurface() );
+    }
+    else
+    {
+        fn( SysSurface() );
+    }
+}
+
+std::uint32_t Graphics::PixelValue( Color c )
+{
+    return pixelFormat == PixelFormat::Indexed8 ? NearestPaletteIndex( c ) : c.dword;
+}
+
+std::uint32_t Graphics::PixelValue( std::uint8_t index ) const
+{
+    return pixelFormat == PixelFormat::Indexed8 ? index : palette[index].dword;
+}
+
+std::uint8_t Graphics::NearestPaletteIndex( Color c )
+{
+    if( c == lastNearestColor )
+    {
+        return lastNearestIndex;
+    }
+    lastNearestColor = c;
+    lastNearestIndex = SearchPalette( c );
+    return lastNearestIndex;
+}
+
+std::uint8_t Graphics::SearchPalette( Color c ) const
+{
+    // Squared RGB distance; ties go to the lowest index
+    int bestDistance = 0x7FFFFFFF;
+    int best = 0;
+    for( int i = 0; i < 256 && bestDistance != 0; ++i )
+    {
+        const int dr = int( c.GetR() ) - palette[i].GetR();
+        const int dg = int( c.GetG() ) - palette[i].GetG();
+        const int db = int( c.GetB() ) - palette[i].GetB();
+        const int distance = dr * dr + dg * dg + db * db;
+        if( distance < bestDistance )
+        {
+            bestDistance = distance;
+            best = i;
+        }
+    }
+    return static_cast<std::uint8_t>(best);
+}
+
+template<typename F>
+void Graphics::RasterThroughPalette( int clipLeft, int clipTop, int clipRight, int clipBottom, F&& rasterRgba ) const
+{
+    const ClipRect clip = {
+        std::max( clipLeft, 0 ),
+        std::max( clipTop, 0 ),
+        std::min( clipRight, width ),
+        std::min( clipBottom, height ) };
+    if( clip.left >= clip.right || clip.top >= clip.bottom )
+    {
+        return;
+    }
+    const int w = clip.right - clip.left;
+    const std::uint32_t* pPalette = &palette[0].dword;
+    for( int y = clip.top; y < clip.bottom; ++y )
+    {
+        ExpandIndexedRow( pSysBuffer + y * pitch + clip.left, pIndexBuffer + y * indexPitch + clip.left, w, pPalette );
+    }
+    rasterRgba( SysSurface(), clip );
+    // Pixels still showing their entry's color keep their index, so
+    // untouched ones (and duplicate entries) are never remapped. The last
+    // match is remembered locally, which is what makes flat art cheap.
+    std::uint32_t lastColor = pPalette[0];
+    std::uint8_t lastIndex = 0u;
+    for( int y = clip.top; y < clip.bottom; ++y )
+    {
+        const std::uint32_t* pRgba = pSysBuffer + y * pitch + clip.left;
+        std::uint8_t* pIndex = pIndexBuffer + y * indexPitch + clip.left;
+        for( int x = 0; x < w; ++x )
+        {
+            if( pRgba[x] == pPalette[pIndex[x]] )
+            {
+                continue;
+            }
+            if( pRgba[x] != lastColor )
+            {
+                lastColor = pRgba[x];
+                lastIndex = SearchPalette( Color( lastColor ) );
+            }
+            pIndex[x] = lastIndex;
+        }
+    }
+}
+
+void Graphics::PutPixelValue( int x, int y, std::uint32_t value )
+{
+    if( x < 0 || x >= width || y < 0 || y >= height )
+    {
+        return;
+    }
+    if( rasterMode == RasterMode::Binned )
+    {
+        Record( { DrawCommand::Type::Pixel, SpriteBlend::Copy, value, x, y, 0, 0 }, x, y, 1, 1 );
+    }
+    else
+    {
+        Rasterize( [&]( const auto& s )
+        {
+            s.pixels[y * s.pitch + x] = static_cast<PixelOf<std::decay_t<decltype( s )>>>(value);
+        } );
+    }
+    MarkTile( x / TileSize, y / TileSize );
+}
+
+void Graphics::ClearValue( std::uint32_t value )
+{
+    if( rasterMode == RasterMode::Binned )
+    {
+        Record( { DrawCommand::Type::Rect, SpriteBlend::Copy, value, 0, 0, width, height }, 0, 0, width, height );
+    }
+    else
+    {
+        Rasterize( [&]( const auto& s )
+        {
+            RasterRect( s, { 0, 0, width, height }, 0, 0, width, height, value );
+        } );
+    }
+    MarkDirty( 0, 0, width, height );
+}
+
+void Graphics::HLineValue( int x0, int x1, int y, std::uint32_t value )
+{
+    if( rasterMode == RasterMode::Binned )
+    {
+        Record( { DrawCommand::Type::Span, SpriteBlend::Copy, value, x0, x1, y, 0 }, std::min( x0, x1 ), y, std::abs( x1 - x0 ) + 1, 1 );
+    }
+    else
+    {
+        Rasterize( [&]( const auto& s )
+        {
+            RasterSpan( s, { 0, 0, width, height }, x0, x1, y, value );
+        } );
+    }
+    MarkDirty( std::min( x0, x1 ), y, std::abs( x1 - x0 ) + 1, 1 );
+}
+
+void Graphics::RectValue( int x, int y, int w, int h, std::uint32_t value )
+{
+    if( rasterMode == RasterMode::Binned )
+    {
+        Record( { DrawCommand::Type::Rect, SpriteBlend::Copy, value, x, y, w, h }, x, y, w, h );
+    }
+    else
+    {
+        Rasterize( [&]( const auto& s )
+        {
+            RasterRect( s, { 0, 0, width, height }, x, y, w, h, value );
+        } );
+    }
+    MarkDirty( x, y, w, h );
+}
+
+void Graphics::LineValue( int x0, int y0, int x1, int y1, std::uint32_t value )
+{
+    if( rasterMode == RasterMode::Binned )
+    {
+        RecordLine( { DrawCommand::Type::Line, SpriteBlend::Copy, value, x0, y0, x1, y1 } );
+    }
+    else
+    {
+        Rasterize( [&]( const auto& s )
+        {
+            RasterLine( s, { 0, 0, width, height }, x0, y0, x1, y1, value );
+        } );
+    }
+    MarkLineDirty( x0, y0, x1, y1 );
+}
+
+void Graphics::CircleValue( int cx, int cy, int radius, std::uint32_t value )
+{
+    if( rasterMode == RasterMode::Binned )
+    {
+        Record( { DrawCommand::Type::Circle, SpriteBlend::Copy, value, cx, cy, radius, 0 },
+            cx - radius, cy - radius, 2 * radius + 1, 2 * radius + 1 );
+    }
+    else
+    {
+        Rasterize( [&]( const auto& s )
+        {
+            RasterCircle( s, { 0, 0, width, height }, cx, cy, radius, value );
+        } );
+    }
+    MarkDirty( cx - radius, cy - radius, 2 * radius + 1, 2 * radius + 1 );
+}
+
+void Graphics::FilledCircleValue( int cx, int cy, int radius, std::uint32_t value )
+{
+    if( rasterMode == RasterMode::Binned )
+    {
+        Record( { DrawCommand::Type::FilledCircle, SpriteBlend::Copy, value, cx, cy, radius, 0 },
+            cx - radius, cy - radius, 2 * radius + 1, 2 * radius + 1 );
+    }
+    else
+    {
+        Rasterize( [&]( const auto& s )
+        {
+            RasterFilledCircle( s, { 0, 0, width, height }, cx, cy, radius, value );
+        } );
+    }
+    MarkDirty( cx - radius, cy - radius, 2 * radius + 1, 2 * radius + 1 );
+}
+
+void Graphics::TextValue( int x, int y, std::string_view text, std::uint32_t value, int scale )
+{
+    scale = std::max( scale, 1 );
+    const int size = BitmapFont::GlyphSize * scale;
+    int penX = x;
+    int penY = y;
+    for( const char ch : text )
+    {
+        if( ch == '\n' )
+        {
+            penX = x;
+            penY += size;
+            continue;
+        }
+        GlyphValue( penX, penY, ch, value, scale );
+        penX += size;
+    }
+}
+
+void Graphics::GlyphValue( int x, int y, char ch, std::uint32_t value, int scale )
+{
+    const int size = BitmapFont::GlyphSize * scale;
+    if( ch == ' ' || x >= width || x + size <= 0 || y >= height || y + size <= 0 )
+    {
+        return;
+    }
+    // One command per glyph; the glyph rows are looked up again at
+    // rasterization time, so the string need not outlive the frame
+    if( rasterMode == RasterMode::Binned )
+    {
+        Record( { DrawCommand::Type::Glyph, SpriteBlend::Copy, value, x, y, static_cast<unsigned char>(ch), scale },
+            x, y, size, size );
+    }
+    else
+    {
+        Rasterize( [&]( const auto& s )
+        {
+            RasterGlyph( s, { 0, 0, width, height }, x, y, BitmapFont::GetGlyph( ch ), scale, value );
+        } );
+    }
+    MarkDirty( x, y, size, size );
+}
+
+void Graphics::TexturedTriangleValue( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const Surface& s,
+    const sf::IntRect& texRect, TextureFilter filter, SpriteBlend blend, Color key )
+{
+    TexturedTriangle tri;
+    if( texRect.size.x <= 0 || texRect.size.y <= 0 || !SetupTexturedTriangle( v0, v1, v2, tri ) )
+    {
+        return;
+    }
+    tri.pSurface = &s;
+    tri.texLeft = texRect.position.x;
+    tri.texTop = texRect.position.y;
+    tri.texRight = texRect.position.x + texRect.size.x;
+    tri.texBottom = texRect.position.y + texRect.size.y;
+    tri.filter = filter;
+    tri.blend = blend;
+    tri.key = key.dword;
+    if( rasterMode == RasterMode::Binned )
+    {
+        Record( { DrawCommand::Type::TexturedTriangle, blend, key.dword, static_cast<int>(texTriangles.size()), 0, 0, 0 },
+            tri.left, tri.top, tri.right - tri.left, tri.bottom - tri.top );
+        texTriangles.push_back( tri );
+    }
+    else if( pixelFormat == PixelFormat::Indexed8 )
+    {
+        RasterThroughPalette( tri.left, tri.top, tri.right, tri.bottom, [&]( const RawSurface& rgba, const ClipRect& clip )
+        {
+            RasterTexturedTriangle( rgba, tri, clip.left, clip.top, clip.right, clip.bottom );
+        } );
+    }
+    else
+    {
+        RasterTexturedTriangle( SysSurface(), tri, 0, 0, width, height );
+    }
+    MarkDirty( tri.left, tri.top, tri.right - tri.left, tri.bottom - tri.top );
+}
+
+bool Graphics::SetupTexturedTriangle( TexVertex v0, TexVertex v1, TexVertex v2, TexturedTriangle& tri ) const
+{
+    // Vertices beyond the guard band (in pixels) are rejected, which keeps
+    // the edge and texture math below within 64 bits. Texture coordinates
+    // are held to +-MaxTexel so they fit 16.16 fixed point.
+    constexpr float GuardBand = 1048576.0f;
+    constexpr float MaxTexel = 16384.0f;
+    constexpr double MaxGradient = 16777216.0;
+    TexVertex* const pVertices[3] = { &v0, &v1, &v2 };
+    std::int64_t px[3];
+    std::int64_t py[3];
+    for( int i = 0; i < 3; ++i )
+    {
+        TexVertex& v = *pVertices[i];
+        // Written so that NaNs fail too
+        if( !(std::abs( v.x ) <= GuardBand && std::abs( v.y ) <= GuardBand) )
+        {
+            return false;
+        }
+        px[i] = std::llround( v.x * 16.0f );
+        py[i] = std::llround( v.y * 16.0f );
+        v.u = std::clamp( v.u, -MaxTexel, MaxTexel );
+        v.v = std::clamp( v.v, -MaxTexel, MaxTexel );
+    }
+    std::int64_t area = (px[1] - px[0]) * (py[2] - py[0]) - (py[1] - py[0]) * (px[2] - px[0]);
+    if( area == 0 )
+    {
+        return false;
+    }
+    if( area < 0 )
+    {
+        std::swap( v1, v2 );
+        std::swap( px[1], px[2] );
+        std::swap( py[1], py[2] );
+        area = -area;
+    }
+
+    // Pixel centers sit at 16 * p + 8
+    tri.left = static_cast<int>(std::max<std::int64_t>( CeilDiv( std::min( { px[0], px[1], px[2] } ) - 8, 16 ), 0 ));
+    tri.top = static_cast<int>(std::max<std::int64_t>( CeilDiv( std::min( { py[0], py[1], py[2] } ) - 8, 16 ), 0 ));
+    tri.right = static_cast<int>(std::min<std::int64_t>( FloorDiv( std::max( { px[0], px[1], px[2] } ) - 8, 16 ) + 1, width ));
+    tri.bottom = static_cast<int>(std::min<std::int64_t>( FloorDiv( std::max( { py[0], py[1], py[2] } ) - 8, 16 ) + 1, height ));
+    if( tri.left >= tri.right || tri.top >= tri.bottom )
+    {
+        return false;
+    }
+
+    for( int i = 0; i < 3; ++i )
+    {
+        const int j = (i + 1) % 3;
+        const std::int64_t dx = px[j] - px[i];
+        const std::int64_t dy = py[j] - py[i];
+        tri.a[i] = -dy;
+        tri.b[i] = dx;
+        tri.c[i] = dy * px[i] - dx * py[i];
+        // With this winding a top edge runs right and a left edge runs up;
+        // centers exactly on any other edge are left to the neighbor
+        const bool topLeft = (dy == 0 && dx > 0) || dy < 0;
+        if( !topLeft )
+        {
+            tri.c[i] -= 1;
+        }
+    }
+
+    // Affine texture gradients over the snapped positions
+    const double x0 = px[0] / 16.0;
+    const double y0 = py[0] / 16.0;
+    const double x1 = px[1] / 16.0 - x0;
+    const double y1 = py[1] / 16.0 - y0;
+    const double x2 = px[2] / 16.0 - x0;
+    const double y2 = py[2] / 16.0 - y0;
+    const double det = x1 * y2 - x2 * y1;
+    const double u1 = double( v1.u ) - v0.u;
+    const double u2 = double( v2.u ) - v0.u;
+    const double w1 = double( v1.v ) - v0.v;
+    const double w2 = double( v2.v ) - v0.v;
+    const double dudx = std::clamp( (u1 * y2 - u2 * y1) / det, -MaxGradient, MaxGradient );
+    const double dvdx = std::clamp( (w1 * y2 - w2 * y1) / det, -MaxGradient, MaxGradient );
+    const double dudy = std::clamp( (u2 * x1 - u1 * x2) / det, -MaxGradient, MaxGradient );
+    const double dvdy = std::clamp( (w2 * x1 - w1 * x2) / det, -MaxGradient, MaxGradient );
+    tri.u0 = std::llround( (v0.u + dudx * (tri.left + 0.5 - x0) + dudy * (0.5 - y0)) * 65536.0 );
+    tri.v0 = std::llround( (v0.v + dvdx * (tri.left + 0.5 - x0) + dvdy * (0.5 - y0)) * 65536.0 );
+    tri.dudx = std::llround( dudx * 65536.0 );
+    tri.dvdx = std::llround( dvdx * 65536.0 );
+    tri.dudy = std::llround( dudy * 65536.0 );
+    tri.dvdy = std::llround( dvdy * 65536.0 );
+    return true;
+}
+
+void Graphics::RasterTexturedTriangle( const RawSurface& s, const TexturedTriangle& tri,
+    int clipLeft, int clipTop, int clipRight, int clipBottom )
+{
+    const ClipRect tex = { tri.texLeft, tri.texTop, tri.texRight, tri.texBottom };
+    const int top = std::max( tri.top, clipTop );
+    const int bottom = std::min( tri.bottom, clipBottom );
+    const std::uint32_t du = static_cast<std::uint32_t>(tri.dudx);
+    const std::uint32_t dv = static_cast<std::uint32_t>(tri.dvdx);
+    // Pixel x of row y is inside an edge when a * (16 * x + 8) + k >= 0,
+    // with k = b * (16 * y + 8) + c. So the first x inside is
+    // ceil( (-k - 8 * a) / (16 * a) ) for a > 0, one past the last is
+    // floor( (k + 8 * a) / (-16 * a) ) + 1 for a < 0, and both move by a
+    // constant fraction per row; FloorSteppers follow them exactly without
+    // dividing. Horizontal edges (a == 0) only cut off rows.
+    int firstRow = top;
+    int endRow = bottom;
+    FloorStepper lower[3];
+    FloorStepper upper[3];
+    int lowerCount = 0;
+    int upperCount = 0;
+    for( int i = 0; i < 3; ++i )
+    {
+        const std::int64_t a = tri.a[i];
+        const std::int64_t b = tri.b[i];
+        const std::int64_t k = b * (16 * std::int64_t( top ) + 8) + tri.c[i];
+        if( a > 0 )
+        {
+            lower[lowerCount++] = FloorStepper( -k - 8 * a, 16 * a, -16 * b );
+        }
+        else if( a < 0 )
+        {
+            upper[upperCount++] = FloorStepper( k + 8 * a, -16 * a, 16 * b );
+        }
+        else if( b > 0 )
+        {
+            const std::int64_t row = CeilDiv( -tri.c[i] - 8 * b, 16 * b );
+            firstRow = static_cast<int>(std::clamp<std::int64_t>( row, firstRow, bottom ));
+        }
+        else
+        {
+            const std::int64_t row = FloorDiv( tri.c[i] + 8 * b, -16 * b ) + 1;
+            endRow = static_cast<int>(std::clamp<std::int64_t>( row, top, endRow ));
+        }
+    }
+    for( int i = 0; i < lowerCount; ++i )
+    {
+        lower[i].Advance( firstRow - top );
+    }
+    for( int i = 0; i < upperCount; ++i )
+    {
+        upper[i].Advance( firstRow - top );
+    }
+
+    const TexelSampler sampler( *tri.pSurface, tex, tri.filter, du, dv );
+    std::uint32_t texels[64 + TexelSampler::Overrun];
+    for( int y = firstRow; y < endRow; ++y )
+    {
+        std::int64_t begin = std::max( tri.left, clipLeft );
+        std::int64_t end = std::min( tri.right, clipRight );
+        for( int i = 0; i < lowerCount; ++i )
+        {
+            begin = std::max( begin, lower[i].Ceil() );
+            lower[i].Step();
+        }
+        for( int i = 0; i < upperCount; ++i )
+        {
+            end = std::min( end, upper[i].Floor() + 1 );
+            upper[i].Step();
+        }
+        if( begin >= end )
+        {
+            continue;
+        }
+        // Positions are anchored at (tri.left, 0), not at the clip, so every
+        // tile of a binned triangle samples exactly what the immediate path
+        // does
+        const std::int64_t offset = begin - tri.left;
+        std::uint32_t u = static_cast<std::uint32_t>(tri.u0 + y * tri.dudy + offset * tri.dudx);
+        std::uint32_t v = static_cast<std::uint32_t>(tri.v0 + y * tri.dvdy + offset * tri.dvdx);
+        std::uint32_t* pDst = s.pixels + y * s.pitch + begin;
+        for( int remaining = static_cast<int>(end - begin); remaining > 0; )
+        {
+            const int count = std::min( remaining, 64 );
+            sampler.SampleRow( texels, count, u, v );
+            switch( tri.blend )
+            {
+            case SpriteBlend::Copy:
+                std::memcpy( pDst, texels, sizeof( std::uint32_t ) * count );
+                break;
+            case SpriteBlend::ColorKey:
+                BlitRowColorKey( pDst, texels, count, tri.key );
+                break;
+            case SpriteBlend::Alpha:
+                BlitRowAlpha( pDst, texels, count );
+                break;
+            }
+            u += static_cast<std::uint32_t>(count) * du;
+            v += static_cast<std::uint32_t>(count) * dv;
+            pDst += count;
+            remaining -= count;
+        }
+    }
+}
+
+void Graphics::ExpandDirtyTiles()
+{
+    if( paletteChanged )
+    {
+        // Every pixel may show a changed entry; still no redraw needed
+        std::fill( dirtyTiles.begin(), dirtyTiles.end(), ~std::uint64_t( 0 ) );
+        paletteChanged = false;
+    }
+    const std::uint32_t* pPalette = &palette[0].dword;
+    ForEachTileRun( dirtyTiles, tilesX, tilesY, width, height, [this, pPalette]( int x, int y, int w, int h )
+    {
+        for( int row = y; row < y + h; ++row )
+        {
+            ExpandIndexedRow( pSysBuffer + row * pitch + x, pIndexBuffer + row * indexPitch + x, w, pPalette );
+        }
+    } );
+}
+
+void Graphics::MarkTile( int tx, int ty )
+{
+    const int tile = ty * tilesX + tx;
+    const std::uint64_t bit = std::uint64_t( 1 ) << (tile & 63);
+    dirtyTiles[tile >> 6] |= bit;
+    drawnTiles[tile >> 6] |= bit;
+}
+
+void Graphics::MarkLineDirty( int x0, int y0, int x1, int y1 )
+{
+    ForEachLineBand( x0, y0, x1, y1, height, TileSize, [this]( int x, int y, int w, int h )
+    {
+        MarkDirty( x, y, w, h );
+    } );
+}
+
+void Graphics::UploadDirtyTiles( const std::uint32_t* pSrcBuffer, std::vector<std::uint64_t>& tiles )
+{
+    // Runs of adjacent dirty tiles go up as one rectangle. Full-width runs
+    // are contiguous in the back buffer and go straight to the texture;
+    // narrower ones are packed into a staging buffer first because
+    // sf::Texture::update wants tightly packed rows.
+    ForEachTileRun( tiles, tilesX, tilesY, width, height, [this, pSrcBuffer]( int x, int y, int w, int h )
+    {
+        const std::uint32_t* pSrc = pSrcBuffer + y * pitch + x;
+        if( !texture )
+        {
+            PresentScaled( pSrc, pitch, x, y, w, h );
+            return;
+        }
+        if( w != pitch )
+        {
+            std::uint32_t* pDst = uploadStaging.data();
+            for( int row = 0; row < h; ++row, pDst += w )
+            {
+                std::memcpy( pDst, pSrc + row * pitch, sizeof( std::uint32_t ) * w );
+            }
+            pSrc = uploadStaging.data();
+        }
+        texture->update( reinterpret_cast<const std::uint8_t*>(pSrc),
+            { static_cast<unsigned int>(w), static_cast<unsigned int>(h) },
+            { static_cast<unsigned int>(x), static_cast<unsigned int>(y) } );
+    } );
+    std::fill( tiles.begin(), tiles.end(), 0u );
+}
+
+void Graphics::PresentScaled( const std::uint32_t* pSrc, int srcPitch, int x, int y, int w, int h )
+{
+    if( presentScale == 1 )
+    {
+        wnd.PresentRect( pSrc, srcPitch, presentX + x, presentY + y, w, h );
+        return;
+    }
+    // Each source row is widened once and then presented presentScale
+    // times by handing it over with a pitch of 0
+    for( int row = 0; row < h; ++row, pSrc += srcPitch )
+    {
+        UpscaleRow( scaledRow.data(), pSrc, w, presentScale );
+        wnd.PresentRect( scaledRow.data(), 0, presentX + x * presentScale, presentY + (y + row) * presentScale,
+            w * presentScale, presentScale );
+    }
+}
+
+void Graphics::Present()
+{
+    if( pWindow != nullptr )
+    {
+        if( width * presentScale != wnd.GetWidth() || height * presentScale != wnd.GetHeight() )
+        {
+            // Letterbox bars; display() leaves the back buffer undefined
+            pWindow->clear( sf::Color::Black );
+        }
+        // The sprite is one textured quad: the upscaled surface, copied
+        // without blending
+        pWindow->draw( *sprite, sf::RenderStates( sf::BlendNone ) );
+    }
+    wnd.Display();
+}
+
+void Graphics::SubmitPresentSlot( const std::uint32_t* pSrcBuffer )
+{
+    std::unique_lock<std::mutex> lock( presentMutex );
+    // The bounded-latency wait: with every slot queued the game is as far
+    // ahead of the screen as allowed
+    presentCv.wait( lock, [this] { return presentQueued < static_cast<int>(presentSlots.size()); } );
+    PresentSlot& slot = presentSlots[(presentRead + presentQueued) % presentSlots.size()];
+    lock.unlock();
+
+    ForEachTileRun( dirtyTiles, tilesX, tilesY, width, height, [this, &slot, pSrcBuffer]( int x, int y, int w, int h )
+    {
+        for( int row = y; row < y + h; ++row )
+        {
+            std::memcpy( slot.pixels.data() + row * pitch + x, pSrcBuffer + row * pitch + x, sizeof( std::uint32_t ) * w );
+        }
+    } );
+    // The slot's mask was cleared by its last upload, so this swap also
+    // resets dirtyTiles for the next frame
+    slot.dirtyTiles.swap( dirtyTiles );
+
+    lock.lock();
+    ++presentQueued;
+    lock.unlock();
+    presentCv.notify_all();
+}
+
+void Graphics::RenderThreadMain()
+{
+    if( pWindow != nullptr )
+    {
+        (void)pWindow->setActive( true );
+    }
+    std::unique_lock<std::mutex> lock( presentMutex );
+    while( true )
+    {
+        presentCv.wait( lock, [this] { return presentQueued > 0 || stopPresenting; } );
+        if( presentQueued == 0 )
+        {
+            break;
+        }
+        // The slot stays counted as queued until it is on screen, so the
+        // game never writes into a slot that is being uploaded
+        PresentSlot& slot = presentSlots[presentRead];
+        lock.unlock();
+        UploadDirtyTiles( slot.pixels.data(), slot.dirtyTiles );
+        Present();
+        lock.lock();
+        presentRead = (presentRead + 1) % static_cast<int>(presentSlots.size());
+        --presentQueued;
+        presentCv.notify_all();
+    }
+    lock.unlock();
+    if( pWindow != nullptr )
+    {
+        (void)pWindow->setActive( false );
+    }
+}
+
+void Graphics::StopRenderThread()
+{
+    if( !renderThread.joinable() )
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock( presentMutex );
+        stopPresenting = true;
+    }
+    presentCv.notify_all();
+    // The render thread drains the queue before it exits
+    renderThread.join();
+    stopPresenting = false;
+    if( pWindow != nullptr )
+    {
+        (void)pWindow->setActive( true );
+    }
+}
+
+void Graphics::Record( const DrawCommand& cmd, int x, int y, int w, int h )
+{
+    const std::uint32_t cmdIndex = static_cast<std::uint32_t>(commands.size());
+    commands.push_back( cmd );
+    BinRect( cmdIndex, x, y, w, h );
+}
+
+void Graphics::RecordLine( const DrawCommand& cmd )
+{
+    const std::uint32_t cmdIndex = static_cast<std::uint32_t>(commands.size());
+    commands.push_back( cmd );
+    ForEachLineBand( cmd.a, cmd.b, cmd.c, cmd.d, height, TileSize, [this, cmdIndex]( int x, int y, int w, int h )
+    {
+        BinRect( cmdIndex, x, y, w, h );
+    } );
+}
+
+void Graphics::BinRect( std::uint32_t cmdIndex, int x, int y, int w, int h )
+{
+    const int left = std::max( x, 0 );
+    const int top = std::max( y, 0 );
+    const int right = std::min( x + w, width );
+    const int bottom = std::min( y + h, height );
+    if( left >= right || top >= bottom )
+    {
+        return;
+    }
+    for( int ty = top / TileSize; ty <= (bottom - 1) / TileSize; ++ty )
+    {
+        for( int tx = left / TileSize; tx <= (right - 1) / TileSize; ++tx )
+        {
+            const int tile = ty * tilesX + tx;
+            auto& bin = tileBins[tile];
+            if( bin.empty() )
+            {
+                activeTiles.push_back( tile );
+            }
+            bin.push_back( cmdIndex );
+        }
+    }
+}
+
+void Graphics::FlushCommands()
+{
+    if( commands.empty() )
+    {
+        return;
+    }
+    if( !pRasterPool )
+    {
+        pRasterPool = std::make_unique<WorkerPool>( rasterThreads );
+    }
+    // Each tile replays its commands in submission order clipped to its own
+    // rect. Tiles never overlap, so the result does not depend on how many
+    // threads run or which one gets which tile.
+    Rasterize( [&]( const auto& s )
+    {
+        using Pixel = PixelOf<std::decay_t<decltype( s )>>;
+        pRasterPool->ParallelFor( static_cast<int>(activeTiles.size()), [&]( int i )
+        {
+            const int tile = activeTiles[i];
+            const int tx = tile % tilesX;
+            const int ty = tile / tilesX;
+            const ClipRect clip = {
+                tx * TileSize,
+                ty * TileSize,
+                std::min( (tx + 1) * TileSize, width ),
+                std::min( (ty + 1) * TileSize, height ) };
+            for( const std::uint32_t cmdIndex : tileBins[tile] )
+            {
+                const DrawCommand& cmd = commands[cmdIndex];
+                switch( cmd.type )
+                {
+                case DrawCommand::Type::Pixel:
+                    s.pixels[cmd.b * s.pitch + cmd.a] = static_cast<Pixel>(cmd.color);
+                    break;
+                case DrawCommand::Type::Span:
+                    RasterSpan( s, clip, cmd.a, cmd.b, cmd.c, cmd.color );
+                    break;
+                case DrawCommand::Type::Rect:
+                    RasterRect( s, clip, cmd.a, cmd.b, cmd.c, cmd.d, cmd.color );
+                    break;
+                case DrawCommand::Type::Line:
+                    RasterLine( s, clip, cmd.a, cmd.b, cmd.c, cmd.d, cmd.color );
+                    break;
+                case DrawCommand::Type::Circle:
+                    RasterCircle( s, clip, cmd.a, cmd.b, cmd.c, cmd.color );
+                    break;
+                case DrawCommand::Type::FilledCircle:
+                    RasterFilledCircle( s, clip, cmd.a, cmd.b, cmd.c, cmd.color );
+                    break;
+                case DrawCommand::Type::Sprite:
+                    if constexpr( std::is_same_v<Pixel, std::uint32_t> )
+                    {
+                        RasterSprite( s, clip, cmd.a, cmd.b, *cmd.pSurface, cmd.e, cmd.f, cmd.c, cmd.d, cmd.blend, cmd.color );
+                    }
+                    else
+                    {
+                        RasterThroughPalette( clip.left, clip.top, clip.right, clip.bottom,
+                            [&]( const RawSurface& rgba, const ClipRect& tileClip )
+                            {
+                                RasterSprite( rgba, tileClip, cmd.a, cmd.b, *cmd.pSurface, cmd.e, cmd.f, cmd.c, cmd.d, cmd.blend, cmd.color );
+                            } );
+                    }
+                    break;
+                case DrawCommand::Type::Glyph:
+                    RasterGlyph( s, clip, cmd.a, cmd.b, BitmapFont::GetGlyph( static_cast<char>(cmd.c) ), cmd.d, cmd.color );
+                    break;
+                case DrawCommand::Type::TexturedTriangle:
+                    if constexpr( std::is_same_v<Pixel, std::uint32_t> )
+                    {
+                        RasterTexturedTriangle( s, texTriangles[cmd.a], clip.left, clip.top, clip.right, clip.bottom );
+                    }
+                    else
+                    {
+                        const TexturedTriangle& tri = texTriangles[cmd.a];
+                        RasterThroughPalette( std::max( clip.left, tri.left ), std::max( clip.top, tri.top ),
+                            std::min( clip.right, tri.right ), std::min( clip.bottom, tri.bottom ),
+                            [&]( const RawSurface& rgba, const ClipRect& tileClip )
+                            {
+                                RasterTexturedTriangle( rgba, tri, tileClip.left, tileClip.top, tileClip.right, tileClip.bottom );
+                            } );
+                    }
+                    break;
+                }
+            }
+            tileBins[tile].clear();
+        } );
+    } );
+    activeTiles.clear();
+    commands.clear();
+    texTriangles.clear();
+}
+
+void Graphics::DrawList::PutPixel( int x, int y, Color c )
+{
+    Add( DrawCommand::Type::Pixel, c.dword, false, x, y, 0, 0 );
+}
+
+void Graphics::DrawList::PutPixel( int x, int y, std::uint8_t index )
+{
+    Add( DrawCommand::Type::Pixel, index, true, x, y, 0, 0 );
+}
+
+void Graphics::DrawList::DrawHLine( int x0, int x1, int y, Color c )
+{
+    Add( DrawCommand::Type::Span, c.dword, false, x0, x1, y, 0 );
+}
+
+void Graphics::DrawList::DrawHLine( int x0, int x1, int y, std::uint8_t index )
+{
+    Add( DrawCommand::Type::Span, index, true, x0, x1, y, 0 );
+}
+
+void Graphics::DrawList::DrawRect( int x, int y, int w, int h, Color c )
+{
+    Add( DrawCommand::Type::Rect, c.dword, false, x, y, w, h );
+}
+
+void Graphics::DrawList::DrawRect( int x, int y, int w, int h, std::uint8_t index )
+{
+    Add( DrawCommand::Type::Rect, index, true, x, y, w, h );
+}
+
+void Graphics::DrawList::DrawLine( int x0, int y0, int x1, int y1, Color c )
+{
+    Add( DrawCommand::Type::Line, c.dword, false, x0, y0, x1, y1 );
+}
+
+void Graphics::DrawList::DrawLine( int x0, int y0, int x1, int y1, std::uint8_t index )
+{
+    Add( DrawCommand::Type::Line, index, true, x0, y0, x1, y1 );
+}
+
+void Graphics::DrawList::DrawCircle( int cx, int cy, int radius, Color c )
+{
+    Add( DrawCommand::Type::Circle, c.dword, false, cx, cy, radius, 0 );
+}
+
+void Graphics::DrawList::DrawCircle( int cx, int cy, int radius, std::uint8_t index )
+{
+    Add( DrawCommand::Type::Circle, index, true, cx, cy, radius, 0 );
+}
+
+void Graphics::DrawList::FillCircle( int cx, int cy, int radius, Color c )
+{
+    Add( DrawCommand::Type::FilledCircle, c.dword, false, cx, cy, radius, 0 );
+}
+
+void Graphics::DrawList::FillCircle( int cx, int cy, int radius, std::uint8_t index )
+{
+    Add( DrawCommand::Type::FilledCircle, index, true, cx, cy, radius, 0 );
+}
+
+void Graphics::DrawList::DrawText( int x, int y, std::string_view text, Color c, int scale )
+{
+    AddText( x, y, text, c.dword, false, scale );
+}
+
+void Graphics::DrawList::DrawText( int x, int y, std::string_view text, std::uint8_t index, int scale )
+{
+    AddText( x, y, text, index, true, scale );
+}
+
+void Graphics::DrawList::DrawSprite( int x, int y, const Surface& s, SpriteBlend blend, Color key )
+{
+    DrawSprite( x, y, s, { { 0, 0 }, { s.GetWidth(), s.GetHeight() } }, blend, key );
+}
+
+void Graphics::DrawList::DrawSprite( int x, int y, const Surface& s, const sf::IntRect& srcRect, SpriteBlend blend, Color key )
+{
+    // Trimmed against the surface at replay, like a direct DrawSprite
+    DrawCommand cmd = { DrawCommand::Type::Sprite, blend, key.dword, x, y, srcRect.position.x, srcRect.position.y };
+    cmd.e = srcRect.size.x;
+    cmd.f = srcRect.size.y;
+    cmd.pSurface = &s;
+    commands.push_back( cmd );
+}
+
+void Graphics::DrawList::DrawTexturedTriangle( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const Surface& s,
+    TextureFilter filter, SpriteBlend blend, Color key )
+{
+    AddTriangle( v0, v1, v2, s, { { 0, 0 }, { s.GetWidth(), s.GetHeight() } }, filter, blend, key );
+}
+
+void Graphics::DrawList::DrawTexturedQuad( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const TexVertex& v3,
+    const Surface& s, TextureFilter filter, SpriteBlend blend, Color key )
+{
+    DrawTexturedTriangle( v0, v1, v2, s, filter, blend, key );
+    DrawTexturedTriangle( v0, v2, v3, s, filter, blend, key );
+}
+
+void Graphics::DrawList::DrawSpriteTransformed( float cx, float cy, const Surface& s, float angle, float scale,
+    TextureFilter filter, SpriteBlend blend, Color key )
+{
+    DrawSpriteTransformed( cx, cy, s, { { 0, 0 }, { s.GetWidth(), s.GetHeight() } }, angle, scale, filter, blend, key );
+}
+
+void Graphics::DrawList::DrawSpriteTransformed( float cx, float cy, const Surface& s, const sf::IntRect& srcRect, float angle,
+    float scale, TextureFilter filter, SpriteBlend blend, Color key )
+{
+    const std::optional<sf::IntRect> texRect = srcRect.findIntersection( { { 0, 0 }, { s.GetWidth(), s.GetHeight() } } );
+    if( !texRect )
+    {
+        return;
+    }
+    TexVertex corners[4];
+    SpriteCorners( cx, cy, srcRect, angle, scale, corners );
+    AddTriangle( corners[0], corners[1], corners[2], s, *texRect, filter, blend, key );
+    AddTriangle( corners[0], corners[2], corners[3], s, *texRect, filter, blend, key );
+}
+
+void Graphics::DrawList::Reset()
+{
+    commands.clear();
+    vertices.clear();
+}
+
+std::size_t Graphics::DrawList::GetCommandCount() const
+{
+    return commands.size();
+}
+
+void Graphics::DrawList::Add( DrawCommand::Type type, std::uint32_t value, bool indexed, int a, int b, int c, int d )
+{
+    DrawCommand cmd = { type, SpriteBlend::Copy, value, a, b, c, d };
+    cmd.indexed = indexed;
+    commands.push_back( cmd );
+}
+
+void Graphics::DrawList::AddText( int x, int y, std::string_view text, std::uint32_t value, bool indexed, int scale )
+{
+    // Laid out now, clipped at replay; spaces only advance the pen
+    scale = std::max( scale, 1 );
+    const int size = BitmapFont::GlyphSize * scale;
+    int penX = x;
+    int penY = y;
+    for( const char ch : text )
+    {
+        if( ch == '\n' )
+        {
+            penX = x;
+            penY += size;
+            continue;
+        }
+        if( ch != ' ' )
+        {
+            Add( DrawCommand::Type::Glyph, value, indexed, penX, penY, static_cast<unsigned char>(ch), scale );
+        }
+        penX += size;
+    }
+}
+
+void Graphics::DrawList::AddTriangle( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const Surface& s,
+    const sf::IntRect& texRect, TextureFilter filter, SpriteBlend blend, Color key )
+{
+    DrawCommand cmd = { DrawCommand::Type::TexturedTriangle, blend, key.dword, static_cast<int>(vertices.size()),
+        static_cast<int>(filter), texRect.position.x, texRect.position.y };
+    cmd.e = texRect.size.x;
+    cmd.f = texRect.size.y;
+    cmd.pSurface = &s;
+    commands.push_back( cmd );
+    vertices.push_back( v0 );
+    vertices.push_back( v1 );
+    vertices.push_back( v2 );
+}
+
+// Surface Implementation
+namespace
+{
+    constexpr std::size_t SurfaceAlignment = 64u;
+    constexpr int SurfacePitchPixels = int( SurfaceAlignment / sizeof( Color ) );
+}
+
+Surface::Surface( int width, int height )
+{
+    Allocate( width, height );
+    Fill( Color( 0u ) );
+}
+
+Surface::Surface( const std::string& filename )
+{
+    int w = 0;
+    int h = 0;
+    int channels = 0;
+    stbi_uc* pData = stbi_load( filename.c_str(), &w, &h, &channels, 4 );
+    if( pData == nullptr )
+    {
+        throw std::runtime_error( "Surface: cannot load " + filename + ": " + stbi_failure_reason() );
+    }
+    Allocate( w, h );
+    const stbi_uc* pSrc = pData;
+    for( int y = 0; y < h; ++y )
+    {
+        Color* pRow = pPixels + y * pitch;
+        for( int x = 0; x < w; ++x, pSrc += 4 )
+        {
+            // Premultiply once here so blending never has to
+            const std::uint32_t a = pSrc[3];
+            pRow[x] = Color(
+                static_cast<unsigned char>(Div255( pSrc[0] * a )),
+                static_cast<unsigned char>(Div255( pSrc[1] * a )),
+                static_cast<unsigned char>(Div255( pSrc[2] * a )),
+                static_cast<unsigned char>(a) );
+        }
+    }
+    stbi_image_free( pData );
+}
+
+Surface::Surface( const Surface& rhs )
+{
+    Allocate( rhs.width, rhs.height );
+    std::memcpy( pPixels, rhs.pPixels, sizeof( Color ) * pitch * height );
+}
+
+Surface::Surface( Surface&& donor ) noexcept
+    : pPixels( std::exchange( donor.pPixels, nullptr ) ),
+      width( std::exchange( donor.width, 0 ) ),
+      height( std::exchange( donor.height, 0 ) ),
+      pitch( std::exchange( donor.pitch, 0 ) )
+{
+}
+
+Surface& Surface::operator=( const Surface& rhs )
+{
+    if( this != &rhs )
+    {
+        *this = Surface( rhs );
+    }
+    return *this;
+}
+
+Surface& Surface::operator=( Surface&& rhs ) noexcept
+{
+    if( this != &rhs )
+    {
+        Release();
+        pPixels = std::exchange( rhs.pPixels, nullptr );
+        width = std::exchange( rhs.width, 0 );
+        height = std::exchange( rhs.height, 0 );
+        pitch = std::exchange( rhs.pitch, 0 );
+    }
+    return *this;
+}
+
+Surface::~Surface()
+{
+    Release();
+}
+
+void Surface::PutPixel( int x, int y, Color c )
+{
+    if( x >= 0 && x < width && y >= 0 && y < height )
+    {
+        pPixels[y * pitch + x] = c;
+    }
+}
+
+Color Surface::GetPixel( int x, int y ) const
+{
+    return pPixels[y * pitch + x];
+}
+
+void Surface::Fill( Color c )
+{
+    std::fill( pPixels, pPixels + pitch * height, c );
+}
+
+int Surface::GetWidth() const
+{
+    return width;
+}
+
+int Surface::GetHeight() const
+{
+    return height;
+}
+
+int Surface::GetPitch() const
+{
+    return pitch;
+}
+
+const Color* Surface::Data() const
+{
+    return pPixels;
+}
+
+Color* Surface::Data()
+{
+    return pPixels;
+}
+
+void Surface::Allocate( int w, int h )
+{
+    width = std::max( w, 0 );
+    height = std::max( h, 0 );
+    pitch = (width + SurfacePitchPixels - 1) / SurfacePitchPixels * SurfacePitchPixels;
+    pPixels = static_cast<Color*>(::operator new[](
+        sizeof( Color ) * std::max( pitch * height, 1 ), std::align_val_t( SurfaceAlignment ) ));
+}
+
+void Surface::Release()
+{
+    if( pPixels != nullptr )
+    {
+        ::operator delete[]( pPixels, std::align_val_t( SurfaceAlignment ) );
+        pPixels = nullptr;
+    }
+}
+
+// PostProcess Implementation
+namespace
+{
+    // Rows per parallel work item, and the column strip the vertical blur
+    // pass walks at a time: the 2 * MaxBlurRadius + 1 rows of a 128 pixel
+    // strip fit in a 32 KB L1
+    constexpr int PostBandRows = 16;
+    constexpr int PostStripPixels = 128;
+
+    // One output pixel of sum( weights[k] * taps[k][x] ) in 8.8 fixed point.
+    // Weights add up to 256, so every channel sum fits in 16 bits, which is
+    // what lets the SIMD kernels accumulate in 16-bit lanes.
+    inline std::uint32_t ConvolvePixel( const std::uint32_t* const* pTaps, const std::uint16_t* pWeights, int taps, int x )
+    {
+        std::uint32_t r = 128u;
+        std::uint32_t g = 128u;
+        std::uint32_t b = 128u;
+        std::uint32_t a = 128u;
+        for( int k = 0; k < taps; ++k )
+        {
+            const std::uint32_t p = pTaps[k][x];
+            const std::uint32_t w = pWeights[k];
+            r += (p & 0xFFu) * w;
+            g += (p >> 8 & 0xFFu) * w;
+            b += (p >> 16 & 0xFFu) * w;
+            a += (p >> 24) * w;
+        }
+        return r >> 8 | (g >> 8) << 8 | (b >> 8) << 16 | (a >> 8) << 24;
+    }
+
+    // Kernels are symmetric, so mirrored taps are added before the multiply.
+    // Off-center weights are at most 128, so a pair still fits 16 bits.
+    void ConvolveSpan( std::uint32_t* pDst, const std::uint32_t* const* pTaps, const std::uint16_t* pWeights, int radius, int x0, int x1 )
+    {
+        const int taps = 2 * radius + 1;
+        int x = x0;
+#if defined( __AVX2__ )
+        const __m256i round = _mm256_set1_epi16( 128 );
+        auto load4 = []( const std::uint32_t* p )
+        {
+            return _mm256_cvtepu8_epi16( _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) ) );
+        };
+        auto store4 = []( std::uint32_t* p, __m256i acc )
+        {
+            acc = _mm256_srli_epi16( acc, 8 );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(p),
+                _mm_packus_epi16( _mm256_castsi256_si128( acc ), _mm256_extracti128_si256( acc, 1 ) ) );
+        };
+        for( ; x + 8 <= x1; x += 8 )
+        {
+            const __m256i center = _mm256_set1_epi16( static_cast<short>(pWeights[radius]) );
+            __m256i acc0 = _mm256_add_epi16( round, _mm256_mullo_epi16( load4( pTaps[radius] + x ), center ) );
+            __m256i acc1 = _mm256_add_epi16( round, _mm256_mullo_epi16( load4( pTaps[radius] + x + 4 ), center ) );
+            for( int k = 0; k < radius; ++k )
+            {
+                const std::uint32_t* pA = pTaps[k] + x;
+                const std::uint32_t* pB = pTaps[taps - 1 - k] + x;
+                const __m256i w = _mm256_set1_epi16( static_cast<short>(pWeights[k]) );
+                acc0 = _mm256_add_epi16( acc0, _mm256_mullo_epi16( _mm256_add_epi16( load4( pA ), load4( pB ) ), w ) );
+                acc1 = _mm256_add_epi16( acc1, _mm256_mullo_epi16( _mm256_add_epi16( load4( pA + 4 ), load4( pB + 4 ) ), w ) );
+            }
+            store4( pDst + x, acc0 );
+            store4( pDst + x + 4, acc1 );
+        }
+#elif defined( __SSE2__ )
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i round = _mm_set1_epi16( 128 );
+        for( ; x + 4 <= x1; x += 4 )
+        {
+            const __m128i center = _mm_set1_epi16( static_cast<short>(pWeights[radius]) );
+            const __m128i c = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pTaps[radius] + x) );
+            __m128i lo = _mm_add_epi16( round, _mm_mullo_epi16( _mm_unpacklo_epi8( c, zero ), center ) );
+            __m128i hi = _mm_add_epi16( round, _mm_mullo_epi16( _mm_unpackhi_epi8( c, zero ), center ) );
+            for( int k = 0; k < radius; ++k )
+            {
+                const __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pTaps[k] + x) );
+                const __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pTaps[taps - 1 - k] + x) );
+                const __m128i w = _mm_set1_epi16( static_cast<short>(pWeights[k]) );
+                lo = _mm_add_epi16( lo, _mm_mullo_epi16( _mm_add_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ) ), w ) );
+                hi = _mm_add_epi16( hi, _mm_mullo_epi16( _mm_add_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ) ), w ) );
+            }
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst + x),
+                _mm_packus_epi16( _mm_srli_epi16( lo, 8 ), _mm_srli_epi16( hi, 8 ) ) );
+        }
+#else
+        // The same 16-bit sums over the bytes of a run of pixels, written as
+        // flat loops the compiler vectorizes (NEON on Apple silicon)
+        constexpr int RunBytes = 64;
+        for( ; x + RunBytes / 4 <= x1; x += RunBytes / 4 )
+        {
+            std::uint16_t acc[RunBytes];
+            const std::uint8_t* pCenter = reinterpret_cast<const std::uint8_t*>(pTaps[radius] + x);
+            const std::uint16_t center = pWeights[radius];
+            for( int i = 0; i < RunBytes; ++i )
+            {
+                acc[i] = static_cast<std::uint16_t>(128u + pCenter[i] * center);
+            }
+            for( int k = 0; k < radius; ++k )
+            {
+                const std::uint8_t* pA = reinterpret_cast<const std::uint8_t*>(pTaps[k] + x);
+                const std::uint8_t* pB = reinterpret_cast<const std::uint8_t*>(pTaps[taps - 1 - k] + x);
+                const std::uint16_t w = pWeights[k];
+                for( int i = 0; i < RunBytes; ++i )
+                {
+                    acc[i] = static_cast<std::uint16_t>(acc[i] + (pA[i] + pB[i]) * w);
+                }
+            }
+            std::uint8_t* pOut = reinterpret_cast<std::uint8_t*>(pDst + x);
+            for( int i = 0; i < RunBytes; ++i )
+            {
+                pOut[i] = static_cast<std::uint8_t>(acc[i] >> 8);
+            }
+        }
+#endif
+        for( ; x < x1; ++x )
+        {
+            pDst[x] = ConvolvePixel( pTaps, pWeights, taps, x );
+        }
+    }
+
+    // Horizontal pass over one row. The edges run the same kernel over a
+    // small copy of the row with its end pixels repeated, so no tap ever
+    // needs clamping inside the loop.
+    void ConvolveRow( std::uint32_t* pDst, const std::uint32_t* pSrc, int width, const std::uint16_t* pWeights, int radius )
+    {
+        const int taps = 2 * radius + 1;
+        const std::uint32_t* pTaps[2 * PostProcess::MaxBlurRadius + 1] = {};
+        auto convolveClamped = [&]( int x0, int x1 )
+        {
+            std::uint32_t padded[4 * PostProcess::MaxBlurRadius + 1];
+            for( int i = 0; i < x1 - x0 + 2 * radius; ++i )
+            {
+                padded[i] = pSrc[std::clamp( x0 - radius + i, 0, width - 1 )];
+            }
+            for( int k = 0; k < taps; ++k )
+            {
+                pTaps[k] = padded + k;
+            }
+            ConvolveSpan( pDst + x0, pTaps, pWeights, radius, 0, x1 - x0 );
+        };
+        if( width <= 2 * radius )
+        {
+            convolveClamped( 0, width );
+            return;
+        }
+        convolveClamped( 0, radius );
+        for( int k = 0; k < taps; ++k )
+        {
+            pTaps[k] = pSrc + k;
+        }
+        ConvolveSpan( pDst + radius, pTaps, pWeights, radius, 0, width - 2 * radius );
+        convolveClamped( width - radius, width );
+    }
+
+    // Bloom is upsampled 2x bilinearly: a frame pixel sits a quarter of a
+    // bloom pixel from its nearest one, so the weights are 3:1 per axis.
+    // First the vertical blend, 3 * near + far per channel in 16 bits,
+    // into a row with one repeated pixel of padding at each end.
+    void BlendBloomRows( std::uint16_t* pDst, const std::uint32_t* pNear, const std::uint32_t* pFar, int count )
+    {
+        std::uint16_t* pOut = pDst + 4;
+        int x = 0;
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+        const __m128i zero = _mm_setzero_si128();
+        for( ; x + 4 <= count; x += 4 )
+        {
+            const __m128i n = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pNear + x) );
+            const __m128i f = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pFar + x) );
+            const __m128i nLo = _mm_unpacklo_epi8( n, zero );
+            const __m128i nHi = _mm_unpackhi_epi8( n, zero );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pOut + 4 * x),
+                _mm_add_epi16( _mm_add_epi16( _mm_add_epi16( nLo, nLo ), nLo ), _mm_unpacklo_epi8( f, zero ) ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pOut + 4 * x + 8),
+                _mm_add_epi16( _mm_add_epi16( _mm_add_epi16( nHi, nHi ), nHi ), _mm_unpackhi_epi8( f, zero ) ) );
+        }
+#endif
+        // Byte order within a pixel does not matter here, so the rest is a
+        // flat loop over channel bytes
+        const std::uint8_t* pNearBytes = reinterpret_cast<const std::uint8_t*>(pNear);
+        const std::uint8_t* pFarBytes = reinterpret_cast<const std::uint8_t*>(pFar);
+        for( int i = 4 * x; i < 4 * count; ++i )
+        {
+            pOut[i] = static_cast<std::uint16_t>(3u * pNearBytes[i] + pFarBytes[i]);
+        }
+        std::memcpy( pDst, pOut, 4 * sizeof( std::uint16_t ) );
+        std::memcpy( pOut + 4 * count, pOut + 4 * (count - 1), 4 * sizeof( std::uint16_t ) );
+    }
+
+    // Then the horizontal blend of a padded row into width frame pixels,
+    // rounding the 16x weighted sum back to 8 bits
+    void UpsampleBloomRow( std::uint32_t* pDst, const std::uint16_t* pBlend, int width )
+    {
+        const std::uint16_t* pIn = pBlend + 4;
+        int x = 0;
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+        const __m128i round = _mm_set1_epi16( 8 );
+        for( ; x + 4 <= width; x += 4 )
+        {
+            // Bloom pixels i and i + 1 become frame pixels 2i .. 2i + 3
+            const std::uint16_t* p = pIn + 2 * x;
+            const __m128i cur = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p) );
+            const __m128i prev = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p - 4) );
+            const __m128i next = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p + 4) );
+            const __m128i cur3 = _mm_add_epi16( _mm_add_epi16( _mm_add_epi16( cur, cur ), cur ), round );
+            const __m128i left = _mm_srli_epi16( _mm_add_epi16( cur3, prev ), 4 );
+            const __m128i right = _mm_srli_epi16( _mm_add_epi16( cur3, next ), 4 );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst + x),
+                _mm_packus_epi16( _mm_unpacklo_epi64( left, right ), _mm_unpackhi_epi64( left, right ) ) );
+        }
+#endif
+        // x is even here; each bloom pixel makes a left and a right pixel
+        std::uint8_t* pOut = reinterpret_cast<std::uint8_t*>(pDst);
+        for( ; x < width; x += 2 )
+        {
+            const std::uint16_t* p = pIn + 2 * x;
+            for( int c = 0; c < 4; ++c )
+            {
+                const unsigned int cur3 = 3u * p[c] + 8u;
+                pOut[4 * x + c] = static_cast<std::uint8_t>((cur3 + p[c - 4]) >> 4);
+                if( x + 1 < width )
+                {
+                    pOut[4 * x + 4 + c] = static_cast<std::uint8_t>((cur3 + p[c + 4]) >> 4);
+                }
+            }
+        }
+    }
+
+    // (a * (256 - f) + b * f) / 256 per channel, f in [0, 256], two
+    // channels per multiply
+    inline std::uint32_t LerpPacked( std::uint32_t a, std::uint32_t b, std::uint32_t f )
+    {
+        const std::uint32_t g = 256u - f;
+        const std::uint32_t even = ((a & 0x00FF00FFu) * g + (b & 0x00FF00FFu) * f) >> 8 & 0x00FF00FFu;
+        const std::uint32_t odd = ((a >> 8 & 0x00FF00FFu) * g + (b >> 8 & 0x00FF00FFu) * f) & 0xFF00FF00u;
+        return even | odd;
+    }
+
+    inline std::uint32_t GradePixel( std::uint32_t p, const std::uint32_t* pLut, const std::uint32_t* pCoord, int size )
+    {
+        const std::uint32_t cr = pCoord[p & 0xFFu];
+        const std::uint32_t cg = pCoord[p >> 8 & 0xFFu];
+        const std::uint32_t cb = pCoord[p >> 16 & 0xFFu];
+        const int plane = size * size;
+        const std::uint32_t* pCell = pLut + ((cb & 0xFFFFu) * plane + (cg & 0xFFFFu) * size + (cr & 0xFFFFu));
+        const std::uint32_t fr = cr >> 16;
+        const std::uint32_t c00 = LerpPacked( pCell[0], pCell[1], fr );
+        const std::uint32_t c10 = LerpPacked( pCell[size], pCell[size + 1], fr );
+        const std::uint32_t c01 = LerpPacked( pCell[plane], pCell[plane + 1], fr );
+        const std::uint32_t c11 = LerpPacked( pCell[plane + size], pCell[plane + size + 1], fr );
+        const std::uint32_t fg = cg >> 16;
+        return LerpPacked( LerpPacked( c00, c10, fg ), LerpPacked( c01, c11, fg ), cb >> 16 );
+    }
+
+#if defined( __AVX2__ )
+    inline __m256i LerpPacked8( __m256i a, __m256i b, __m256i f )
+    {
+        // Each 32-bit lane holds two 16-bit channel slots, so the weight
+        // goes in both halves and 16-bit multiplies do two channels at once
+        const __m256i mask = _mm256_set1_epi32( 0x00FF00FF );
+        const __m256i f2 = _mm256_or_si256( f, _mm256_slli_epi32( f, 16 ) );
+        const __m256i g2 = _mm256_sub_epi16( _mm256_set1_epi16( 256 ), f2 );
+        const __m256i even = _mm256_srli_epi16( _mm256_add_epi16(
+            _mm256_mullo_epi16( _mm256_and_si256( a, mask ), g2 ),
+            _mm256_mullo_epi16( _mm256_and_si256( b, mask ), f2 ) ), 8 );
+        const __m256i odd = _mm256_add_epi16(
+            _mm256_mullo_epi16( _mm256_and_si256( _mm256_srli_epi32( a, 8 ), mask ), g2 ),
+            _mm256_mullo_epi16( _mm256_and_si256( _mm256_srli_epi32( b, 8 ), mask ), f2 ) );
+        return _mm256_or_si256( even, _mm256_andnot_si256( _mm256_set1_epi32( 0x00FF00FF ), odd ) );
+    }
+#endif
+
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+    inline __m128i LerpPacked4( __m128i a, __m128i b, __m128i f )
+    {
+        const __m128i mask = _mm_set1_epi32( 0x00FF00FF );
+        const __m128i f2 = _mm_or_si128( f, _mm_slli_epi32( f, 16 ) );
+        const __m128i g2 = _mm_sub_epi16( _mm_set1_epi16( 256 ), f2 );
+        const __m128i even = _mm_srli_epi16( _mm_add_epi16(
+            _mm_mullo_epi16( _mm_and_si128( a, mask ), g2 ),
+            _mm_mullo_epi16( _mm_and_si128( b, mask ), f2 ) ), 8 );
+        const __m128i odd = _mm_add_epi16(
+            _mm_mullo_epi16( _mm_and_si128( _mm_srli_epi32( a, 8 ), mask ), g2 ),
+            _mm_mullo_epi16( _mm_and_si128( _mm_srli_epi32( b, 8 ), mask ), f2 ) );
+        return _mm_or_si128( even, _mm_andnot_si128( mask, odd ) );
+    }
+#endif
+
+    void GradeRow( std::uint32_t* pDst, const std::uint32_t* pSrc, int count, const std::uint32_t* pLut, const std::uint32_t* pCoord, int size )
+    {
+        int x = 0;
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+        const int plane = size * size;
+#endif
+#if defined( __AVX2__ )
+        const int* pCoordInts = reinterpret_cast<const int*>(pCoord);
+        const int* pLutInts = reinterpret_cast<const int*>(pLut);
+        const __m256i byteMask = _mm256_set1_epi32( 0xFF );
+        const __m256i cellMask = _mm256_set1_epi32( 0xFFFF );
+        for( ; x + 8 <= count; x += 8 )
+        {
+            const __m256i p = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pSrc + x) );
+            const __m256i cr = _mm256_i32gather_epi32( pCoordInts, _mm256_and_si256( p, byteMask ), 4 );
+            const __m256i cg = _mm256_i32gather_epi32( pCoordInts, _mm256_and_si256( _mm256_srli_epi32( p, 8 ), byteMask ), 4 );
+            const __m256i cb = _mm256_i32gather_epi32( pCoordInts, _mm256_and_si256( _mm256_srli_epi32( p, 16 ), byteMask ), 4 );
+            const __m256i cell = _mm256_add_epi32( _mm256_add_epi32(
+                _mm256_mullo_epi32( _mm256_and_si256( cb, cellMask ), _mm256_set1_epi32( plane ) ),
+                _mm256_mullo_epi32( _mm256_and_si256( cg, cellMask ), _mm256_set1_epi32( size ) ) ),
+                _mm256_and_si256( cr, cellMask ) );
+            auto fetch = [&]( int offset )
+            {
+                return _mm256_i32gather_epi32( pLutInts, _mm256_add_epi32( cell, _mm256_set1_epi32( offset ) ), 4 );
+            };
+            const __m256i fr = _mm256_srli_epi32( cr, 16 );
+            const __m256i c00 = LerpPacked8( fetch( 0 ), fetch( 1 ), fr );
+            const __m256i c10 = LerpPacked8( fetch( size ), fetch( size + 1 ), fr );
+            const __m256i c01 = LerpPacked8( fetch( plane ), fetch( plane + 1 ), fr );
+            const __m256i c11 = LerpPacked8( fetch( plane + size ), fetch( plane + size + 1 ), fr );
+            const __m256i fg = _mm256_srli_epi32( cg, 16 );
+            const __m256i result = LerpPacked8( LerpPacked8( c00, c10, fg ), LerpPacked8( c01, c11, fg ), _mm256_srli_epi32( cb, 16 ) );
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>(pDst + x), result );
+        }
+#endif
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+        // No gathers: the eight corners of four pixels are loaded one by
+        // one into columns, then all seven lerps run four pixels wide
+        for( ; x + 4 <= count; x += 4 )
+        {
+            const std::uint32_t* pCells[4];
+            std::uint32_t fraction[3][4];
+            for( int i = 0; i < 4; ++i )
+            {
+                const std::uint32_t p = pSrc[x + i];
+                const std::uint32_t cr = pCoord[p & 0xFFu];
+                const std::uint32_t cg = pCoord[p >> 8 & 0xFFu];
+                const std::uint32_t cb = pCoord[p >> 16 & 0xFFu];
+                pCells[i] = pLut + ((cb & 0xFFFFu) * plane + (cg & 0xFFFFu) * size + (cr & 0xFFFFu));
+                fraction[0][i] = cr >> 16;
+                fraction[1][i] = cg >> 16;
+                fraction[2][i] = cb >> 16;
+            }
+            auto column = [&pCells]( int offset )
+            {
+                return _mm_setr_epi32( int( pCells[0][offset] ), int( pCells[1][offset] ), int( pCells[2][offset] ), int( pCells[3][offset] ) );
+            };
+            auto weights = []( const std::uint32_t* f )
+            {
+                return _mm_setr_epi32( int( f[0] ), int( f[1] ), int( f[2] ), int( f[3] ) );
+            };
+            const __m128i fr = weights( fraction[0] );
+            const __m128i c00 = LerpPacked4( column( 0 ), column( 1 ), fr );
+            const __m128i c10 = LerpPacked4( column( size ), column( size + 1 ), fr );
+            const __m128i c01 = LerpPacked4( column( plane ), column( plane + 1 ), fr );
+            const __m128i c11 = LerpPacked4( column( plane + size ), column( plane + size + 1 ), fr );
+            const __m128i fg = weights( fraction[1] );
+            const __m128i result = LerpPacked4( LerpPacked4( c00, c10, fg ), LerpPacked4( c01, c11, fg ), weights( fraction[2] ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst + x), result );
+        }
+#endif
+        for( ; x < count; ++x )
+        {
+            pDst[x] = GradePixel( pSrc[x], pLut, pCoord, size );
+        }
+    }
+
+    // A grade whose every output channel depends only on the same input
+    // channel, through per-channel curves already shifted into place
+    void GradeRowSeparable( std::uint32_t* pDst, const std::uint32_t* pSrc, int count, const std::uint32_t* pCurves )
+    {
+        for( int x = 0; x < count; ++x )
+        {
+            const std::uint32_t p = pSrc[x];
+            pDst[x] = pCurves[p & 0xFFu] | pCurves[256 + (p >> 8 & 0xFFu)] | pCurves[512 + (p >> 16 & 0xFFu)] | 0xFF000000u;
+        }
+    }
+
+    // dst = src + min( bloom * intensity / 64, 255 ), saturating per channel
+    void AddBloomRow( std::uint32_t* pDst, const std::uint32_t* pSrc, const std::uint32_t* pBloom, int count, int intensity )
+    {
+        int x = 0;
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i scale = _mm_set1_epi16( static_cast<short>(intensity) );
+        for( ; x + 4 <= count; x += 4 )
+        {
+            const __m128i bloom = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pBloom + x) );
+            const __m128i lo = _mm_srli_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( bloom, zero ), scale ), 6 );
+            const __m128i hi = _mm_srli_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( bloom, zero ), scale ), 6 );
+            const __m128i src = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pSrc + x) );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>(pDst + x), _mm_adds_epu8( src, _mm_packus_epi16( lo, hi ) ) );
+        }
+#endif
+        const std::uint8_t* pSrcBytes = reinterpret_cast<const std::uint8_t*>(pSrc);
+        const std::uint8_t* pBloomBytes = reinterpret_cast<const std::uint8_t*>(pBloom);
+        std::uint8_t* pDstBytes = reinterpret_cast<std::uint8_t*>(pDst);
+        for( int i = 4 * x; i < 4 * count; ++i )
+        {
+            const unsigned int add = std::min( (pBloomBytes[i] * unsigned( intensity )) >> 6, 255u );
+            pDstBytes[i] = static_cast<std::uint8_t>(std::min( pSrcBytes[i] + add, 255u ));
+        }
+    }
+}
+
+PostProcess::PostProcess( unsigned int threadCount )
+    : threadCount( threadCount != 0u ? threadCount : std::max( 1u, std::thread::hardware_concurrency() ) )
+{
+}
+
+PostProcess::~PostProcess() = default;
+
+void PostProcess::SetBlur( float sigma )
+{
+    blurRadius = MakeKernel( sigma, blurWeights );
+}
+
+void PostProcess::SetBloom( int threshold, float intensity, float sigma )
+{
+    bloomThreshold = std::clamp( threshold, 0, 254 );
+    bloomIntensity = std::clamp( static_cast<int>(intensity * 64.0f + 0.5f), 0, 256 );
+    // The bright pass is half resolution, and so is its kernel
+    bloomRadius = MakeKernel( sigma * 0.5f, bloomWeights );
+}
+
+void PostProcess::SetColorGrade( const std::function<Color( Color )>& grade, int size )
+{
+    size = std::clamp( size, 2, 33 );
+    lut.resize( std::size_t( size ) * size * size );
+    auto level = [size]( int i )
+    {
+        return static_cast<unsigned char>((i * 255 + (size - 1) / 2) / (size - 1));
+    };
+    std::uint32_t* pEntry = lut.data();
+    for( int b = 0; b < size; ++b )
+    {
+        for( int g = 0; g < size; ++g )
+        {
+            for( int r = 0; r < size; ++r )
+            {
+                *pEntry++ = grade( Color( level( r ), level( g ), level( b ) ) ).dword | 0xFF000000u;
+            }
+        }
+    }
+    // Channel value to lattice cell and 8.8 position within it; 255 lands
+    // at the far end of the last cell rather than past it
+    for( int v = 0; v < 256; ++v )
+    {
+        const int pos = v * (size - 1) * 256 / 255;
+        const int cell = std::min( pos >> 8, size - 2 );
+        lutCoord[v] = std::uint32_t( cell ) | std::uint32_t( pos - cell * 256 ) << 16;
+    }
+    lutSize = size;
+    // Separable grades (curves, levels, per-channel gamma) are common. For
+    // them the trilinear lerps across the other two axes mix equal values
+    // and drop out exactly, so three curves give the same bytes as the LUT.
+    separableGrade = true;
+    const int plane = size * size;
+    for( int i = 0; i < size * plane && separableGrade; ++i )
+    {
+        // Each channel must match the entry on its own axis through 0
+        const std::uint32_t red = lut[i % size] & 0x0000FFu;
+        const std::uint32_t green = lut[i / size % size * size] & 0x00FF00u;
+        const std::uint32_t blue = lut[i / plane * plane] & 0xFF0000u;
+        separableGrade = (lut[i] & 0xFFFFFFu) == (red | green | blue);
+    }
+    if( separableGrade )
+    {
+        for( int v = 0; v < 256; ++v )
+        {
+            const std::uint32_t cell = lutCoord[v] & 0xFFFFu;
+            const std::uint32_t f = lutCoord[v] >> 16;
+            gradeCurves[v] = LerpPacked( lut[cell], lut[cell + 1], f ) & 0x0000FFu;
+            gradeCurves[256 + v] = LerpPacked( lut[cell * size], lut[(cell + 1) * size], f ) & 0x00FF00u;
+            gradeCurves[512 + v] = LerpPacked( lut[cell * plane], lut[(cell + 1) * plane], f ) & 0xFF0000u;
+        }
+    }
+}
+
+void PostProcess::ClearColorGrade()
+{
+    lut.clear();
+    separableGrade = false;
+    lutSize = 0;
+}
+
+bool PostProcess::IsActive() const
+{
+    return blurRadius > 0 || bloomIntensity > 0 || lutSize > 0;
+}
+
+Graphics::RawSurface PostProcess::Apply( const Graphics::RawSurface& src )
+{
+    if( !IsActive() )
+    {
+        return src;
+    }
+    if( !pPool )
+    {
+        pPool = std::make_unique<WorkerPool>( threadCount );
+    }
+    const std::size_t size = std::size_t( src.pitch ) * src.height;
+    if( output.size() != size )
+    {
+        output.resize( size );
+        scratch.resize( size );
+    }
+    const std::uint32_t* pCurrent = src.pixels;
+    if( blurRadius > 0 )
+    {
+        Blur( pCurrent, scratch.data(), output.data(), src.width, src.height, src.pitch, blurWeights, blurRadius );
+        pCurrent = output.data();
+    }
+    if( bloomIntensity > 0 )
+    {
+        BrightPass( pCurrent, src.width, src.height, src.pitch );
+        if( bloomRadius > 0 )
+        {
+            Blur( bright.data(), brightScratch.data(), bright.data(), brightWidth, brightHeight, brightWidth, bloomWeights, bloomRadius );
+        }
+        AddBloom( pCurrent, output.data(), src.width, src.height, src.pitch );
+        pCurrent = output.data();
+    }
+    // Bloom grades each row as it adds to it, while the row is in cache
+    if( lutSize > 0 && bloomIntensity == 0 )
+    {
+        Grade( pCurrent, output.data(), src.width, src.height, src.pitch );
+    }
+    return { output.data(), src.pitch, src.width, src.height };
+}
+
+int PostProcess::MakeKernel( float sigma, Kernel& weights )
+{
+    if( !(sigma > 0.0f) )
+    {
+        return 0;
+    }
+    const int radius = std::min( static_cast<int>(std::ceil( sigma * 3.0f )), MaxBlurRadius );
+    std::array<double, 2 * MaxBlurRadius + 1> g = {};
+    double total = 0.0;
+    for( int k = -radius; k <= radius; ++k )
+    {
+        g[k + radius] = std::exp( -double( k * k ) / (2.0 * sigma * sigma) );
+        total += g[k + radius];
+    }
+    // Quantized to sum to exactly 256, the rounding error going to the
+    // center tap, so flat areas come out unchanged
+    int sum = 0;
+    for( int k = 0; k <= 2 * radius; ++k )
+    {
+        weights[k] = static_cast<std::uint16_t>(std::lround( g[k] * 256.0 / total ));
+        sum += weights[k];
+    }
+    weights[radius] = static_cast<std::uint16_t>(weights[radius] + 256 - sum);
+    return radius;
+}
+
+template<typename F>
+void PostProcess::ForEachBand( int height, F&& fn )
+{
+    pPool->ParallelFor( (height + PostBandRows - 1) / PostBandRows, [&]( int band )
+    {
+        const int top = band * PostBandRows;
+        fn( top, std::min( top + PostBandRows, height ) );
+    } );
+}
+
+void PostProcess::Blur( const std::uint32_t* pSrc, std::uint32_t* pTemp, std::uint32_t* pDst,
+    int width, int height, int pitch, const Kernel& weights, int radius )
+{
+    ForEachBand( height, [&]( int top, int bottom )
+    {
+        for( int y = top; y < bottom; ++y )
+        {
+            ConvolveRow( pTemp + y * pitch, pSrc + y * pitch, width, weights.data(), radius );
+        }
+    } );
+    ForEachBand( height, [&]( int top, int bottom )
+    {
+        const int taps = 2 * radius + 1;
+        const std::uint32_t* pTaps[2 * MaxBlurRadius + 1];
+        for( int x0 = 0; x0 < width; x0 += PostStripPixels )
+        {
+            const int x1 = std::min( x0 + PostStripPixels, width );
+            for( int y = top; y < bottom; ++y )
+            {
+                for( int k = 0; k < taps; ++k )
+                {
+                    pTaps[k] = pTemp + std::clamp( y + k - radius, 0, height - 1 ) * pitch;
+                }
+                ConvolveSpan( pDst + y * pitch, pTaps, weights.data(), radius, x0, x1 );
+            }
+        }
+    } );
+}
+
+void PostProcess::BrightPass( const std::uint32_t* pSrc, int width, int height, int pitch )
+{
+    brightWidth = (width + 1) / 2;
+    brightHeight = (height + 1) / 2;
+    const std::size_t size = std::size_t( brightWidth ) * brightHeight;
+    if( bright.size() != size )
+    {
+        bright.resize( size );
+        brightScratch.resize( size );
+    }
+    const int threshold = bloomThreshold;
+    ForEachBand( brightHeight, [&]( int top, int bottom )
+    {
+        for( int y = top; y < bottom; ++y )
+        {
+            const std::uint32_t* pRow0 = pSrc + (2 * y) * pitch;
+            const std::uint32_t* pRow1 = pSrc + std::min( 2 * y + 1, height - 1 ) * pitch;
+            std::uint32_t* pDst = bright.data() + y * brightWidth;
+            for( int x = 0; x < brightWidth; ++x )
+            {
+                // 2x2 box average, two channels per add
+                const int xa = 2 * x;
+                const int xb = std::min( 2 * x + 1, width - 1 );
+                const std::uint32_t even = ((pRow0[xa] & 0x00FF00FFu) + (pRow0[xb] & 0x00FF00FFu) +
+                    (pRow1[xa] & 0x00FF00FFu) + (pRow1[xb] & 0x00FF00FFu) + 0x00020002u) >> 2 & 0x00FF00FFu;
+                const std::uint32_t green = ((pRow0[xa] >> 8 & 0xFFu) + (pRow0[xb] >> 8 & 0xFFu) +
+                    (pRow1[xa] >> 8 & 0xFFu) + (pRow1[xb] >> 8 & 0xFFu) + 2u) >> 2;
+                const int luma = int( 54u * (even & 0xFFu) + 183u * green + 19u * (even >> 16) ) >> 8;
+                // Only the excess over the threshold glows, ramping to full
+                // strength at white; alpha stays 0 so the add leaves it alone
+                const std::uint32_t k = luma > threshold ? std::uint32_t( ((luma - threshold) << 8) / (255 - threshold) ) : 0u;
+                pDst[x] = ((even * k) >> 8 & 0x00FF00FFu) | ((green * k) & 0xFF00u);
+            }
+        }
+    } );
+}
+
+void PostProcess::AddBloom( const std::uint32_t* pSrc, std::uint32_t* pDst, int width, int height, int pitch )
+{
+    // One padded blend row per band; the upsampled row goes to scratch,
+    // which the full resolution blur is done with by now
+    const std::size_t blendSize = std::size_t( brightWidth + 2 ) * 4;
+    bloomRows.resize( blendSize * ((height + PostBandRows - 1) / PostBandRows) );
+    ForEachBand( height, [&]( int top, int bottom )
+    {
+        std::uint16_t* pBlend = bloomRows.data() + blendSize * (top / PostBandRows);
+        for( int y = top; y < bottom; ++y )
+        {
+            const int nearRow = y / 2;
+            const int farRow = std::clamp( (y & 1) != 0 ? nearRow + 1 : nearRow - 1, 0, brightHeight - 1 );
+            BlendBloomRows( pBlend, bright.data() + nearRow * brightWidth, bright.data() + farRow * brightWidth, brightWidth );
+            std::uint32_t* pUp = scratch.data() + y * pitch;
+            UpsampleBloomRow( pUp, pBlend, width );
+            AddBloomRow( pDst + y * pitch, pSrc + y * pitch, pUp, width, bloomIntensity );
+            if( lutSize > 0 )
+            {
+                GradeLine( pDst + y * pitch, pDst + y * pitch, width );
+            }
+        }
+    } );
+}
+
+void PostProcess::Grade( const std::uint32_t* pSrc, std::uint32_t* pDst, int width, int height, int pitch )
+{
+    ForEachBand( height, [&]( int top, int bottom )
+    {
+        for( int y = top; y < bottom; ++y )
+        {
+            GradeLine( pDst + y * pitch, pSrc + y * pitch, width );
+        }
+    } );
+}
+
+void PostProcess::GradeLine( std::uint32_t* pDst, const std::uint32_t* pSrc, int width ) const
+{
+    if( separableGrade )
+    {
+        GradeRowSeparable( pDst, pSrc, width, gradeCurves.data() );
+    }
+    else
+    {
+        GradeRow( pDst, pSrc, width, lut.data(), lutCoord.data(), lutSize );
+    }
+}
+
+// FrameRecorder Implementation
+namespace
+{
+    // CRC-32 as PNG chunks use it (reflected, polynomial 0xEDB88320)
+    struct Crc32Table
+    {
+        Crc32Table()
+        {
+            for( std::uint32_t n = 0; n < 256u; ++n )
+            {
+                std::uint32_t c = n;
+                for( int k = 0; k < 8; ++k )
+                {
+                    c = (c & 1u) != 0u ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[n] = c;
+            }
+        }
+        std::uint32_t entries[256];
+    };
+
+    std::uint32_t Crc32( const std::uint8_t* pData, std::size_t size, std::uint32_t crc = 0u )
+    {
+        static const Crc32Table table;
+        crc = ~crc;
+        for( std::size_t i = 0; i < size; ++i )
+        {
+            crc = table.entries[(crc ^ pData[i]) & 0xFFu] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void PutBigEndian( std::vector<std::uint8_t>& out, std::uint32_t value )
+    {
+        out.push_back( static_cast<std::uint8_t>(value >> 24) );
+        out.push_back( static_cast<std::uint8_t>(value >> 16) );
+        out.push_back( static_cast<std::uint8_t>(value >> 8) );
+        out.push_back( static_cast<std::uint8_t>(value) );
+    }
+}
+
+FrameRecorder::FrameRecorder( const std::string& path, Format format, int width, int height, int bufferCount )
+    : path( path ),
+      format( format ),
+      width( width ),
+      height( height )
+{
+    if( format == Format::RawVideo )
+    {
+        rawOut.open( path, std::ios::binary );
+        if( !rawOut )
+        {
+            throw std::runtime_error( "FrameRecorder: cannot create " + path );
+        }
+    }
+    else
+    {
+        // Split by path components, so dots in directory names stay put
+        const std::filesystem::path file( path );
+        framePrefix = (file.parent_path() / file.stem()).string();
+        frameSuffix = file.extension().string();
+    }
+    bufferCount = std::max( bufferCount, 1 );
+    buffers.resize( bufferCount );
+    for( auto& buffer : buffers )
+    {
+        buffer.resize( std::size_t( width ) * height );
+    }
+    bufferFrames.resize( bufferCount );
+    queuedSlots.resize( bufferCount );
+    freeSlots.reserve( bufferCount );
+    for( int i = bufferCount - 1; i >= 0; --i )
+    {
+        freeSlots.push_back( i );
+    }
+    encoder = std::thread( [this] { EncoderMain(); } );
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    {
+        std::lock_guard<std::mutex> lock( mtx );
+        stopping = true;
+    }
+    queued.notify_all();
+    encoder.join();
+}
+
+FrameRecorder::Format FrameRecorder::FormatFor( const std::string& path )
+{
+    if( std::filesystem::path( path ).extension() == ".png" )
+    {
+        return Format::PngSequence;
+    }
+    return Format::RawVideo;
+}
+
+bool FrameRecorder::Capture( const std::uint32_t* pPixels, int pitch )
+{
+    int slot;
+    std::uint64_t frame;
+    {
+        std::lock_guard<std::mutex> lock( mtx );
+        frame = capturedFrames.load( std::memory_order_relaxed ) + droppedFrames.load( std::memory_order_relaxed );
+        if( freeSlots.empty() )
+        {
+            droppedFrames.fetch_add( 1u, std::memory_order_relaxed );
+            return false;
+        }
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    // The copy happens outside the lock, so the encoder never waits on it
+    std::uint32_t* pDst = buffers[slot].data();
+    for( int y = 0; y < height; ++y, pPixels += pitch, pDst += width )
+    {
+        std::memcpy( pDst, pPixels, sizeof( std::uint32_t ) * width );
+    }
+    bufferFrames[slot] = frame;
+    {
+        std::lock_guard<std::mutex> lock( mtx );
+        queuedSlots[(queueHead + queueCount) % queuedSlots.size()] = slot;
+        ++queueCount;
+        capturedFrames.fetch_add( 1u, std::memory_order_relaxed );
+    }
+    queued.notify_one();
+    return true;
+}
+
+void FrameRecorder::Flush()
+{
+    std::unique_lock<std::mutex> lock( mtx );
+    drained.wait( lock, [this] { return freeSlots.size() == buffers.size(); } );
+}
+
+int FrameRecorder::GetWidth() const
+{
+    return width;
+}
+
+int FrameRecorder::GetHeight() const
+{
+    return height;
+}
+
+std::uint64_t FrameRecorder::GetCapturedFrames() const
+{
+    return capturedFrames.load( std::memory_order_relaxed );
+}
+
+std::uint64_t FrameRecorder::GetDroppedFrames() const
+{
+    return droppedFrames.load( std::memory_order_relaxed );
+}
+
+std::uint64_t FrameRecorder::GetEncodedFrames() const
+{
+    return encodedFrames.load( std::memory_order_relaxed );
+}
+
+bool FrameRecorder::HasFailed() const
+{
+    return failed.load( std::memory_order_relaxed );
+}
+
+void FrameRecorder::EncoderMain()
+{
+    std::unique_lock<std::mutex> lock( mtx );
+    while( true )
+    {
+        queued.wait( lock, [this] { return queueCount > 0 || stopping; } );
+        if( queueCount == 0 )
+        {
+            break;
+        }
+        const int slot = queuedSlots[queueHead];
+        queueHead = (queueHead + 1) % static_cast<int>(queuedSlots.size());
+        --queueCount;
+        lock.unlock();
+
+        Encode( buffers[slot].data(), bufferFrames[slot] );
+        encodedFrames.fetch_add( 1u, std::memory_order_relaxed );
+
+        lock.lock();
+        freeSlots.push_back( slot );
+        if( freeSlots.size() == buffers.size() )
+        {
+            drained.notify_all();
+        }
+    }
+}
+
+void FrameRecorder::Encode( const std::uint32_t* pPixels, std::uint64_t frame )
+{
+    if( failed.load( std::memory_order_relaxed ) )
+    {
+        return;
+    }
+    bool ok;
+    if( format == Format::RawVideo )
+    {
+        rawOut.write( reinterpret_cast<const char*>(pPixels), std::streamsize( sizeof( std::uint32_t ) ) * width * height );
+        ok = static_cast<bool>(rawOut);
+    }
+    else
+    {
+        char number[32];
+        std::snprintf( number, sizeof( number ), "_%06llu", static_cast<unsigned long long>(frame) );
+        ok = WritePng( framePrefix + number + frameSuffix, pPixels );
+    }
+    if( !ok )
+    {
+        failed.store( true, std::memory_order_relaxed );
+    }
+}
+
+bool FrameRecorder::WritePng( const std::string& filePath, const std::uint32_t* pPixels )
+{
+    // 8-bit RGBA, every row unfiltered, in a zlib stream of stored deflate
+    // blocks. Pixels are RGBA in memory order, which is PNG's byte order.
+    const std::size_t rowBytes = 1u + std::size_t( width ) * 4u;
+    const std::size_t rawBytes = rowBytes * height;
+    constexpr std::size_t MaxBlock = 65535u;
+    const std::size_t blocks = std::max<std::size_t>( (rawBytes + MaxBlock - 1) / MaxBlock, 1u );
+    const std::size_t idatBytes = 2u + rawBytes + 5u * blocks + 4u;
+
+    pngBytes.clear();
+    static const std::uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    pngBytes.insert( pngBytes.end(), std::begin( signature ), std::end( signature ) );
+    auto beginChunk = [this]( std::size_t size, const char* pType )
+    {
+        PutBigEndian( pngBytes, static_cast<std::uint32_t>(size) );
+        pngBytes.insert( pngBytes.end(), pType, pType + 4 );
+        return pngBytes.size() - 4u;
+    };
+    auto endChunk = [this]( std::size_t typeOffset )
+    {
+        PutBigEndian( pngBytes, Crc32( pngBytes.data() + typeOffset, pngBytes.size() - typeOffset ) );
+    };
+
+    std::size_t chunk = beginChunk( 13u, "IHDR" );
+    PutBigEndian( pngBytes, static_cast<std::uint32_t>(width) );
+    PutBigEndian( pngBytes, static_cast<std::uint32_t>(height) );
+    // Bit depth 8, color type 6 (RGBA), default compression, filter and
+    // no interlace
+    static const std::uint8_t header[] = { 8, 6, 0, 0, 0 };
+    pngBytes.insert( pngBytes.end(), std::begin( header ), std::end( header ) );
+    endChunk( chunk );
+
+    chunk = beginChunk( idatBytes, "IDAT" );
+    pngBytes.push_back( 0x78 );
+    pngBytes.push_back( 0x01 );
+    // Adler-32 over the uncompressed bytes; a and b stay far from
+    // overflowing when reduced once per row
+    std::uint32_t adlerA = 1u;
+    std::uint32_t adlerB = 0u;
+    std::size_t blockLeft = 0u;
+    std::size_t rawLeft = rawBytes;
+    auto emit = [&]( const std::uint8_t* pData, std::size_t size )
+    {
+        while( size > 0u )
+        {
+            if( blockLeft == 0u )
+            {
+                blockLeft = std::min( rawLeft, MaxBlock );
+                rawLeft -= blockLeft;
+                pngBytes.push_back( rawLeft == 0u ? 1u : 0u );
+                pngBytes.push_back( static_cast<std::uint8_t>(blockLeft) );
+                pngBytes.push_back( static_cast<std::uint8_t>(blockLeft >> 8) );
+                pngBytes.push_back( static_cast<std::uint8_t>(~blockLeft) );
+                pngBytes.push_back( static_cast<std::uint8_t>(~blockLeft >> 8) );
+            }
+            const std::size_t n = std::min( size, blockLeft );
+            pngBytes.insert( pngBytes.end(), pData, pData + n );
+            for( std::size_t i = 0; i < n; ++i )
+            {
+                adlerA += pData[i];
+                adlerB += adlerA;
+                if( adlerB >= 0x80000000u )
+                {
+                    adlerA %= 65521u;
+                    adlerB %= 65521u;
+                }
+            }
+            pData += n;
+            size -= n;
+            blockLeft -= n;
+        }
+    };
+    const std::uint8_t filterNone = 0u;
+    for( int y = 0; y < height; ++y )
+    {
+        emit( &filterNone, 1u );
+        emit( reinterpret_cast<const std::uint8_t*>(pPixels + std::size_t( y ) * width), std::size_t( width ) * 4u );
+    }
+    PutBigEndian( pngBytes, (adlerB % 65521u) << 16 | (adlerA % 65521u) );
+    endChunk( chunk );
+
+    chunk = beginChunk( 0u, "IEND" );
+    endChunk( chunk );
+
+    std::ofstream out( filePath, std::ios::binary );
+    out.write( reinterpret_cast<const char*>(pngBytes.data()), std::streamsize( pngBytes.size() ) );
+    return static_cast<bool>(out);
+}
+
+// FrameProfiler Implementation
+FrameProfiler::ScopedTimer::ScopedTimer( FrameProfiler& profiler, Phase phase )
+    : profiler( profiler ),
+      phase( phase ),
+      start( std::chrono::steady_clock::now() )
+{
+}
+
+FrameProfiler::ScopedTimer::~ScopedTimer()
+{
+    const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    profiler.current.phaseMs[static_cast<int>(phase)] += elapsed.count();
+}
+
+void FrameProfiler::NextFrame()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if( frameStart != std::chrono::steady_clock::time_point() )
+    {
+        current.totalMs = std::chrono::duration<float, std::milli>( now - frameStart ).count();
+        const std::uint64_t frame = framesRecorded.load( std::memory_order_relaxed );
+        WriteSample( history[frame % HistoryFrames], current );
+        framesRecorded.store( frame + 1u, std::memory_order_release );
+    }
+    frameStart = now;
+    current = {};
+}
+
+void FrameProfiler::WriteSample( HistorySlot& slot, const FrameSample& fs )
+{
+    const std::uint32_t sequence = slot.sequence.load( std::memory_order_relaxed );
+    slot.sequence.store( sequence + 1u, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+    for( int p = 0; p < PhaseCount; ++p )
+    {
+        slot.ms[p].store( fs.phaseMs[p], std::memory_order_relaxed );
+    }
+    slot.ms[PhaseCount].store( fs.totalMs, std::memory_order_relaxed );
+    slot.sequence.store( sequence + 2u, std::memory_order_release );
+}
+
+FrameProfiler::FrameSample FrameProfiler::ReadSample( const HistorySlot& slot ) const
+{
+    FrameSample fs;
+    for( ;; )
+    {
+        const std::uint32_t before = slot.sequence.load( std::memory_order_acquire );
+        for( int p = 0; p < PhaseCount; ++p )
+        {
+            fs.phaseMs[p] = slot.ms[p].load( std::memory_order_relaxed );
+        }
+        fs.totalMs = slot.ms[PhaseCount].load( std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_acquire );
+        // An odd or changed sequence means the game thread wrote meanwhile
+        if( (before & 1u) == 0u && slot.sequence.load( std::memory_order_relaxed ) == before )
+        {
+            return fs;
+        }
+        std::this_thread::yield();
+    }
+}
+
+FrameProfiler::Stats FrameProfiler::GetStats( int phaseIndex ) const
+{
+    const std::uint64_t frames = framesRecorded.load( std::memory_order_acquire );
+    const int count = static_cast<int>(std::min<std::uint64_t>( frames, HistoryFrames ));
+    if( count == 0 )
+    {
+        return { 0.0f, 0.0f, 0.0f };
+    }
+    std::array<float, HistoryFrames> samples;
+    float sum = 0.0f;
+    for( int i = 0; i < count; ++i )
+    {
+        const FrameSample fs = ReadSample( history[i] );
+        samples[i] = phaseIndex < PhaseCount ? fs.phaseMs[phaseIndex] : fs.totalMs;
+        sum += samples[i];
+    }
+    const float minMs = *std::min_element( samples.begin(), samples.begin() + count );
+    const int p99Index = std::max( 0, (count * 99 + 99) / 100 - 1 );
+    std::nth_element( samples.begin(), samples.begin() + p99Index, samples.begin() + count );
+    return { minMs, sum / count, samples[p99Index] };
+}
+
+std::uint64_t FrameProfiler::GetFrameCount() const
+{
+    return framesRecorded.load( std::memory_order_acquire );
+}
+
+void FrameProfiler::DrawOverlay( Graphics& gfx ) const
+{
+    constexpr float PixelsPerMs = 16.0f;
+    constexpr float BudgetMs = 1000.0f / 60.0f;
+    constexpr int Left = 8;
+    constexpr int Top = 8;
+    constexpr int RowHeight = 6;
+    constexpr int RowStride = BitmapFont::GlyphSize + 4;
+    constexpr int LabelWidth = 8 * BitmapFont::GlyphSize;
+    constexpr int BarsLeft = Left + LabelWidth;
+    constexpr int BarsWidth = static_cast<int>(2.0f * BudgetMs * PixelsPerMs);
+    constexpr int NumbersWidth = 12 * BitmapFont::GlyphSize;
+    constexpr int Width = LabelWidth + BarsWidth + 8 + NumbersWidth;
+    static constexpr Color RowColors[PhaseCount + 1] = {
+        Colors::Cyan, Colors::Green, Colors::Yellow, Colors::Magenta, Colors::LightGray };
+    static constexpr const char* RowLabels[PhaseCount + 1] = {
+        "Begin", "Update", "Compose", "End", "Frame" };
+
+    const auto toX = [&]( float ms )
+    {
+        return BarsLeft + std::min( BarsWidth, static_cast<int>(ms * PixelsPerMs) );
+    };
+    gfx.DrawRect( Left - 4, Top - 4, Width + 8, (PhaseCount + 1) * RowStride + 4, Color( 24u, 24u, 24u ) );
+    gfx.DrawLine( toX( BudgetMs ), Top - 4, toX( BudgetMs ), Top + (PhaseCount + 1) * RowStride - 1, Colors::Gray );
+    for( int row = 0; row <= PhaseCount; ++row )
+    {
+        const Stats st = GetStats( row );
+        const int textY = Top + row * RowStride;
+        const int y = textY + (BitmapFont::GlyphSize - RowHeight) / 2;
+        const int minX = toX( st.minMs );
+        const int avgX = toX( st.avgMs );
+        const int p99X = toX( st.p99Ms );
+        gfx.DrawText( Left, textY, RowLabels[row], RowColors[row] );
+        gfx.DrawRect( minX, y, std::max( avgX - minX, 1 ), RowHeight, RowColors[row] );
+        gfx.DrawLine( avgX, y - 1, avgX, y + RowHeight, Colors::White );
+        gfx.DrawLine( p99X, y - 1, p99X, y + RowHeight, Colors::Red );
+        // avg / p99 in ms, formatted on the stack
+        char numbers[32];
+        std::snprintf( numbers, sizeof( numbers ), "%5.2f %5.2f", st.avgMs, st.p99Ms );
+        gfx.DrawText( BarsLeft + BarsWidth + 8, textY, numbers, Colors::White );
+    }
+}
+
+void FrameProfiler::ToggleOverlay()
+{
+    overlayVisible = !overlayVisible;
+}
+
+bool FrameProfiler::IsOverlayVisible() const
+{
+    return overlayVisible;
+}
+
+bool FrameProfiler::WriteCsv( const std::string& path ) const
+{
+    std::ofstream out( path );
+    if( !out )
+    {
+        return false;
+    }
+    out << "frame,begin_frame_ms,update_model_ms,compose_frame_ms,end_frame_ms,total_ms\n";
+    const std::uint64_t frames = framesRecorded.load( std::memory_order_acquire );
+    const std::uint64_t first = frames > HistoryFrames ? frames - HistoryFrames : 0u;
+    for( std::uint64_t frame = first; frame < frames; ++frame )
+    {
+        const FrameSample fs = ReadSample( history[frame % HistoryFrames] );
+        out << frame;
+        for( const float ms : fs.phaseMs )
+        {
+            out << ',' << ms;
+        }
+        out << ',' << fs.totalMs << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+// Game Implementation
+Game::Game( MainWindow& wnd )
+    : wnd( wnd ),
+      gfx( wnd ),
+      tickDuration( sf::microseconds( 1000000 / 60 ) )
+{
+    // CHILI_PROFILE_CSV=path turns the dump on for any build of the game
+    if( const char* pPath = std::getenv( "CHILI_PROFILE_CSV" ) )
+    {
+        profileCsvPath = pPath;
+    }
+}
+
+Game::~Game()
+{
+    StopRecording();
+    if( !profileCsvPath.empty() )
+    {
+        profiler.WriteCsv( profileCsvPath );
+    }
+}
+
+void Game::Go()
+{
+    {
+        FrameProfiler::ScopedTimer timer( profiler, FrameProfiler::Phase::BeginFrame );
+        gfx.BeginFrame();
+    }
+    {
+        FrameProfiler::ScopedTimer timer( profiler, FrameProfiler::Phase::UpdateModel );
+        // Headless runs advance exactly one tick per frame so that scripted
+        // runs are reproducible no matter how fast the machine is
+        accumulator += wnd.IsHeadless() ? tickDuration : frameClock.restart();
+        int steps = 0;
+        while( accumulator >= tickDuration && steps < maxCatchUpSteps )
+        {
+            // One snapshot per tick: presses reach exactly one tick, and
+            // frames that run no tick leave them queued for the next one
+            wnd.input.NextFrame();
+            UpdateModel( tickDuration.asSeconds() );
+            jobs.RunMainThreadJobs();
+            accumulator -= tickDuration;
+            ++steps;
+        }
+        if( accumulator >= tickDuration )
+        {
+            // Too far behind to catch up; let game time slip rather than spiral
+            accumulator %= tickDuration;
+        }
+    }
+    {
+        FrameProfiler::ScopedTimer timer( profiler, FrameProfiler::Phase::ComposeFrame );
+        ComposeFrame( accumulator / tickDuration );
+    }
+    if( profiler.IsOverlayVisible() )
+    {
+        profiler.DrawOverlay( gfx );
+    }
+    {
+        FrameProfiler::ScopedTimer timer( profiler, FrameProfiler::Phase::EndFrame );
+        gfx.EndFrame();
+    }
+    profiler.NextFrame();
+}
+
+void Game::SetTickRate( float ticksPerSecond )
+{
+    tickDuration = sf::microseconds( std::max( std::int64_t( 1 ), static_cast<std::int64_t>(1000000.0f / ticksPerSecond) ) );
+}
+
+void Game::SetMaxCatchUpSteps( int maxSteps )
+{
+    maxCatchUpSteps = std::max( maxSteps, 1 );
+}
+
+void Game::SetPipelining( int framesInFlight )
+{
+    gfx.SetPipelining( framesInFlight );
+}
+
+void Game::ToggleProfilerOverlay()
+{
+    profiler.ToggleOverlay();
+}
+
+void Game::SetProfileCsv( const std::string& path )
+{
+    profileCsvPath = path;
+}
+
+void Game::StartRecording( const std::string& path )
+{
+    StopRecording();
+    pRecorder = std::make_unique<FrameRecorder>( path, FrameRecorder::FormatFor( path ), gfx.GetWidth(), gfx.GetHeight() );
+    gfx.SetFrameRecorder( pRecorder.get() );
+}
+
+bool Game::StopRecording()
+{
+    if( !pRecorder )
+    {
+        return true;
+    }
+    gfx.SetFrameRecorder( nullptr );
+    pRecorder->Flush();
+    const bool ok = !pRecorder->HasFailed();
+    pRecorder.reset();
+    return ok;
+}
+
+const FrameRecorder* Game::GetRecorder() const
 {
-    gfx.BeginFrame();
-    UpdateModel();
-    ComposeFrame();
-    gfx.EndFrame();
+    return pRecorder.get();
 }
 
-void Game::UpdateModel()
+void Game::UpdateModel( float dt )
 {
 }
 
-void Game::ComposeFrame()
+void Game::ComposeFrame( float alpha )
 {
-    gfx.PutPixel( 395, 300, 255, 255, 255 );
-    gfx.PutPixel( 396, 300, 255, 255, 255 );
-    gfx.PutPixel( 397, 300, 255, 255, 255 );
-    gfx.PutPixel( 403, 300, 255, 255, 255 );
-    gfx.PutPixel( 404, 300, 255, 255, 255 );
-    gfx.PutPixel( 405, 300, 255, 255, 255 );
-    gfx.PutPixel( 400, 295, 255, 255, 255 );
-    gfx.PutPixel( 400, 296, 255, 255, 255 );
-    gfx.PutPixel( 400, 297, 255, 255, 255 );
-    gfx.PutPixel( 400, 303, 255, 255, 255 );
-    gfx.PutPixel( 400, 304, 255, 255, 255 );
-    gfx.PutPixel( 400, 305, 255, 255, 255 );
-    
+    // Crosshair with a gap in the middle
+    gfx.DrawHLine( 395, 397, 300, Colors::White );
+    gfx.DrawHLine( 403, 405, 300, Colors::White );
+    gfx.DrawLine( 400, 295, 400, 297, Colors::White );
+    gfx.DrawLine( 400, 303, 400, 305, Colors::White );
 }
@@ -1,27 +1,157 @@
 #include "Mainwindow.h"
 #include "Game.h"
 #include "Graphics.h"
+#include "FramePacer.h"
+#include "FrameRecorder.h"
 #include <SFML/Window/Event.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
 
-int main()
+// Usage: ChiliGame [--headless <frames>] [--save-frame <file.ppm>] [--pipeline <frames>] [--fps <hz>]
+//                  [--record <file.rgba|name.png>] [--profile-csv <file.csv>]
+// --headless runs without a window for the given number of frames, and
+// --save-frame then writes the final frame out for golden-image checks.
+// --pipeline presents on a render thread with up to that many frames in
+// flight (1 = double buffered, 2 = triple buffered).
+// --fps paces the window loop to that rate (default 60, 0 = unpaced);
+// headless runs are never paced.
+// --record captures every presented frame in the background, as raw RGBA
+// video or, for a .png name, a numbered PNG sequence.
+// --profile-csv writes per-phase frame timings of the last 1024 frames on
+// exit (as does setting CHILI_PROFILE_CSV).
+int main( int argc, char* argv[] )
 {
-    MainWindow wnd( 800, 600, "Chili Framework" );
-    Game game( wnd );
-    
-    while( wnd.IsOpen() )
+    long long headlessFrames = -1;
+    const char* pSaveFramePath = nullptr;
+    int pipelineFrames = 0;
+    double targetFps = 60.0;
+    const char* pRecordPath = nullptr;
+    const char* pProfileCsvPath = nullptr;
+    for( int i = 1; i < argc; ++i )
     {
-        // Handle events
-        std::optional<sf::Event> event = wnd.GetWindow().pollEvent();
-        while( event )
+        if( std::strcmp( argv[i], "--headless" ) == 0 && i + 1 < argc )
+        {
+            headlessFrames = std::atoll( argv[++i] );
+        }
+        else if( std::strcmp( argv[i], "--save-frame" ) == 0 && i + 1 < argc )
+        {
+            pSaveFramePath = argv[++i];
+        }
+        else if( std::strcmp( argv[i], "--pipeline" ) == 0 && i + 1 < argc )
+        {
+            pipelineFrames = std::atoi( argv[++i] );
+        }
+        else if( std::strcmp( argv[i], "--fps" ) == 0 && i + 1 < argc )
+        {
+            targetFps = std::atof( argv[++i] );
+        }
+        else if( std::strcmp( argv[i], "--record" ) == 0 && i + 1 < argc )
+        {
+            pRecordPath = argv[++i];
+        }
+        else if( std::strcmp( argv[i], "--profile-csv" ) == 0 && i + 1 < argc )
         {
-            if( event->is<sf::Event::Closed>() )
+            pProfileCsvPath = argv[++i];
+        }
+    }
+
+    const bool headless = headlessFrames >= 0;
+    MainWindow wnd( 800, 600, "Chili Framework",
+        headless ? MainWindow::Backend::Headless : MainWindow::Backend::Window );
+    if( headless )
+    {
+        wnd.ScriptEvent( static_cast<std::uint64_t>(headlessFrames), sf::Event::Closed{} );
+    }
+
+    const bool paced = !headless && targetFps > 0.0;
+    FramePacer pacer( paced ? targetFps : 60.0 );
+
+    {
+        Game game( wnd );
+        game.SetPipelining( pipelineFrames );
+        if( pProfileCsvPath != nullptr )
+        {
+            game.SetProfileCsv( pProfileCsvPath );
+        }
+        if( pRecordPath != nullptr )
+        {
+            try
+            {
+                game.StartRecording( pRecordPath );
+            }
+            catch( const std::runtime_error& e )
             {
-                wnd.Close();
+                std::cerr << e.what() << std::endl;
+                return 1;
             }
-            event = wnd.GetWindow().pollEvent();
         }
         
-        game.Go();
+        while( wnd.IsOpen() )
+        {
+            // Handle events
+            std::optional<sf::Event> event = wnd.PollEvent();
+            while( event )
+            {
+                if( event->is<sf::Event::Closed>() )
+                {
+                    wnd.Close();
+                }
+                else if( event->is<sf::Event::FocusLost>() )
+                {
+                    pacer.SetFocused( false );
+                }
+                else if( event->is<sf::Event::FocusGained>() )
+                {
+                    pacer.SetFocused( true );
+                }
+                else if( const auto* key = event->getIf<sf::Event::KeyPressed>() )
+                {
+                    if( key->code == sf::Keyboard::Key::F3 )
+                    {
+                        game.ToggleProfilerOverlay();
+                    }
+                }
+                event = wnd.PollEvent();
+            }
+            
+            if( wnd.IsOpen() )
+            {
+                game.Go();
+                if( paced )
+                {
+                    pacer.Wait();
+                }
+            }
+        }
+
+        if( const FrameRecorder* pRecorder = game.GetRecorder() )
+        {
+            const std::uint64_t captured = pRecorder->GetCapturedFrames();
+            const std::uint64_t dropped = pRecorder->GetDroppedFrames();
+            if( !game.StopRecording() )
+            {
+                std::cerr << "Could not write all of " << pRecordPath << std::endl;
+            }
+            std::cerr << "Recorded " << captured << " frames to " << pRecordPath
+                << " (" << dropped << " dropped)" << std::endl;
+        }
+    }
+
+    if( paced && pacer.GetMissedDeadlines() > 0u )
+    {
+        std::cerr << "Missed " << pacer.GetMissedDeadlines() << " of " << pacer.GetFrameCount()
+            << " frame deadlines (worst " << std::chrono::duration<double, std::milli>( pacer.GetWorstLateness() ).count()
+            << " ms late)" << std::endl;
+    }
+
+    // Game is gone, so its render thread has presented every frame
+    if( pSaveFramePath != nullptr && !wnd.SaveFrame( pSaveFramePath ) )
+    {
+        std::cerr << "Could not write " << pSaveFramePath << std::endl;
+        return 1;
     }
     
     return 0;
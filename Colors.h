@@ -0,0 +1,88 @@
+#ifndef COLORS_H
+#define COLORS_H
+
+#include <cstdint>
+
+// Packed 32-bit color laid out as RGBA bytes in memory, which is what the
+// Graphics back buffer and sf::Texture::update both expect.
+class Color
+{
+public:
+    std::uint32_t dword;
+
+public:
+    constexpr Color()
+        : dword( 0xFF000000u )
+    {
+    }
+    constexpr explicit Color( std::uint32_t dw )
+        : dword( dw )
+    {
+    }
+    constexpr Color( unsigned char r, unsigned char g, unsigned char b, unsigned char a = 255u )
+        : dword( std::uint32_t( r ) | std::uint32_t( g ) << 8 | std::uint32_t( b ) << 16 | std::uint32_t( a ) << 24 )
+    {
+    }
+    constexpr unsigned char GetR() const
+    {
+        return static_cast<unsigned char>(dword & 0xFFu);
+    }
+    constexpr unsigned char GetG() const
+    {
+        return static_cast<unsigned char>((dword >> 8) & 0xFFu);
+    }
+    constexpr unsigned char GetB() const
+    {
+        return static_cast<unsigned char>((dword >> 16) & 0xFFu);
+    }
+    constexpr unsigned char GetA() const
+    {
+        return static_cast<unsigned char>(dword >> 24);
+    }
+    void SetR( unsigned char r )
+    {
+        dword = (dword & 0xFFFFFF00u) | std::uint32_t( r );
+    }
+    void SetG( unsigned char g )
+    {
+        dword = (dword & 0xFFFF00FFu) | std::uint32_t( g ) << 8;
+    }
+    void SetB( unsigned char b )
+    {
+        dword = (dword & 0xFF00FFFFu) | std::uint32_t( b ) << 16;
+    }
+    void SetA( unsigned char a )
+    {
+        dword = (dword & 0x00FFFFFFu) | std::uint32_t( a ) << 24;
+    }
+    constexpr bool operator==( const Color& rhs ) const
+    {
+        return dword == rhs.dword;
+    }
+    constexpr bool operator!=( const Color& rhs ) const
+    {
+        return dword != rhs.dword;
+    }
+};
+
+static_assert( sizeof( Color ) == sizeof( std::uint32_t ), "Color must stay a packed dword" );
+
+namespace Colors
+{
+    constexpr Color MakeRGB( unsigned char r, unsigned char g, unsigned char b )
+    {
+        return Color( r, g, b );
+    }
+    constexpr Color White = MakeRGB( 255u, 255u, 255u );
+    constexpr Color Black = MakeRGB( 0u, 0u, 0u );
+    constexpr Color Gray = MakeRGB( 0x80u, 0x80u, 0x80u );
+    constexpr Color LightGray = MakeRGB( 0xD3u, 0xD3u, 0xD3u );
+    constexpr Color Red = MakeRGB( 255u, 0u, 0u );
+    constexpr Color Green = MakeRGB( 0u, 255u, 0u );
+    constexpr Color Blue = MakeRGB( 0u, 0u, 255u );
+    constexpr Color Yellow = MakeRGB( 255u, 255u, 0u );
+    constexpr Color Cyan = MakeRGB( 0u, 255u, 255u );
+    constexpr Color Magenta = MakeRGB( 255u, 0u, 255u );
+}
+
+#endif
@@ -0,0 +1,504 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Archetype-based entity-component store. Entities with the same set of
+// component types share an archetype, which keeps them packed in 16 KiB
+// chunks: inside a chunk every component type has its own array starting
+// on a cache line, so a system walking a few components reads dense,
+// aligned memory and nothing else. Adding or removing a component moves
+// the entity to the archetype for its new set.
+//
+// Components are plain data (trivially copyable), which lets chunks move
+// them with memcpy; there can be up to 64 component types, and a type may
+// be used for the first time from any thread. Entities are
+// handles with a generation, so a handle to a destroyed entity stays
+// detectably dead after its slot is reused. Creating, destroying or
+// changing the components of entities while a View is iterating is not
+// allowed; collect the handles and do it afterwards.
+namespace Ecs
+{
+    struct Entity
+    {
+        static constexpr std::uint32_t NullIndex = 0xFFFFFFFFu;
+
+        bool IsNull() const
+        {
+            return index == NullIndex;
+        }
+        bool operator==( const Entity& rhs ) const
+        {
+            return index == rhs.index && generation == rhs.generation;
+        }
+        bool operator!=( const Entity& rhs ) const
+        {
+            return !(*this == rhs);
+        }
+
+        std::uint32_t index = NullIndex;
+        std::uint32_t generation = 0u;
+    };
+
+    using ComponentMask = std::uint64_t;
+    constexpr int MaxComponentTypes = 64;
+    constexpr std::size_t ChunkBytes = 16384u;
+    constexpr std::size_t CacheLine = 64u;
+
+    namespace Detail
+    {
+        // Component types registered so far, process-wide. Types register
+        // on first use from whatever thread that is (systems run as jobs),
+        // so ids come from an atomic counter and sizes sit in a fixed array
+        // that never moves. Each entry is written once, before the type's
+        // id is published by ComponentType's static, and anyone reading an
+        // entry got the id through that static or from an archetype built
+        // by someone who did, so the read is ordered after the write.
+        struct ComponentRegistry
+        {
+            std::atomic<int> count { 0 };
+            std::size_t sizes[MaxComponentTypes] = {};
+        };
+
+        inline ComponentRegistry& Registry()
+        {
+            static ComponentRegistry registry;
+            return registry;
+        }
+
+        // Sizes of the registered component types, by id
+        inline const std::size_t* ComponentSizes()
+        {
+            return Registry().sizes;
+        }
+
+        inline int RegisterComponent( std::size_t size )
+        {
+            ComponentRegistry& registry = Registry();
+            const int id = registry.count.fetch_add( 1 );
+            if( id >= MaxComponentTypes )
+            {
+                throw std::length_error( "Ecs: more than 64 component types" );
+            }
+            registry.sizes[id] = size;
+            return id;
+        }
+
+        template<typename T>
+        struct ComponentType
+        {
+            static int Id()
+            {
+                static const int id = RegisterComponent( sizeof( T ) );
+                return id;
+            }
+        };
+
+        inline std::size_t AlignUp( std::size_t n )
+        {
+            return (n + CacheLine - 1u) & ~(CacheLine - 1u);
+        }
+
+        struct ChunkDeleter
+        {
+            void operator()( std::byte* p ) const
+            {
+                ::operator delete( p, std::align_val_t( CacheLine ) );
+            }
+        };
+        using ChunkPtr = std::unique_ptr<std::byte, ChunkDeleter>;
+
+        // Every entity with exactly the component set mask. Entities are
+        // numbered 0..size-1 across the chunks, capacity to a chunk, and
+        // stay packed: removing one moves the last into its place.
+        class Archetype
+        {
+        public:
+            explicit Archetype( ComponentMask mask )
+                : mask( mask )
+            {
+                const std::size_t* sizes = ComponentSizes();
+                std::size_t rowBytes = sizeof( Entity );
+                int columns = 1;
+                for( int id = 0; id < MaxComponentTypes; ++id )
+                {
+                    if( (mask >> id & 1u) != 0u )
+                    {
+                        rowBytes += sizes[id];
+                        ++columns;
+                    }
+                }
+                // Leave room to start every array on a cache line
+                capacity = static_cast<int>((ChunkBytes - CacheLine * std::size_t( columns )) / rowBytes);
+                if( capacity < 1 )
+                {
+                    throw std::length_error( "Ecs: components too large for a chunk" );
+                }
+                std::size_t offset = Detail::AlignUp( sizeof( Entity ) * std::size_t( capacity ) );
+                for( int id = 0; id < MaxComponentTypes; ++id )
+                {
+                    columnOffset[id] = 0u;
+                    columnSize[id] = 0u;
+                    if( (mask >> id & 1u) != 0u )
+                    {
+                        columnOffset[id] = offset;
+                        columnSize[id] = sizes[id];
+                        offset = Detail::AlignUp( offset + sizes[id] * std::size_t( capacity ) );
+                    }
+                }
+            }
+            ComponentMask GetMask() const
+            {
+                return mask;
+            }
+            int GetSize() const
+            {
+                return size;
+            }
+            int GetCapacity() const
+            {
+                return capacity;
+            }
+            int GetChunkCount() const
+            {
+                return static_cast<int>((size + capacity - 1) / capacity);
+            }
+            // Rows in chunk c, which are entities c * capacity onwards
+            int GetChunkSize( int c ) const
+            {
+                return std::min( capacity, size - c * capacity );
+            }
+            Entity* EntitiesOf( int c ) const
+            {
+                return reinterpret_cast<Entity*>(chunks[c].get());
+            }
+            template<typename T>
+            T* ColumnOf( int c ) const
+            {
+                return reinterpret_cast<T*>(chunks[c].get() + columnOffset[ComponentType<T>::Id()]);
+            }
+            void* Component( int id, int row ) const
+            {
+                return chunks[row / capacity].get() + columnOffset[id] + columnSize[id] * std::size_t( row % capacity );
+            }
+            Entity& EntityAt( int row ) const
+            {
+                return EntitiesOf( row / capacity )[row % capacity];
+            }
+            // New row for e, components left uninitialized
+            int Append( Entity e )
+            {
+                if( size == static_cast<int>(chunks.size()) * capacity )
+                {
+                    chunks.emplace_back( static_cast<std::byte*>(::operator new( ChunkBytes, std::align_val_t( CacheLine ) )) );
+                }
+                EntityAt( size ) = e;
+                return size++;
+            }
+            // Fills row with the last row and drops the last; returns the
+            // entity that moved into row, or a null one if row was last.
+            // Chunks stay allocated for reuse.
+            Entity RemoveSwap( int row )
+            {
+                const int last = --size;
+                if( row == last )
+                {
+                    return Entity{};
+                }
+                for( int id = 0; id < MaxComponentTypes; ++id )
+                {
+                    if( (mask >> id & 1u) != 0u )
+                    {
+                        std::memcpy( Component( id, row ), Component( id, last ), columnSize[id] );
+                    }
+                }
+                EntityAt( row ) = EntityAt( last );
+                return EntityAt( row );
+            }
+
+        private:
+            ComponentMask mask;
+            int capacity = 0;
+            int size = 0;
+            std::size_t columnOffset[MaxComponentTypes];
+            std::size_t columnSize[MaxComponentTypes];
+            std::vector<ChunkPtr> chunks;
+        };
+    }
+
+    template<typename T>
+    int ComponentId()
+    {
+        static_assert( std::is_trivially_copyable<T>::value, "Ecs components must be trivially copyable" );
+        return Detail::ComponentType<T>::Id();
+    }
+
+    template<typename... Ts>
+    ComponentMask MaskOf()
+    {
+        return (ComponentMask( 0u ) | ... | (ComponentMask( 1u ) << ComponentId<Ts>()));
+    }
+
+    // Every entity that has all of Ts (and none of the excluded types),
+    // visited archetype by archetype and chunk by chunk
+    template<typename... Ts>
+    class View
+    {
+    public:
+        explicit View( const std::vector<std::unique_ptr<Detail::Archetype>>& archetypes )
+            : archetypes( archetypes ),
+              required( MaskOf<Ts...>() )
+        {
+        }
+        // Skips entities that also have any of Us
+        template<typename... Us>
+        View& Exclude()
+        {
+            excluded |= MaskOf<Us...>();
+            return *this;
+        }
+        // fn( Ts&... ) for every entity
+        template<typename Fn>
+        void ForEach( Fn&& fn ) const
+        {
+            ForEachChunk( [&fn]( int count, const Entity*, Ts*... columns )
+            {
+                for( int i = 0; i < count; ++i )
+                {
+                    fn( columns[i]... );
+                }
+            } );
+        }
+        // fn( Entity, Ts&... ) for every entity
+        template<typename Fn>
+        void ForEachEntity( Fn&& fn ) const
+        {
+            ForEachChunk( [&fn]( int count, const Entity* pEntities, Ts*... columns )
+            {
+                for( int i = 0; i < count; ++i )
+                {
+                    fn( pEntities[i], columns[i]... );
+                }
+            } );
+        }
+        // fn( count, const Entity*, Ts*... ) once per chunk, with the
+        // chunk's dense arrays, for loops the compiler can vectorize
+        template<typename Fn>
+        void ForEachChunk( Fn&& fn ) const
+        {
+            for( const auto& pArchetype : archetypes )
+            {
+                const ComponentMask mask = pArchetype->GetMask();
+                if( (mask & required) != required || (mask & excluded) != 0u )
+                {
+                    continue;
+                }
+                for( int c = 0; c < pArchetype->GetChunkCount(); ++c )
+                {
+                    fn( pArchetype->GetChunkSize( c ), pArchetype->EntitiesOf( c ), pArchetype->template ColumnOf<Ts>( c )... );
+                }
+            }
+        }
+        int Count() const
+        {
+            int count = 0;
+            for( const auto& pArchetype : archetypes )
+            {
+                const ComponentMask mask = pArchetype->GetMask();
+                if( (mask & required) == required && (mask & excluded) == 0u )
+                {
+                    count += pArchetype->GetSize();
+                }
+            }
+            return count;
+        }
+
+    private:
+        const std::vector<std::unique_ptr<Detail::Archetype>>& archetypes;
+        ComponentMask required;
+        ComponentMask excluded = 0u;
+    };
+
+    class World
+    {
+    public:
+        World() = default;
+        World( const World& ) = delete;
+        World& operator=( const World& ) = delete;
+        // New entity with exactly these components
+        template<typename... Ts>
+        Entity Create( const Ts&... components )
+        {
+            Detail::Archetype& archetype = ArchetypeFor( MaskOf<Ts...>() );
+            Entity e;
+            if( !freeIndices.empty() )
+            {
+                e.index = freeIndices.back();
+                freeIndices.pop_back();
+            }
+            else
+            {
+                e.index = static_cast<std::uint32_t>(records.size());
+                records.push_back( {} );
+            }
+            Record& r = records[e.index];
+            e.generation = r.generation;
+            r.pArchetype = &archetype;
+            r.row = archetype.Append( e );
+            (std::memcpy( archetype.Component( ComponentId<Ts>(), r.row ), &components, sizeof( Ts ) ), ...);
+            ++entityCount;
+            return e;
+        }
+        // Does nothing for a dead or null handle
+        void Destroy( Entity e )
+        {
+            if( !IsAlive( e ) )
+            {
+                return;
+            }
+            Record& r = records[e.index];
+            Detach( r );
+            r.pArchetype = nullptr;
+            ++r.generation;
+            freeIndices.push_back( e.index );
+            --entityCount;
+        }
+        bool IsAlive( Entity e ) const
+        {
+            return e.index < records.size() && records[e.index].generation == e.generation &&
+                records[e.index].pArchetype != nullptr;
+        }
+        template<typename T>
+        bool Has( Entity e ) const
+        {
+            return IsAlive( e ) && (records[e.index].pArchetype->GetMask() & MaskOf<T>()) != 0u;
+        }
+        // Null if e is dead or has no T. The pointer is good until entities
+        // are next created, destroyed or given or stripped of components.
+        template<typename T>
+        T* Find( Entity e )
+        {
+            if( !Has<T>( e ) )
+            {
+                return nullptr;
+            }
+            const Record& r = records[e.index];
+            return static_cast<T*>(r.pArchetype->Component( ComponentId<T>(), r.row ));
+        }
+        // Throws std::logic_error if e is dead or has no T
+        template<typename T>
+        T& Get( Entity e )
+        {
+            T* p = Find<T>( e );
+            if( p == nullptr )
+            {
+                throw std::logic_error( "Ecs::World::Get: entity lacks the component" );
+            }
+            return *p;
+        }
+        // Sets e's T, moving e to the archetype with T if it had none.
+        // Throws std::logic_error for a dead entity.
+        template<typename T>
+        void Add( Entity e, const T& component )
+        {
+            if( !IsAlive( e ) )
+            {
+                throw std::logic_error( "Ecs::World::Add: dead entity" );
+            }
+            Record& r = records[e.index];
+            const ComponentMask mask = r.pArchetype->GetMask();
+            if( (mask & MaskOf<T>()) == 0u )
+            {
+                MoveTo( e, ArchetypeFor( mask | MaskOf<T>() ) );
+            }
+            std::memcpy( r.pArchetype->Component( ComponentId<T>(), r.row ), &component, sizeof( T ) );
+        }
+        // Drops e's T, if it has one
+        template<typename T>
+        void Remove( Entity e )
+        {
+            if( Has<T>( e ) )
+            {
+                MoveTo( e, ArchetypeFor( records[e.index].pArchetype->GetMask() & ~MaskOf<T>() ) );
+            }
+        }
+        template<typename... Ts>
+        View<Ts...> Query()
+        {
+            return View<Ts...>( archetypes );
+        }
+        int GetEntityCount() const
+        {
+            return entityCount;
+        }
+
+    private:
+        struct Record
+        {
+            Detail::Archetype* pArchetype = nullptr;
+            int row = 0;
+            std::uint32_t generation = 0u;
+        };
+
+    private:
+        Detail::Archetype& ArchetypeFor( ComponentMask mask )
+        {
+            for( const auto& pArchetype : archetypes )
+            {
+                if( pArchetype->GetMask() == mask )
+                {
+                    return *pArchetype;
+                }
+            }
+            archetypes.push_back( std::make_unique<Detail::Archetype>( mask ) );
+            return *archetypes.back();
+        }
+        // Takes the entity out of its archetype, fixing up whichever entity
+        // was moved into its row
+        void Detach( const Record& r )
+        {
+            const Entity moved = r.pArchetype->RemoveSwap( r.row );
+            if( !moved.IsNull() )
+            {
+                records[moved.index].row = r.row;
+            }
+        }
+        // Copies the components both archetypes have, then detaches from
+        // the old one
+        void MoveTo( Entity e, Detail::Archetype& to )
+        {
+            Record& r = records[e.index];
+            Detail::Archetype& from = *r.pArchetype;
+            const int row = to.Append( e );
+            const ComponentMask shared = from.GetMask() & to.GetMask();
+            const std::size_t* sizes = Detail::ComponentSizes();
+            for( int id = 0; id < MaxComponentTypes; ++id )
+            {
+                if( (shared >> id & 1u) != 0u )
+                {
+                    std::memcpy( to.Component( id, row ), from.Component( id, r.row ), sizes[id] );
+                }
+            }
+            Detach( r );
+            r.pArchetype = &to;
+            r.row = row;
+        }
+
+    private:
+        std::vector<std::unique_ptr<Detail::Archetype>> archetypes;
+        std::vector<Record> records;
+        std::vector<std::uint32_t> freeIndices;
+        int entityCount = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef FIXEDGRAPHICS_H
+#define FIXEDGRAPHICS_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include "Graphics.h"
+#include "Raster.h"
+
+// Graphics with the resolution and pixel format fixed at compile time.
+// Pitch, clipping bounds and tile indexing are all constants, so the
+// shared rasterizers in Raster.h fold their address math and clip tests
+// and the compiler is free to unroll and vectorize the fill loops. It
+// draws immediately into the back buffer of a runtime Graphics of the
+// same size, which still does the presenting (upscaling, palette
+// expansion, pipelining); GetGraphics() reaches its other features.
+//
+//   FixedGraphics<320, 200, Graphics::PixelFormat::Indexed8> gfx( wnd );
+//   gfx.BeginFrame();
+//   gfx.DrawRect( 10, 10, 32, 32, 7 );
+//   gfx.EndFrame();
+//
+// Graphics stays the fallback for sizes only known at run time.
+template<int Width, int Height, Graphics::PixelFormat Format = Graphics::PixelFormat::RGBA32>
+class FixedGraphics
+{
+    static_assert( Width > 0 && Height > 0, "FixedGraphics needs a non-empty surface" );
+
+public:
+    static constexpr bool Indexed = Format == Graphics::PixelFormat::Indexed8;
+    // What is stored per pixel, and what the primitives take: a Color in
+    // RGBA32, a palette index in Indexed8
+    using Pixel = std::conditional_t<Indexed, std::uint8_t, std::uint32_t>;
+    using Value = std::conditional_t<Indexed, std::uint8_t, Color>;
+    // Must match the runtime Graphics layout; checked on construction
+    static constexpr int Pitch = Indexed ? (Width + 63) & ~63 : Width;
+    static constexpr int TileSize = Graphics::TileSize;
+    static constexpr int TilesX = (Width + TileSize - 1) / TileSize;
+    static constexpr int TilesY = (Height + TileSize - 1) / TileSize;
+
+    // A surface the rasterizers see as all constants but the pixel pointer
+    struct FixedSurface
+    {
+        Pixel* pixels;
+        static constexpr int pitch = Pitch;
+        static constexpr int width = Width;
+        static constexpr int height = Height;
+    };
+
+public:
+    explicit FixedGraphics( MainWindow& wnd )
+        : gfx( wnd, Width, Height )
+    {
+        gfx.SetPixelFormat( Format );
+        // An empty region marks nothing dirty; the pointer stays valid as
+        // long as the format is left alone
+        if constexpr( Indexed )
+        {
+            const Graphics::RawIndexSurface s = gfx.GetRawIndexSurface( 0, 0, 0, 0 );
+            surface.pixels = s.pixels;
+            CheckLayout( s.pitch, s.width, s.height );
+        }
+        else
+        {
+            const Graphics::RawSurface s = gfx.GetRawSurface( 0, 0, 0, 0 );
+            surface.pixels = s.pixels;
+            CheckLayout( s.pitch, s.width, s.height );
+        }
+    }
+    FixedGraphics( const FixedGraphics& ) = delete;
+    FixedGraphics& operator=( const FixedGraphics& ) = delete;
+    void BeginFrame()
+    {
+        FlushDirty();
+        gfx.BeginFrame();
+    }
+    void EndFrame()
+    {
+        FlushDirty();
+        gfx.EndFrame();
+    }
+    // Same semantics as the Graphics primitives: everything clips against
+    // the surface, coordinates are inclusive and rects are top-left + size
+    void PutPixel( int x, int y, Value v )
+    {
+        if( unsigned( x ) >= unsigned( Width ) || unsigned( y ) >= unsigned( Height ) )
+        {
+            return;
+        }
+        surface.pixels[y * Pitch + x] = static_cast<Pixel>(ValueOf( v ));
+        MarkTile( x / TileSize, y / TileSize );
+    }
+    void Clear( Value v )
+    {
+        Raster::RasterRect( surface, Clip, 0, 0, Width, Height, ValueOf( v ) );
+        dirtyTiles.fill( ~std::uint64_t( 0 ) );
+    }
+    void DrawHLine( int x0, int x1, int y, Value v )
+    {
+        Raster::RasterSpan( surface, Clip, x0, x1, y, ValueOf( v ) );
+        MarkDirty( std::min( x0, x1 ), y, std::abs( x1 - x0 ) + 1, 1 );
+    }
+    void DrawRect( int x, int y, int w, int h, Value v )
+    {
+        Raster::RasterRect( surface, Clip, x, y, w, h, ValueOf( v ) );
+        MarkDirty( x, y, w, h );
+    }
+    void DrawLine( int x0, int y0, int x1, int y1, Value v )
+    {
+        Raster::RasterLine( surface, Clip, x0, y0, x1, y1, ValueOf( v ) );
+        Raster::ForEachLineBand( x0, y0, x1, y1, Height, TileSize, [this]( int x, int y, int w, int h )
+        {
+            MarkDirty( x, y, w, h );
+        } );
+    }
+    void DrawCircle( int cx, int cy, int radius, Value v )
+    {
+        Raster::RasterCircle( surface, Clip, cx, cy, radius, ValueOf( v ) );
+        MarkDirty( cx - radius, cy - radius, 2 * radius + 1, 2 * radius + 1 );
+    }
+    void FillCircle( int cx, int cy, int radius, Value v )
+    {
+        Raster::RasterFilledCircle( surface, Clip, cx, cy, radius, ValueOf( v ) );
+        MarkDirty( cx - radius, cy - radius, 2 * radius + 1, 2 * radius + 1 );
+    }
+    void DrawText( int x, int y, std::string_view text, Value v, int scale = 1 )
+    {
+        scale = std::max( scale, 1 );
+        const int size = BitmapFont::GlyphSize * scale;
+        int penX = x;
+        int penY = y;
+        for( const char ch : text )
+        {
+            if( ch == '\n' )
+            {
+                penX = x;
+                penY += size;
+                continue;
+            }
+            if( ch != ' ' && penX < Width && penX + size > 0 && penY < Height && penY + size > 0 )
+            {
+                Raster::RasterGlyph( surface, Clip, penX, penY, BitmapFont::GetGlyph( ch ), scale, ValueOf( v ) );
+                MarkDirty( penX, penY, size, size );
+            }
+            penX += size;
+        }
+    }
+    // Direct access; writes through it must be covered by MarkDirty
+    FixedSurface GetSurface() const
+    {
+        return surface;
+    }
+    void MarkDirty( int x, int y, int w, int h )
+    {
+        const int left = std::max( x, 0 );
+        const int top = std::max( y, 0 );
+        const int right = std::min( x + w, Width );
+        const int bottom = std::min( y + h, Height );
+        if( left >= right || top >= bottom )
+        {
+            return;
+        }
+        for( int ty = top / TileSize; ty <= (bottom - 1) / TileSize; ++ty )
+        {
+            for( int tx = left / TileSize; tx <= (right - 1) / TileSize; ++tx )
+            {
+                MarkTile( tx, ty );
+            }
+        }
+    }
+    // The runtime Graphics underneath, for the palette, pipelining, sprites
+    // and the viewport. Its pixel format and raster mode must stay as they
+    // are: this class writes the back buffer directly and assumes both.
+    Graphics& GetGraphics()
+    {
+        return gfx;
+    }
+    static constexpr int GetWidth()
+    {
+        return Width;
+    }
+    static constexpr int GetHeight()
+    {
+        return Height;
+    }
+
+private:
+    static std::uint32_t ValueOf( Value v )
+    {
+        if constexpr( Indexed )
+        {
+            return v;
+        }
+        else
+        {
+            return v.dword;
+        }
+    }
+    void CheckLayout( int pitch, int width, int height ) const
+    {
+        if( pitch != Pitch || width != Width || height != Height )
+        {
+            throw std::logic_error( "FixedGraphics layout does not match Graphics" );
+        }
+    }
+    void MarkTile( int tx, int ty )
+    {
+        const int tile = ty * TilesX + tx;
+        dirtyTiles[tile >> 6] |= std::uint64_t( 1 ) << (tile & 63);
+    }
+    // Hands the tiles drawn since the last flush to Graphics, which uploads
+    // them in EndFrame and clears them again in the next BeginFrame
+    void FlushDirty()
+    {
+        for( int ty = 0; ty < TilesY; ++ty )
+        {
+            for( int tx = 0; tx < TilesX; ++tx )
+            {
+                const int tile = ty * TilesX + tx;
+                if( (dirtyTiles[tile >> 6] >> (tile & 63) & 1u) != 0u )
+                {
+                    gfx.MarkDirty( tx * TileSize, ty * TileSize, TileSize, TileSize );
+                }
+            }
+        }
+        dirtyTiles.fill( 0u );
+    }
+
+private:
+    static constexpr Raster::ClipRect Clip = { 0, 0, Width, Height };
+    Graphics gfx;
+    FixedSurface surface = { nullptr };
+    std::array<std::uint64_t, (TilesX * TilesY + 63) / 64> dirtyTiles = {};
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// Holds a loop to a fixed frame rate. Wait sleeps until shortly before the
+// next deadline and spins the rest of the way, which lands within about
+// 100 us where a plain sleep (and setFramerateLimit, which is one) can
+// overshoot by a millisecond or more. The spin window follows how late the
+// OS has actually been waking us, so it stays short on a quiet machine.
+// While the window is unfocused the loop drops to a low idle rate, and
+// deadlines the loop could not make are counted instead of caught up on.
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+public:
+    explicit FramePacer( double targetHz = 60.0, double idleHz = 10.0 )
+    {
+        SetTargetRate( targetHz );
+        SetIdleRate( idleHz );
+    }
+    void SetTargetRate( double hz )
+    {
+        targetPeriod = PeriodOf( hz );
+    }
+    void SetIdleRate( double hz )
+    {
+        idlePeriod = PeriodOf( hz );
+    }
+    // Unfocused windows run at the idle rate
+    void SetFocused( bool isFocused )
+    {
+        focused = isFocused;
+    }
+    bool IsFocused() const
+    {
+        return focused;
+    }
+    // Call once per frame, after presenting
+    void Wait()
+    {
+        const Clock::duration period = focused ? targetPeriod : idlePeriod;
+        Clock::time_point now = Clock::now();
+        if( frameCount == 0u )
+        {
+            deadline = now + period;
+        }
+        ++frameCount;
+        if( now > deadline )
+        {
+            // The frame itself overran; report it and start a fresh
+            // schedule from now rather than rushing the next frames
+            ++missedDeadlines;
+            const Clock::duration late = now - deadline;
+            lastLateness = late;
+            worstLateness = std::max( worstLateness, late );
+            deadline = now + period;
+            return;
+        }
+        lastLateness = Clock::duration::zero();
+
+        const Clock::time_point wake = deadline - spinWindow;
+        if( now < wake )
+        {
+            std::this_thread::sleep_until( wake );
+            now = Clock::now();
+            // Track how late sleeps come back (fast attack, slow decay)
+            // and keep the spin window a little above that
+            const Clock::duration overshoot = std::max( now - wake, Clock::duration::zero() );
+            sleepOvershoot = overshoot > sleepOvershoot ? overshoot : (sleepOvershoot * 15 + overshoot) / 16;
+            spinWindow = std::clamp<Clock::duration>( sleepOvershoot + sleepOvershoot / 2 + std::chrono::microseconds( 50 ),
+                std::chrono::microseconds( 100 ), std::chrono::milliseconds( 4 ) );
+        }
+        while( Clock::now() < deadline )
+        {
+            std::this_thread::yield();
+        }
+        deadline += period;
+    }
+    std::uint64_t GetFrameCount() const
+    {
+        return frameCount;
+    }
+    std::uint64_t GetMissedDeadlines() const
+    {
+        return missedDeadlines;
+    }
+    // How late the last frame arrived at its deadline (zero if on time), and
+    // the worst so far
+    Clock::duration GetLastLateness() const
+    {
+        return lastLateness;
+    }
+    Clock::duration GetWorstLateness() const
+    {
+        return worstLateness;
+    }
+
+private:
+    static Clock::duration PeriodOf( double hz )
+    {
+        return std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( 1.0 / std::max( hz, 1.0 ) ) );
+    }
+
+private:
+    Clock::duration targetPeriod;
+    Clock::duration idlePeriod;
+    bool focused = true;
+    Clock::time_point deadline;
+    Clock::duration spinWindow = std::chrono::milliseconds( 1 );
+    Clock::duration sleepOvershoot = Clock::duration::zero();
+    std::uint64_t frameCount = 0u;
+    std::uint64_t missedDeadlines = 0u;
+    Clock::duration lastLateness = Clock::duration::zero();
+    Clock::duration worstLateness = Clock::duration::zero();
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+class Graphics;
+
+// Records how long each phase of Game::Go takes over the last HistoryFrames
+// frames. The game thread is the only writer. Each slot of the ring is
+// guarded by a sequence number (a seqlock) and holds its times in atomics,
+// so other threads may read stats without locking: a reader that overlaps
+// the write of a slot sees the sequence change and reads that slot again.
+class FrameProfiler
+{
+public:
+    enum class Phase
+    {
+        BeginFrame,
+        UpdateModel,
+        ComposeFrame,
+        EndFrame,
+        Count
+    };
+    static constexpr int PhaseCount = static_cast<int>(Phase::Count);
+    static constexpr int HistoryFrames = 1024;
+
+    struct Stats
+    {
+        float minMs;
+        float avgMs;
+        float p99Ms;
+    };
+
+    // Adds the lifetime of the timer to the given phase of the current frame
+    class ScopedTimer
+    {
+    public:
+        ScopedTimer( FrameProfiler& profiler, Phase phase );
+        ScopedTimer( const ScopedTimer& ) = delete;
+        ScopedTimer& operator=( const ScopedTimer& ) = delete;
+        ~ScopedTimer();
+
+    private:
+        FrameProfiler& profiler;
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+    };
+
+public:
+    // Closes the current frame's sample and starts the next one
+    void NextFrame();
+    // Stats over the recorded history; a phase index of PhaseCount means
+    // the whole frame
+    Stats GetStats( int phaseIndex ) const;
+    std::uint64_t GetFrameCount() const;
+    // Bar chart in the top-left corner: one labeled row per phase plus the
+    // total, the bar spanning min..avg, a white tick at avg and a red tick at
+    // p99, followed by avg and p99 in ms. The grey line marks a 60 Hz frame
+    // budget.
+    void DrawOverlay( Graphics& gfx ) const;
+    void ToggleOverlay();
+    bool IsOverlayVisible() const;
+    // One row per recorded frame, oldest first, times in milliseconds
+    bool WriteCsv( const std::string& path ) const;
+
+private:
+    struct FrameSample
+    {
+        std::array<float, PhaseCount> phaseMs;
+        float totalMs;
+    };
+
+    // One ring entry. sequence is odd while the game thread is writing the
+    // times and goes up by two per write.
+    struct HistorySlot
+    {
+        std::atomic<std::uint32_t> sequence { 0u };
+        std::array<std::atomic<float>, PhaseCount + 1> ms;
+    };
+
+private:
+    void WriteSample( HistorySlot& slot, const FrameSample& fs );
+    FrameSample ReadSample( const HistorySlot& slot ) const;
+
+private:
+    std::array<HistorySlot, HistoryFrames> history;
+    FrameSample current = {};
+    std::chrono::steady_clock::time_point frameStart;
+    std::atomic<std::uint64_t> framesRecorded { 0u };
+    bool overlayVisible = false;
+};
+
+#endif
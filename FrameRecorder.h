@@ -0,0 +1,96 @@
+#ifndef FRAMERECORDER_H
+#define FRAMERECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records presented frames without holding up the game loop. Capture copies
+// a frame into one of a fixed pool of buffers allocated up front, and a
+// background thread encodes the buffers in order. When every buffer is
+// still waiting for the encoder, the frame is dropped and counted instead
+// of waiting. Graphics calls Capture from EndFrame once it is handed a
+// recorder (Graphics::SetFrameRecorder).
+//
+// RawVideo writes packed RGBA frames back to back into one file, e.g. for
+//   ffmpeg -f rawvideo -pixel_format rgba -video_size 800x600 -framerate 60 -i capture.rgba capture.mp4
+// PngSequence writes path's stem plus a six digit frame number per frame
+// (capture.png -> capture_000000.png, ..., and out.d/frames ->
+// out.d/frames_000000 when the name has no extension). The PNGs are stored rather
+// than deflated, which keeps the encoder far ahead of the game at the
+// price of file size.
+class FrameRecorder
+{
+public:
+    enum class Format
+    {
+        RawVideo,
+        PngSequence
+    };
+
+public:
+    // Throws std::runtime_error if a raw video file cannot be created
+    FrameRecorder( const std::string& path, Format format, int width, int height, int bufferCount = 8 );
+    FrameRecorder( const FrameRecorder& ) = delete;
+    FrameRecorder& operator=( const FrameRecorder& ) = delete;
+    // Finishes encoding whatever was captured, then stops the thread
+    ~FrameRecorder();
+    // Picks the format from path's extension: .png for a sequence,
+    // anything else for raw video
+    static Format FormatFor( const std::string& path );
+    // Copies width x height pixels (pitch in pixels) and queues them; false
+    // if the frame was dropped
+    bool Capture( const std::uint32_t* pPixels, int pitch );
+    // Blocks until every captured frame has been encoded
+    void Flush();
+    int GetWidth() const;
+    int GetHeight() const;
+    std::uint64_t GetCapturedFrames() const;
+    std::uint64_t GetDroppedFrames() const;
+    std::uint64_t GetEncodedFrames() const;
+    // Set when a write failed; later frames are still counted but not saved
+    bool HasFailed() const;
+
+private:
+    void EncoderMain();
+    void Encode( const std::uint32_t* pPixels, std::uint64_t frame );
+    bool WritePng( const std::string& filePath, const std::uint32_t* pPixels );
+
+private:
+    std::string path;
+    // PngSequence file names are framePrefix + "_000042" + frameSuffix:
+    // path's directory and stem, then its extension (possibly empty)
+    std::string framePrefix;
+    std::string frameSuffix;
+    Format format;
+    int width;
+    int height;
+    std::ofstream rawOut;
+    // Frame buffers and the frame number each holds. Slots cycle between
+    // freeSlots and the FIFO queuedSlots (ring of bufferCount entries
+    // from queueHead), so capturing allocates nothing.
+    std::vector<std::vector<std::uint32_t>> buffers;
+    std::vector<std::uint64_t> bufferFrames;
+    std::vector<int> freeSlots;
+    std::vector<int> queuedSlots;
+    int queueHead = 0;
+    int queueCount = 0;
+    bool stopping = false;
+    std::mutex mtx;
+    std::condition_variable queued;
+    std::condition_variable drained;
+    // Encoder-thread only: PNG file image, reused between frames
+    std::vector<std::uint8_t> pngBytes;
+    std::atomic<std::uint64_t> capturedFrames{ 0u };
+    std::atomic<std::uint64_t> droppedFrames{ 0u };
+    std::atomic<std::uint64_t> encodedFrames{ 0u };
+    std::atomic<bool> failed{ false };
+    std::thread encoder;
+};
+
+#endif
@@ -1,9 +1,14 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <memory>
+#include <string>
 #include "Graphics.h"
+#include "FrameProfiler.h"
+#include "JobSystem.h"
 
 class MainWindow;
+class FrameRecorder;
 
 class Game
 {
@@ -11,14 +16,47 @@ public:
     Game( MainWindow& wnd );
     ~Game();
     void Go();
+    // Simulation runs in fixed ticks of 1 / ticksPerSecond, independent of
+    // how often Go is called. When a frame falls behind by more than
+    // maxSteps ticks the backlog is dropped instead of stalling rendering.
+    void SetTickRate( float ticksPerSecond );
+    void SetMaxCatchUpSteps( int maxSteps );
+    // Presents on a render thread so the next frame's UpdateModel overlaps
+    // the upload and display of this one; see Graphics::SetPipelining
+    void SetPipelining( int framesInFlight );
+    void ToggleProfilerOverlay();
+    // Writes the profiler's last frames to path when the game is destroyed;
+    // an empty path (the default unless CHILI_PROFILE_CSV is set) writes
+    // nothing
+    void SetProfileCsv( const std::string& path );
+    // Records every presented frame to path, as raw RGBA video or, for a
+    // .png path, a numbered PNG sequence; see FrameRecorder. Throws
+    // std::runtime_error if the output cannot be created.
+    void StartRecording( const std::string& path );
+    // Waits for the encoder to catch up; false if any frame failed to write
+    bool StopRecording();
+    // nullptr when not recording
+    const FrameRecorder* GetRecorder() const;
     
 private:
-    void UpdateModel();
-    void ComposeFrame();
+    // May split its work across jobs (ParallelFor, or Submit and Wait);
+    // whatever it posts to the main thread runs once the tick is done
+    void UpdateModel( float dt );
+    // alpha is how far (0..1) real time has moved past the last tick, for
+    // interpolating between the previous and current simulation state
+    void ComposeFrame( float alpha );
     
 private:
     MainWindow& wnd;
     Graphics gfx;
+    FrameProfiler profiler;
+    JobSystem jobs;
+    std::string profileCsvPath;
+    std::unique_ptr<FrameRecorder> pRecorder;
+    sf::Clock frameClock;
+    sf::Time tickDuration;
+    sf::Time accumulator;
+    int maxCatchUpSteps = 5;
 };
 
 #endif
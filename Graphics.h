@@ -2,21 +2,455 @@
 #define GRAPHICS_H
 
 #include <SFML/Graphics.hpp>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "Colors.h"
+
+class Surface;
+class WorkerPool;
+class PostProcess;
+class FrameRecorder;
 
 class MainWindow;
 
 class Graphics
 {
+public:
+    // Direct access to the back buffer for code that writes pixels in bulk.
+    // Pixels are 32-bit RGBA in memory order (the layout sf::Texture::update
+    // takes), and pitch is measured in pixels, not bytes.
+    struct RawSurface
+    {
+        std::uint32_t* pixels;
+        int pitch;
+        int width;
+        int height;
+    };
+
+    // The back buffer in indexed mode: one palette index per pixel, pitch
+    // in pixels (= bytes)
+    struct RawIndexSurface
+    {
+        std::uint8_t* pixels;
+        int pitch;
+        int width;
+        int height;
+    };
+
+    // Indexed8 draws 8-bit palette indices into a byte-per-pixel surface and
+    // expands the tiles that changed through the 256-entry palette in
+    // EndFrame. Changing the palette re-expands the whole screen without
+    // redrawing anything, which is what palette cycling wants.
+    enum class PixelFormat
+    {
+        RGBA32,
+        Indexed8
+    };
+
+    // How DrawSprite combines source pixels with the back buffer
+    enum class SpriteBlend : std::uint8_t
+    {
+        Copy,       // overwrite
+        ColorKey,   // skip source pixels equal to the key color
+        Alpha       // premultiplied "over"
+    };
+
+    // How textured triangles read their surface between texel centers
+    enum class TextureFilter : std::uint8_t
+    {
+        Nearest,
+        Bilinear
+    };
+
+    // Corner of a textured triangle: where it lands on the surface and the
+    // point of the source surface it shows, both in pixels
+    struct TexVertex
+    {
+        float x;
+        float y;
+        float u;
+        float v;
+    };
+
+    // The surface is tracked in square tiles of this many pixels; only tiles
+    // written since the last present are uploaded to the texture.
+    static constexpr int TileSize = 32;
+
+    // Immediate draws straight into the back buffer. Binned records draw
+    // calls, sorts them into tiles and rasterizes the tiles in parallel in
+    // EndFrame; the pixels come out identical either way.
+    enum class RasterMode
+    {
+        Immediate,
+        Binned
+    };
+
+    // Records draw calls on any thread, for replay by the thread that owns
+    // the Graphics; defined below
+    class DrawList;
+
 public:
     Graphics( MainWindow& wnd );
+    // Renders into a fixed width x height surface (e.g. 320x200) and shows it
+    // at the largest integer scale that fits the window, centered, with
+    // black bars around it; throws std::runtime_error if it does not fit
+    Graphics( MainWindow& wnd, int width, int height );
+    Graphics( const Graphics& ) = delete;
+    Graphics& operator=( const Graphics& ) = delete;
     ~Graphics();
     void BeginFrame();
     void EndFrame();
     void PutPixel( int x, int y, int r, int g, int b );
+    void PutPixel( int x, int y, Color c );
+    // All primitives clip against the window; coordinates are inclusive
+    // pixel positions and rects are given as top-left plus size.
+    // Every primitive takes either a Color or a palette index and works in
+    // both pixel formats: in RGBA32 an index draws its current palette
+    // color, and in Indexed8 a Color draws the nearest palette entry.
+    void PutPixel( int x, int y, std::uint8_t index );
+    void Clear( Color c );
+    void Clear( std::uint8_t index );
+    void DrawHLine( int x0, int x1, int y, Color c );
+    void DrawHLine( int x0, int x1, int y, std::uint8_t index );
+    void DrawRect( int x, int y, int w, int h, Color c );
+    void DrawRect( int x, int y, int w, int h, std::uint8_t index );
+    void DrawLine( int x0, int y0, int x1, int y1, Color c );
+    void DrawLine( int x0, int y0, int x1, int y1, std::uint8_t index );
+    void DrawCircle( int cx, int cy, int radius, Color c );
+    void DrawCircle( int cx, int cy, int radius, std::uint8_t index );
+    void FillCircle( int cx, int cy, int radius, Color c );
+    void FillCircle( int cx, int cy, int radius, std::uint8_t index );
+    // Text in the 8x8 font from BitmapFont.h with its top-left at (x, y),
+    // every font pixel drawn as a scale x scale block; '\n' starts a new
+    // line. Nothing is allocated, so it is fine for per-frame HUD labels.
+    void DrawText( int x, int y, std::string_view text, Color c, int scale = 1 );
+    void DrawText( int x, int y, std::string_view text, std::uint8_t index, int scale = 1 );
+    // Blits srcRect of the surface with its top-left at (x, y). In binned
+    // mode the surface is read in EndFrame, so it must outlive the frame.
+    // In Indexed8 the sprite is blended over the palette colors underneath
+    // and every pixel it changes becomes the nearest palette entry; that
+    // match is a search of the palette per distinct color, so sprites with
+    // few colors (palette art) are cheap and smooth gradients are not.
+    void DrawSprite( int x, int y, const Surface& s, SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    void DrawSprite( int x, int y, const Surface& s, const sf::IntRect& srcRect,
+        SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    // Affine texture-mapped triangle. A pixel is drawn when its center is
+    // inside, with ties settled by the top-left rule so that triangles
+    // sharing an edge never both draw a pixel. Texture coordinates clamp to
+    // the surface edge. Blending, lifetime and format rules as DrawSprite.
+    void DrawTexturedTriangle( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const Surface& s,
+        TextureFilter filter = TextureFilter::Nearest, SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    // Drawn as the triangles v0 v1 v2 and v0 v2 v3
+    void DrawTexturedQuad( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const TexVertex& v3, const Surface& s,
+        TextureFilter filter = TextureFilter::Nearest, SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    // srcRect of the surface scaled, then rotated by angle radians (clockwise
+    // on screen) about its center, which lands on (cx, cy). Sampling stays
+    // inside srcRect, so neighbors in an atlas never bleed in.
+    void DrawSpriteTransformed( float cx, float cy, const Surface& s, float angle, float scale = 1.0f,
+        TextureFilter filter = TextureFilter::Bilinear, SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    void DrawSpriteTransformed( float cx, float cy, const Surface& s, const sf::IntRect& srcRect, float angle, float scale = 1.0f,
+        TextureFilter filter = TextureFilter::Bilinear, SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    // Writes through the raw surface bypass dirty tracking, so the first
+    // overload conservatively marks the whole surface for upload. Pass the
+    // region you are about to touch to only mark that.
+    RawSurface GetRawSurface();
+    RawSurface GetRawSurface( int x, int y, int w, int h );
+    // In Indexed8 the RGBA surface is overwritten by palette expansion,
+    // so bulk writers use the index surface instead
+    RawIndexSurface GetRawIndexSurface();
+    RawIndexSurface GetRawIndexSurface( int x, int y, int w, int h );
+    void MarkDirty( int x, int y, int w, int h );
+    // A persistent canvas keeps last frame's pixels instead of clearing to
+    // black in BeginFrame; only what is redrawn gets uploaded again.
+    void SetPersistentCanvas( bool persistent );
+    bool IsPersistentCanvas() const;
+    // Switching to Indexed8 starts from a surface of index 0, which is also
+    // what BeginFrame clears to in that format
+    void SetPixelFormat( PixelFormat format );
+    PixelFormat GetPixelFormat() const;
+    // The palette starts as a gray ramp from black (0) to white (255).
+    // SetPalette writes count colors from firstIndex on; the part of that
+    // range outside [0, 256) is skipped, and a negative count does nothing.
+    void SetPaletteEntry( std::uint8_t index, Color c );
+    void SetPalette( const Color* pColors, int count, int firstIndex = 0 );
+    Color GetPaletteEntry( std::uint8_t index ) const;
+    void SetRasterMode( RasterMode mode );
+    RasterMode GetRasterMode() const;
+    // Threads used by binned mode, the calling thread included; 1 forces
+    // single-threaded rasterization and 0 picks one per hardware thread.
+    void SetRasterThreads( unsigned int count );
+    unsigned int GetRasterThreads() const;
+    // Pipelined presenting: EndFrame copies the dirty tiles into a present
+    // slot and returns, and a render thread uploads and displays the slot
+    // while the next frame is updated and composed. framesInFlight bounds
+    // how many frames may wait for the screen (1 = double buffered, 2 =
+    // triple buffered, each adding a frame of latency); EndFrame blocks
+    // when all slots are taken. 0 presents serially on the calling thread.
+    void SetPipelining( int framesInFlight );
+    int GetPipelining() const;
+    // Blocks until every submitted frame is on screen (or, headless, in
+    // MainWindow::GetFrame)
+    void WaitForPresent();
+    // Draw lists let worker threads build a frame's draw data in parallel:
+    // each thread fills its own list without locking, and the lists are
+    // replayed on this thread in index order, so the frame never depends on
+    // which thread finished first. Lists keep their capacity across frames.
+    // Only SetDrawListCount and the replay must not race with recording.
+    void SetDrawListCount( int count );
+    int GetDrawListCount() const;
+    DrawList& GetDrawList( int index );
+    // Calls fn( list, i ) for i in [0, count) on the raster threads (see
+    // SetRasterThreads), growing the list count if needed; list i only
+    // ever sees call i
+    void RecordParallel( int count, const std::function<void( DrawList&, int )>& fn );
+    // Replays every list in index order after whatever was drawn directly
+    // so far, then empties them. EndFrame does this for lists still holding
+    // commands; call it earlier to have later direct draws land on top.
+    void SubmitDrawLists();
+    // Runs the effects chain on every frame in EndFrame, between drawing and
+    // presenting; the back buffer itself is left unprocessed. nullptr turns
+    // it off. Not owned, so it must outlive its use here.
+    void SetPostProcess( PostProcess* pPost );
+    // Hands every presented frame (after post effects) to the recorder in
+    // EndFrame. nullptr stops recording; not owned.
+    void SetFrameRecorder( FrameRecorder* pRec );
+    int GetWidth() const;
+    int GetHeight() const;
+    // Where the surface lands in the window, and its integer scale factor;
+    // window coordinates map back with (p - position) / scale
+    sf::IntRect GetViewport() const;
+    int GetPresentScale() const;
     
+private:
+    struct DrawCommand
+    {
+        enum class Type : std::uint8_t
+        {
+            Pixel,
+            Span,
+            Rect,
+            Line,
+            Circle,
+            FilledCircle,
+            Sprite,
+            Glyph,
+            TexturedTriangle
+        };
+        Type type;
+        SpriteBlend blend;
+        std::uint32_t color;
+        int a;
+        int b;
+        int c;
+        int d;
+        int e = 0;
+        int f = 0;
+        const Surface* pSurface = nullptr;
+        // Draw lists only: color holds a palette index, not a Color
+        bool indexed = false;
+    };
+
+    // A textured triangle after setup. Binned mode keeps these in
+    // texTriangles (DrawCommand::a indexes them) until the tiles are drawn.
+    struct TexturedTriangle
+    {
+        // a * x + b * y + c >= 0 for pixel centers inside, with x and y in
+        // 28.4 fixed point; the top-left rule is folded into c
+        std::int64_t a[3];
+        std::int64_t b[3];
+        std::int64_t c[3];
+        // Pixels that may be covered, half-open and within the surface
+        int left;
+        int top;
+        int right;
+        int bottom;
+        // Texture position at the center of pixel (left, 0) and its change
+        // per column and per row, in texels as 16.16 fixed point
+        std::int64_t u0;
+        std::int64_t v0;
+        std::int64_t dudx;
+        std::int64_t dvdx;
+        std::int64_t dudy;
+        std::int64_t dvdy;
+        const Surface* pSurface;
+        // Texels that sampling clamps to, half-open
+        int texLeft;
+        int texTop;
+        int texRight;
+        int texBottom;
+        TextureFilter filter;
+        SpriteBlend blend;
+        std::uint32_t key;
+    };
+
+    // A frame handed to the render thread: the tiles that changed, copied
+    // at their back buffer positions (other pixels are stale), and which
+    // tiles those are
+    struct PresentSlot
+    {
+        std::vector<std::uint32_t> pixels;
+        std::vector<std::uint64_t> dirtyTiles;
+    };
+
+private:
+    RawSurface SysSurface() const;
+    RawIndexSurface IndexSurface() const;
+    // Calls fn with whichever surface the current pixel format draws into
+    template<typename F>
+    void Rasterize( F&& fn );
+    // Color or palette index to what gets stored for the current format
+    std::uint32_t PixelValue( Color c );
+    std::uint32_t PixelValue( std::uint8_t index ) const;
+    std::uint8_t NearestPaletteIndex( Color c );
+    // Uncached search behind NearestPaletteIndex, safe from any thread
+    std::uint8_t SearchPalette( Color c ) const;
+    // Indexed8 drawing for the RGBA-only rasterizers (sprites, textured
+    // triangles): the clip rect's indices are expanded into the RGBA back
+    // buffer, which Indexed8 only uses as the expansion target and rewrites
+    // from the indices in EndFrame, rasterRgba( SysSurface() ) draws over
+    // them, and the pixels it changed are matched back to the palette. Each
+    // call stays inside its clip rect, so binned tiles can run it at once.
+    template<typename F>
+    void RasterThroughPalette( int clipLeft, int clipTop, int clipRight, int clipBottom, F&& rasterRgba ) const;
+    void PutPixelValue( int x, int y, std::uint32_t value );
+    void ClearValue( std::uint32_t value );
+    void HLineValue( int x0, int x1, int y, std::uint32_t value );
+    void RectValue( int x, int y, int w, int h, std::uint32_t value );
+    void LineValue( int x0, int y0, int x1, int y1, std::uint32_t value );
+    void CircleValue( int cx, int cy, int radius, std::uint32_t value );
+    void FilledCircleValue( int cx, int cy, int radius, std::uint32_t value );
+    void TextValue( int x, int y, std::string_view text, std::uint32_t value, int scale );
+    void GlyphValue( int x, int y, char ch, std::uint32_t value, int scale );
+    // texRect is already trimmed to the surface
+    void TexturedTriangleValue( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const Surface& s,
+        const sf::IntRect& texRect, TextureFilter filter, SpriteBlend blend, Color key );
+    bool SetupTexturedTriangle( TexVertex v0, TexVertex v1, TexVertex v2, TexturedTriangle& tri ) const;
+    static void RasterTexturedTriangle( const RawSurface& s, const TexturedTriangle& tri,
+        int clipLeft, int clipTop, int clipRight, int clipBottom );
+    void ExpandDirtyTiles();
+    void MarkTile( int tx, int ty );
+    void MarkLineDirty( int x0, int y0, int x1, int y1 );
+    void UploadDirtyTiles( const std::uint32_t* pSrcBuffer, std::vector<std::uint64_t>& tiles );
+    void PresentScaled( const std::uint32_t* pSrc, int srcPitch, int x, int y, int w, int h );
+    void Present();
+    void SubmitPresentSlot( const std::uint32_t* pSrcBuffer );
+    void RenderThreadMain();
+    void StopRenderThread();
+    void Record( const DrawCommand& cmd, int x, int y, int w, int h );
+    void RecordLine( const DrawCommand& cmd );
+    void BinRect( std::uint32_t cmdIndex, int x, int y, int w, int h );
+    void FlushCommands();
+
 private:
     MainWindow& wnd;
-    sf::RenderWindow& window;
+    sf::RenderWindow* pWindow = nullptr;
+    int width;
+    int height;
+    int pitch;
+    std::uint32_t* pSysBuffer = nullptr;
+    int tilesX;
+    int tilesY;
+    // One bit per tile: written since the last upload / holding anything
+    // other than the clear color since the last BeginFrame
+    std::vector<std::uint64_t> dirtyTiles;
+    std::vector<std::uint64_t> drawnTiles;
+    std::vector<std::uint32_t> uploadStaging;
+    int presentScale;
+    int presentX;
+    int presentY;
+    // One upscaled row for headless presents at scale > 1
+    std::vector<std::uint32_t> scaledRow;
+    bool persistentCanvas = false;
+    PixelFormat pixelFormat = PixelFormat::RGBA32;
+    std::uint8_t* pIndexBuffer = nullptr;
+    int indexPitch;
+    std::array<Color, 256> palette;
+    bool paletteChanged = false;
+    // Last Color -> index lookup, so runs of draws in one color search once
+    Color lastNearestColor = Colors::Black;
+    std::uint8_t lastNearestIndex = 0u;
+    RasterMode rasterMode = RasterMode::Immediate;
+    unsigned int rasterThreads;
+    std::unique_ptr<WorkerPool> pRasterPool;
+    std::vector<DrawCommand> commands;
+    std::vector<TexturedTriangle> texTriangles;
+    // Indices into commands per tile, in submission order
+    std::vector<std::vector<std::uint32_t>> tileBins;
+    std::vector<int> activeTiles;
+    std::vector<DrawList> drawLists;
+    PostProcess* pPostProcess = nullptr;
+    // Whether the last frame went through pPostProcess
+    bool postProcessed = false;
+    FrameRecorder* pRecorder = nullptr;
+    std::optional<sf::Texture> texture;
+    std::optional<sf::Sprite> sprite;
+    // Ring of present slots; presentQueued counts slots submitted and not
+    // yet presented, starting at presentRead
+    std::vector<PresentSlot> presentSlots;
+    int presentRead = 0;
+    int presentQueued = 0;
+    bool stopPresenting = false;
+    std::mutex presentMutex;
+    std::condition_variable presentCv;
+    std::thread renderThread;
+};
+
+// A thread-confined command buffer with the drawing calls of Graphics.
+// Recording only appends to a vector; clipping, color matching and
+// rasterizing all happen when Graphics replays the list. Colors and
+// palette indices are converted for the pixel format at replay time, and
+// sprites must outlive the replay.
+class Graphics::DrawList
+{
+public:
+    void PutPixel( int x, int y, Color c );
+    void PutPixel( int x, int y, std::uint8_t index );
+    void DrawHLine( int x0, int x1, int y, Color c );
+    void DrawHLine( int x0, int x1, int y, std::uint8_t index );
+    void DrawRect( int x, int y, int w, int h, Color c );
+    void DrawRect( int x, int y, int w, int h, std::uint8_t index );
+    void DrawLine( int x0, int y0, int x1, int y1, Color c );
+    void DrawLine( int x0, int y0, int x1, int y1, std::uint8_t index );
+    void DrawCircle( int cx, int cy, int radius, Color c );
+    void DrawCircle( int cx, int cy, int radius, std::uint8_t index );
+    void FillCircle( int cx, int cy, int radius, Color c );
+    void FillCircle( int cx, int cy, int radius, std::uint8_t index );
+    void DrawText( int x, int y, std::string_view text, Color c, int scale = 1 );
+    void DrawText( int x, int y, std::string_view text, std::uint8_t index, int scale = 1 );
+    void DrawSprite( int x, int y, const Surface& s, SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    void DrawSprite( int x, int y, const Surface& s, const sf::IntRect& srcRect,
+        SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    void DrawTexturedTriangle( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const Surface& s,
+        TextureFilter filter = TextureFilter::Nearest, SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    void DrawTexturedQuad( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const TexVertex& v3, const Surface& s,
+        TextureFilter filter = TextureFilter::Nearest, SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    void DrawSpriteTransformed( float cx, float cy, const Surface& s, float angle, float scale = 1.0f,
+        TextureFilter filter = TextureFilter::Bilinear, SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    void DrawSpriteTransformed( float cx, float cy, const Surface& s, const sf::IntRect& srcRect, float angle, float scale = 1.0f,
+        TextureFilter filter = TextureFilter::Bilinear, SpriteBlend blend = SpriteBlend::Alpha, Color key = Colors::Magenta );
+    void Reset();
+    std::size_t GetCommandCount() const;
+
+private:
+    friend class Graphics;
+    void Add( DrawCommand::Type type, std::uint32_t value, bool indexed, int a, int b, int c, int d );
+    void AddText( int x, int y, std::string_view text, std::uint32_t value, bool indexed, int scale );
+    void AddTriangle( const TexVertex& v0, const TexVertex& v1, const TexVertex& v2, const Surface& s,
+        const sf::IntRect& texRect, TextureFilter filter, SpriteBlend blend, Color key );
+
+private:
+    std::vector<DrawCommand> commands;
+    // Corners of textured triangles, three per command (DrawCommand::a is
+    // the first)
+    std::vector<TexVertex> vertices;
 };
 
 #endif
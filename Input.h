@@ -0,0 +1,285 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <SFML/Window.hpp>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+// Event-driven input state. Feed every event from the pollEvent pump, then
+// call NextFrame once per frame to get an immutable snapshot of that frame:
+// what is held, what went down or up during the frame (even if it went
+// down and up again between two frames), the ordered, timestamped presses
+// and releases, and the joystick axes. Keyboard keys, joystick buttons and
+// joystick axes pushed past a threshold all share one code space, so an
+// action bound to any mix of them is a single bitmask test.
+//
+// Only joystick 0 is tracked.
+class Input
+{
+public:
+    static constexpr int KeyCodes = static_cast<int>(sf::Keyboard::KeyCount);
+    static constexpr int ButtonCodes = static_cast<int>(sf::Joystick::ButtonCount);
+    static constexpr int AxisCount = static_cast<int>(sf::Joystick::AxisCount);
+    static constexpr int CodeCount = KeyCodes + ButtonCodes + AxisCount * 2;
+    using Mask = std::bitset<CodeCount>;
+
+    static constexpr int KeyCode( sf::Keyboard::Key key )
+    {
+        return static_cast<int>(key);
+    }
+    static constexpr int ButtonCode( unsigned int button )
+    {
+        return KeyCodes + static_cast<int>(button);
+    }
+    // The axis pushed past the threshold in the positive or negative direction
+    static constexpr int AxisCode( sf::Joystick::Axis axis, bool positive )
+    {
+        return KeyCodes + ButtonCodes + static_cast<int>(axis) * 2 + (positive ? 0 : 1);
+    }
+
+    struct Event
+    {
+        std::int64_t timeUs;
+        std::uint16_t code;
+        bool pressed;
+    };
+
+    // Actions compiled to masks over the shared code space
+    class ActionMap
+    {
+    public:
+        explicit ActionMap( int actionCount )
+            : masks( actionCount )
+        {
+        }
+        void BindKey( int action, sf::Keyboard::Key key )
+        {
+            masks[action].set( KeyCode( key ) );
+        }
+        void BindButton( int action, unsigned int button )
+        {
+            masks[action].set( ButtonCode( button ) );
+        }
+        void BindAxis( int action, sf::Joystick::Axis axis, bool positive )
+        {
+            masks[action].set( AxisCode( axis, positive ) );
+        }
+        const Mask& operator[]( int action ) const
+        {
+            return masks[action];
+        }
+
+    private:
+        std::vector<Mask> masks;
+    };
+
+    class Snapshot
+    {
+    public:
+        bool IsDown( const Mask& mask ) const
+        {
+            return (down & mask).any();
+        }
+        // Went down at least once during the frame
+        bool WasPressed( const Mask& mask ) const
+        {
+            return (pressed & mask).any();
+        }
+        bool WasReleased( const Mask& mask ) const
+        {
+            return (released & mask).any();
+        }
+        // Number of separate presses during the frame, for button mashing
+        int PressCount( const Mask& mask ) const
+        {
+            int count = 0;
+            for( const Event& e : events )
+            {
+                count += e.pressed && mask.test( e.code ) ? 1 : 0;
+            }
+            return count;
+        }
+        bool IsDown( sf::Keyboard::Key key ) const
+        {
+            return key != sf::Keyboard::Key::Unknown && down.test( KeyCode( key ) );
+        }
+        bool WasPressed( sf::Keyboard::Key key ) const
+        {
+            return key != sf::Keyboard::Key::Unknown && pressed.test( KeyCode( key ) );
+        }
+        bool IsJoystickConnected() const
+        {
+            return joystickConnected;
+        }
+        // -100..100, as reported by SFML
+        float GetAxis( sf::Joystick::Axis axis ) const
+        {
+            return axes[static_cast<int>(axis)];
+        }
+        const std::vector<Event>& GetEvents() const
+        {
+            return events;
+        }
+        // Time the frame was closed, on the same clock as event timestamps
+        std::int64_t GetTimeUs() const
+        {
+            return timeUs;
+        }
+
+    private:
+        friend class Input;
+        Mask down;
+        Mask pressed;
+        Mask released;
+        std::array<float, AxisCount> axes = {};
+        bool joystickConnected = false;
+        std::vector<Event> events;
+        std::int64_t timeUs = 0;
+    };
+
+public:
+    Input()
+    {
+        if( sf::Joystick::isConnected( 0 ) )
+        {
+            ConnectJoystick();
+        }
+    }
+    void Feed( const sf::Event& event )
+    {
+        if( const auto* e = event.getIf<sf::Event::KeyPressed>() )
+        {
+            if( e->code != sf::Keyboard::Key::Unknown )
+            {
+                SetCode( KeyCode( e->code ), true );
+            }
+        }
+        else if( const auto* e = event.getIf<sf::Event::KeyReleased>() )
+        {
+            if( e->code != sf::Keyboard::Key::Unknown )
+            {
+                SetCode( KeyCode( e->code ), false );
+            }
+        }
+        else if( const auto* e = event.getIf<sf::Event::JoystickButtonPressed>() )
+        {
+            if( e->joystickId == 0u && e->button < sf::Joystick::ButtonCount )
+            {
+                SetCode( ButtonCode( e->button ), true );
+            }
+        }
+        else if( const auto* e = event.getIf<sf::Event::JoystickButtonReleased>() )
+        {
+            if( e->joystickId == 0u && e->button < sf::Joystick::ButtonCount )
+            {
+                SetCode( ButtonCode( e->button ), false );
+            }
+        }
+        else if( const auto* e = event.getIf<sf::Event::JoystickMoved>() )
+        {
+            if( e->joystickId == 0u )
+            {
+                SetAxis( e->axis, e->position );
+            }
+        }
+        else if( const auto* e = event.getIf<sf::Event::JoystickConnected>() )
+        {
+            if( e->joystickId == 0u )
+            {
+                ConnectJoystick();
+            }
+        }
+        else if( const auto* e = event.getIf<sf::Event::JoystickDisconnected>() )
+        {
+            if( e->joystickId == 0u )
+            {
+                ReleaseAll( KeyCodes );
+                axes = {};
+                joystickConnected = false;
+            }
+        }
+        else if( event.is<sf::Event::FocusLost>() )
+        {
+            // Releases that happen while unfocused never arrive, so let go
+            // of everything now instead of leaving keys stuck down
+            ReleaseAll( 0 );
+        }
+    }
+    // Closes the current frame and returns its snapshot, which stays valid
+    // and unchanged until the next call
+    const Snapshot& NextFrame()
+    {
+        snapshot.down = down;
+        snapshot.pressed = pressedThisFrame;
+        snapshot.released = releasedThisFrame;
+        snapshot.axes = axes;
+        snapshot.joystickConnected = joystickConnected;
+        snapshot.timeUs = clock.getElapsedTime().asMicroseconds();
+        // Swap rather than copy so both queues keep their capacity
+        snapshot.events.swap( pending );
+        pending.clear();
+        pressedThisFrame.reset();
+        releasedThisFrame.reset();
+        return snapshot;
+    }
+    const Snapshot& GetSnapshot() const
+    {
+        return snapshot;
+    }
+    // How far (0..100) an axis must be pushed to count as its AxisCode
+    void SetAxisThreshold( float threshold )
+    {
+        axisThreshold = threshold;
+    }
+
+private:
+    void SetCode( int code, bool isDown )
+    {
+        // Key repeat sends more presses while held; only edges are events
+        if( down.test( code ) == isDown )
+        {
+            return;
+        }
+        down.set( code, isDown );
+        (isDown ? pressedThisFrame : releasedThisFrame).set( code );
+        pending.push_back( { clock.getElapsedTime().asMicroseconds(), static_cast<std::uint16_t>(code), isDown } );
+    }
+    void SetAxis( sf::Joystick::Axis axis, float position )
+    {
+        axes[static_cast<int>(axis)] = position;
+        SetCode( AxisCode( axis, true ), position > axisThreshold );
+        SetCode( AxisCode( axis, false ), position < -axisThreshold );
+    }
+    void ConnectJoystick()
+    {
+        // SFML only reports axis changes, so read where they start from
+        joystickConnected = true;
+        for( int a = 0; a < AxisCount; ++a )
+        {
+            const auto axis = static_cast<sf::Joystick::Axis>(a);
+            SetAxis( axis, sf::Joystick::getAxisPosition( 0, axis ) );
+        }
+    }
+    void ReleaseAll( int firstCode )
+    {
+        for( int code = firstCode; code < CodeCount; ++code )
+        {
+            SetCode( code, false );
+        }
+    }
+
+private:
+    sf::Clock clock;
+    Mask down;
+    Mask pressedThisFrame;
+    Mask releasedThisFrame;
+    std::array<float, AxisCount> axes = {};
+    bool joystickConnected = false;
+    float axisThreshold = 50.0f;
+    std::vector<Event> pending;
+    Snapshot snapshot;
+};
+
+#endif
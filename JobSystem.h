@@ -0,0 +1,391 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Work-stealing job system. Every thread has its own deque of ready jobs:
+// a thread pushes and pops at the back of its own (newest first, while its
+// data is still in cache) and, when that runs dry, steals from the front of
+// the others (oldest first, usually the biggest pieces left). The thread
+// that created the system is worker 0 and only runs jobs while it waits in
+// Wait or ParallelFor, so a system of one thread runs everything inline.
+//
+// A job may name jobs it depends on and is only queued once they have all
+// finished, which lets a frame be submitted as a graph and still run its
+// steps in a fixed order. Jobs are stored in a fixed set of slots, callable
+// and all, so submitting does not allocate once the system has warmed up.
+// Jobs must not throw.
+//
+// SFML (and other main-thread-only) calls go through PostToMainThread and
+// run when the main thread next calls RunMainThreadJobs.
+class JobSystem
+{
+public:
+    // Handle to a submitted job; a default one counts as finished
+    struct Job
+    {
+        int index = -1;
+        std::uint32_t generation = 0u;
+    };
+    // Largest callable Submit stores; capture by reference to stay under
+    static constexpr std::size_t MaxCallableSize = 64u;
+
+public:
+    // threadCount includes the calling thread; 0 uses one per core.
+    // maxJobs is how many jobs can be pending at once; Submit past that
+    // runs queued jobs until a slot frees up.
+    explicit JobSystem( unsigned int threadCount = 0u, int maxJobs = 1024 )
+        : workerCount( threadCount != 0u ? threadCount : std::max( 1u, std::thread::hardware_concurrency() ) ),
+          slotCount( std::max( maxJobs, 1 ) ),
+          slots( new Slot[std::size_t( slotCount )] ),
+          queues( new Queue[workerCount] )
+    {
+        freeSlots.reserve( std::size_t( slotCount ) );
+        for( int i = slotCount - 1; i >= 0; --i )
+        {
+            freeSlots.push_back( i );
+        }
+        for( unsigned int w = 0; w < workerCount; ++w )
+        {
+            // A job sits in at most one deque, so none can overflow
+            queues[w].ring.resize( std::size_t( slotCount ) );
+        }
+        for( unsigned int w = 1; w < workerCount; ++w )
+        {
+            threads.emplace_back( [this, w] { WorkerLoop( w ); } );
+        }
+    }
+    JobSystem( const JobSystem& ) = delete;
+    JobSystem& operator=( const JobSystem& ) = delete;
+    // Runs every job still pending first (helping the workers), so each
+    // submitted callable is called and destroyed exactly once
+    ~JobSystem()
+    {
+        for( ;; )
+        {
+            {
+                std::lock_guard<std::mutex> lock( graphMtx );
+                if( freeSlots.size() == std::size_t( slotCount ) )
+                {
+                    break;
+                }
+            }
+            if( !RunOne( CurrentWorker() ) )
+            {
+                std::this_thread::yield();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock( sleepMtx );
+            quit = true;
+        }
+        wake.notify_all();
+        for( auto& t : threads )
+        {
+            t.join();
+        }
+    }
+    unsigned int GetThreadCount() const
+    {
+        return workerCount;
+    }
+    // Queues fn() to run once every job in dependencies has finished.
+    // Safe to call from any thread, jobs included.
+    template<typename F>
+    Job Submit( F&& fn, std::initializer_list<Job> dependencies = {} )
+    {
+        using Fn = std::decay_t<F>;
+        static_assert( sizeof( Fn ) <= MaxCallableSize && alignof( Fn ) <= alignof( std::max_align_t ),
+            "JobSystem::Submit: callable too big, capture by reference" );
+        const int index = AcquireSlot();
+        Slot& slot = slots[index];
+        new( slot.callable ) Fn( std::forward<F>( fn ) );
+        slot.pRun = []( void* pCallable )
+        {
+            Fn& f = *std::launder( static_cast<Fn*>(pCallable) );
+            f();
+            f.~Fn();
+        };
+        const Job job { index, slot.generation.load( std::memory_order_relaxed ) };
+        bool ready;
+        {
+            std::lock_guard<std::mutex> lock( graphMtx );
+            slot.pendingDependencies = 0;
+            for( const Job& dependency : dependencies )
+            {
+                if( !IsFinishedLocked( dependency ) )
+                {
+                    slots[dependency.index].dependents.push_back( index );
+                    ++slot.pendingDependencies;
+                }
+            }
+            ready = slot.pendingDependencies == 0;
+        }
+        if( ready )
+        {
+            Push( index );
+        }
+        return job;
+    }
+    bool IsFinished( const Job& job ) const
+    {
+        return job.index < 0 || slots[job.index].generation.load( std::memory_order_acquire ) != job.generation;
+    }
+    // Runs other jobs until job has finished
+    void Wait( const Job& job )
+    {
+        const unsigned int self = CurrentWorker();
+        while( !IsFinished( job ) )
+        {
+            if( !RunOne( self ) )
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+    // Calls fn( first, last ) for consecutive ranges of [0, count), each
+    // grain long but the last, and returns when all have finished. The
+    // ranges depend only on count and grain, never on the thread count,
+    // so a loop whose ranges write disjoint data gives the same result
+    // however many threads split it.
+    template<typename F>
+    void ParallelFor( int count, int grain, F&& fn )
+    {
+        if( count <= 0 )
+        {
+            return;
+        }
+        grain = std::max( grain, 1 );
+        const int ranges = (count - 1) / grain + 1;
+        if( threads.empty() || ranges == 1 )
+        {
+            for( int first = 0; first < count; first += std::min( grain, count - first ) )
+            {
+                fn( first, first + std::min( grain, count - first ) );
+            }
+            return;
+        }
+        std::atomic<int> remaining { ranges };
+        for( int r = 0; r < ranges; ++r )
+        {
+            const int first = r * grain;
+            const int last = first + std::min( grain, count - first );
+            Submit( [&fn, &remaining, first, last]
+            {
+                fn( first, last );
+                remaining.fetch_sub( 1, std::memory_order_release );
+            } );
+        }
+        const unsigned int self = CurrentWorker();
+        while( remaining.load( std::memory_order_acquire ) != 0 )
+        {
+            if( !RunOne( self ) )
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+    // Queues fn() for the next RunMainThreadJobs. Safe from any thread;
+    // posted functions run in the order they were posted.
+    void PostToMainThread( std::function<void()> fn )
+    {
+        std::lock_guard<std::mutex> lock( mainMtx );
+        mainJobs.push_back( std::move( fn ) );
+    }
+    // Runs what has been posted so far on the calling thread, which should
+    // be the main thread. Anything posted meanwhile waits for the next call.
+    void RunMainThreadJobs()
+    {
+        {
+            std::lock_guard<std::mutex> lock( mainMtx );
+            mainJobs.swap( mainRunning );
+        }
+        for( auto& fn : mainRunning )
+        {
+            fn();
+        }
+        mainRunning.clear();
+    }
+
+private:
+    struct Slot
+    {
+        alignas( std::max_align_t ) unsigned char callable[MaxCallableSize];
+        void (*pRun)( void* ) = nullptr;
+        // Bumped as the job finishes, which frees the slot; a Job handle
+        // holding the old value then reads as finished
+        std::atomic<std::uint32_t> generation { 0u };
+        // Guarded by graphMtx
+        int pendingDependencies = 0;
+        std::vector<int> dependents;
+    };
+    // One worker's deque of ready slots, a ring indexed by ever-growing
+    // head (front) and tail (back)
+    struct alignas( 64 ) Queue
+    {
+        std::mutex mtx;
+        std::vector<int> ring;
+        std::size_t head = 0u;
+        std::size_t tail = 0u;
+    };
+    struct ThreadWorker
+    {
+        const JobSystem* pOwner = nullptr;
+        unsigned int index = 0u;
+    };
+
+private:
+    static ThreadWorker& ThisThread()
+    {
+        static thread_local ThreadWorker worker;
+        return worker;
+    }
+    // Threads that are not workers of this system share worker 0's deque
+    unsigned int CurrentWorker() const
+    {
+        const ThreadWorker& worker = ThisThread();
+        return worker.pOwner == this ? worker.index : 0u;
+    }
+    bool IsFinishedLocked( const Job& job ) const
+    {
+        return job.index < 0 || slots[job.index].generation.load( std::memory_order_relaxed ) != job.generation;
+    }
+    int AcquireSlot()
+    {
+        for( ;; )
+        {
+            {
+                std::lock_guard<std::mutex> lock( graphMtx );
+                if( !freeSlots.empty() )
+                {
+                    const int index = freeSlots.back();
+                    freeSlots.pop_back();
+                    return index;
+                }
+            }
+            if( !RunOne( CurrentWorker() ) )
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+    void Push( int index )
+    {
+        Queue& q = queues[CurrentWorker()];
+        {
+            std::lock_guard<std::mutex> lock( q.mtx );
+            q.ring[q.tail++ % q.ring.size()] = index;
+        }
+        queued.fetch_add( 1 );
+        // A worker counts itself as sleeping before it checks queued, so
+        // one of the two always sees the other
+        if( sleepers.load() > 0 )
+        {
+            {
+                std::lock_guard<std::mutex> lock( sleepMtx );
+            }
+            wake.notify_one();
+        }
+    }
+    // Newest job of worker's own deque, else the oldest of another's
+    bool Take( unsigned int worker, int& index )
+    {
+        {
+            Queue& q = queues[worker];
+            std::lock_guard<std::mutex> lock( q.mtx );
+            if( q.head != q.tail )
+            {
+                index = q.ring[--q.tail % q.ring.size()];
+                return true;
+            }
+        }
+        for( unsigned int offset = 1; offset < workerCount; ++offset )
+        {
+            Queue& q = queues[(worker + offset) % workerCount];
+            std::lock_guard<std::mutex> lock( q.mtx );
+            if( q.head != q.tail )
+            {
+                index = q.ring[q.head++ % q.ring.size()];
+                return true;
+            }
+        }
+        return false;
+    }
+    bool RunOne( unsigned int worker )
+    {
+        int index;
+        if( !Take( worker, index ) )
+        {
+            return false;
+        }
+        queued.fetch_sub( 1 );
+        Slot& slot = slots[index];
+        slot.pRun( slot.callable );
+        // Release the jobs waiting on this one, then the slot itself
+        std::lock_guard<std::mutex> lock( graphMtx );
+        for( const int dependent : slot.dependents )
+        {
+            if( --slots[dependent].pendingDependencies == 0 )
+            {
+                Push( dependent );
+            }
+        }
+        slot.dependents.clear();
+        slot.generation.fetch_add( 1u, std::memory_order_release );
+        freeSlots.push_back( index );
+        return true;
+    }
+    void WorkerLoop( unsigned int index )
+    {
+        ThisThread() = { this, index };
+        for( ;; )
+        {
+            if( RunOne( index ) )
+            {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock( sleepMtx );
+            sleepers.fetch_add( 1 );
+            wake.wait( lock, [this] { return quit || queued.load() > 0; } );
+            sleepers.fetch_sub( 1 );
+            if( quit )
+            {
+                return;
+            }
+        }
+    }
+
+private:
+    unsigned int workerCount;
+    int slotCount;
+    std::unique_ptr<Slot[]> slots;
+    std::unique_ptr<Queue[]> queues;
+    // Free slots and the dependency edges between slots
+    std::mutex graphMtx;
+    std::vector<int> freeSlots;
+    // Jobs sitting in a deque, and workers asleep waiting for one
+    std::atomic<int> queued { 0 };
+    std::atomic<int> sleepers { 0 };
+    std::mutex sleepMtx;
+    std::condition_variable wake;
+    bool quit = false;
+    std::mutex mainMtx;
+    std::vector<std::function<void()>> mainJobs;
+    std::vector<std::function<void()>> mainRunning;
+    std::vector<std::thread> threads;
+};
+
+#endif
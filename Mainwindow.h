@@ -2,18 +2,67 @@
 #define MAINWINDOW_H
 
 #include <SFML/Graphics.hpp>
+#include "Input.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
 class MainWindow
 {
 public:
-    MainWindow( int width, int height, const char* title );
+    // Headless opens no window and needs no display or GL context: frames
+    // are presented into an in-memory RGBA buffer and events come only from
+    // the script fed through ScriptEvent.
+    enum class Backend
+    {
+        Window,
+        Headless
+    };
+
+public:
+    MainWindow( int width, int height, const char* title, Backend backend = Backend::Window );
     ~MainWindow();
     bool IsOpen() const;
     void Close();
+    bool IsHeadless() const;
+    int GetWidth() const;
+    int GetHeight() const;
+    // Only valid for Backend::Window
     sf::RenderWindow& GetWindow();
+    std::optional<sf::Event> PollEvent();
+    // Queues an event to be returned by PollEvent once `frame` frames have
+    // been presented; works with both backends
+    void ScriptEvent( std::uint64_t frame, const sf::Event& event );
+    std::uint64_t GetFrameIndex() const;
+    // Called by Graphics when it presents: headless copies the rows of the
+    // given rectangle into the readback buffer and Display shows the window.
+    // Both may run on the render thread when Graphics is pipelined, while
+    // FinishFrame, which advances the frame counter, stays on the thread
+    // that polls events.
+    void PresentRect( const std::uint32_t* pSrc, int srcPitch, int x, int y, int w, int h );
+    void Display();
+    void FinishFrame();
+    // Last presented headless frame, width * height RGBA pixels, no padding
+    const std::vector<std::uint32_t>& GetFrame() const;
+    // Writes the last headless frame as a binary PPM, for golden images
+    bool SaveFrame( const std::string& path ) const;
+
+public:
+    // Fed by PollEvent; Game takes a snapshot of it each frame
+    Input input;
     
 private:
-    sf::RenderWindow window;
+    int width;
+    int height;
+    bool open = true;
+    std::optional<sf::RenderWindow> window;
+    // Sorted by frame; events for the same frame keep their queue order
+    std::vector<std::pair<std::uint64_t, sf::Event>> scriptedEvents;
+    std::size_t nextScripted = 0u;
+    std::uint64_t frameIndex = 0u;
+    std::vector<std::uint32_t> headlessFrame;
 };
 
 #endif
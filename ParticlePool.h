@@ -0,0 +1,247 @@
+#ifndef PARTICLEPOOL_H
+#define PARTICLEPOOL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+#include <immintrin.h>
+#endif
+
+// Fixed-capacity particle storage laid out as structure of arrays: x, y,
+// vx, vy and lifetime each live in their own 32-byte aligned array, so
+// Update integrates eight (AVX2) or four (SSE2) particles per instruction.
+// Live particles are packed at the front; a dead one is replaced by the
+// last live one (swap and pop), so the order is not stable but removal is
+// O(1). Everything is allocated in the constructor and nothing after.
+//
+// Emitters share the pool but each has a budget of live particles, so one
+// busy effect cannot starve the others. Spawning past the budget or the
+// pool's capacity is refused rather than evicting older particles.
+class ParticlePool
+{
+public:
+    using Emitter = int;
+    static constexpr int Lanes = 8;
+
+public:
+    explicit ParticlePool( int capacity )
+        : capacity( std::max( capacity, 0 ) ),
+          stride( (std::max( capacity, 0 ) + Lanes - 1) / Lanes * Lanes ),
+          storage( std::size_t( stride ) * 5u + Lanes ),
+          emitterOf( std::size_t( this->capacity ) )
+    {
+        // Every array starts on a 32-byte boundary and is a whole number of
+        // lane groups long, so Update can run full vectors past size
+        float* pBase = storage.data();
+        const std::uintptr_t misalign = reinterpret_cast<std::uintptr_t>(pBase) & 31u;
+        if( misalign != 0u )
+        {
+            pBase += (32u - misalign) / sizeof( float );
+        }
+        px = pBase;
+        py = px + stride;
+        pvx = py + stride;
+        pvy = pvx + stride;
+        pLife = pvy + stride;
+    }
+    ParticlePool( const ParticlePool& ) = delete;
+    ParticlePool& operator=( const ParticlePool& ) = delete;
+    // budget is the most particles this emitter may have alive at once.
+    // Emitters are meant to be added up front; adding one may allocate.
+    Emitter AddEmitter( int budget )
+    {
+        if( emitterBudget.size() > 0xFFFFu )
+        {
+            throw std::length_error( "ParticlePool::AddEmitter: too many emitters" );
+        }
+        emitterBudget.push_back( std::max( budget, 0 ) );
+        emitterLive.push_back( 0 );
+        return static_cast<Emitter>(emitterBudget.size() - 1u);
+    }
+    // False (and nothing spawned) when the emitter is at its budget or the
+    // pool is full. Throws std::out_of_range for an unknown emitter.
+    bool Spawn( Emitter e, float x, float y, float vx, float vy, float lifetime )
+    {
+        if( e < 0 || e >= static_cast<int>(emitterBudget.size()) )
+        {
+            throw std::out_of_range( "ParticlePool::Spawn: unknown emitter" );
+        }
+        if( size >= capacity || emitterLive[e] >= emitterBudget[e] )
+        {
+            return false;
+        }
+        px[size] = x;
+        py[size] = y;
+        pvx[size] = vx;
+        pvy[size] = vy;
+        pLife[size] = lifetime;
+        emitterOf[size] = static_cast<std::uint16_t>(e);
+        ++emitterLive[e];
+        ++size;
+        return true;
+    }
+    // Ages every particle by dt, moves it by its velocity, then scales the
+    // velocity by friction (a per-update factor, 1 for none). Particles
+    // whose lifetime reaches zero are removed.
+    void Update( float dt, float friction )
+    {
+        Integrate( dt, friction, 0, size );
+        RemoveDead();
+    }
+    // Update in two steps, for splitting the first across threads: call
+    // Integrate on ranges that cover [0, GetSize()) once, each starting on
+    // a multiple of Lanes (the ranges may run concurrently), then
+    // RemoveDead once they are all done.
+    void Integrate( float dt, float friction, int first, int last )
+    {
+        // Whole lane groups, spilling into the padding after size
+        int i = std::max( first, 0 );
+        const int count = std::min( (last + Lanes - 1) / Lanes * Lanes, stride );
+#if defined( __AVX2__ )
+        const __m256 vdt = _mm256_set1_ps( dt );
+        const __m256 vf = _mm256_set1_ps( friction );
+        for( ; i < count; i += 8 )
+        {
+            const __m256 vx = _mm256_load_ps( pvx + i );
+            const __m256 vy = _mm256_load_ps( pvy + i );
+            _mm256_store_ps( px + i, _mm256_add_ps( _mm256_load_ps( px + i ), _mm256_mul_ps( vx, vdt ) ) );
+            _mm256_store_ps( py + i, _mm256_add_ps( _mm256_load_ps( py + i ), _mm256_mul_ps( vy, vdt ) ) );
+            _mm256_store_ps( pvx + i, _mm256_mul_ps( vx, vf ) );
+            _mm256_store_ps( pvy + i, _mm256_mul_ps( vy, vf ) );
+            _mm256_store_ps( pLife + i, _mm256_sub_ps( _mm256_load_ps( pLife + i ), vdt ) );
+        }
+#elif defined( __SSE2__ )
+        const __m128 vdt = _mm_set1_ps( dt );
+        const __m128 vf = _mm_set1_ps( friction );
+        for( ; i < count; i += 4 )
+        {
+            const __m128 vx = _mm_load_ps( pvx + i );
+            const __m128 vy = _mm_load_ps( pvy + i );
+            _mm_store_ps( px + i, _mm_add_ps( _mm_load_ps( px + i ), _mm_mul_ps( vx, vdt ) ) );
+            _mm_store_ps( py + i, _mm_add_ps( _mm_load_ps( py + i ), _mm_mul_ps( vy, vdt ) ) );
+            _mm_store_ps( pvx + i, _mm_mul_ps( vx, vf ) );
+            _mm_store_ps( pvy + i, _mm_mul_ps( vy, vf ) );
+            _mm_store_ps( pLife + i, _mm_sub_ps( _mm_load_ps( pLife + i ), vdt ) );
+        }
+#endif
+        // Targets without SSE2 (the compiler vectorizes this for NEON)
+        for( ; i < count; ++i )
+        {
+            px[i] += pvx[i] * dt;
+            py[i] += pvy[i] * dt;
+            pvx[i] *= friction;
+            pvy[i] *= friction;
+            pLife[i] -= dt;
+        }
+    }
+    // Removes the particles whose lifetime has reached zero
+    void RemoveDead()
+    {
+        int i = 0;
+        while( i < size )
+        {
+            // Skip whole groups that are all alive without touching the
+            // other arrays
+#if defined( __AVX2__ )
+            if( i + 8 <= size &&
+                _mm256_movemask_ps( _mm256_cmp_ps( _mm256_loadu_ps( pLife + i ), _mm256_setzero_ps(), _CMP_NGT_UQ ) ) == 0 )
+            {
+                i += 8;
+                continue;
+            }
+#elif defined( __SSE2__ )
+            if( i + 4 <= size &&
+                _mm_movemask_ps( _mm_cmpngt_ps( _mm_loadu_ps( pLife + i ), _mm_setzero_ps() ) ) == 0 )
+            {
+                i += 4;
+                continue;
+            }
+#endif
+            if( pLife[i] > 0.0f )
+            {
+                ++i;
+                continue;
+            }
+            // Pop the last particle into the hole and look at i again,
+            // since the moved one may be dead too
+            --emitterLive[emitterOf[i]];
+            const int last = --size;
+            px[i] = px[last];
+            py[i] = py[last];
+            pvx[i] = pvx[last];
+            pvy[i] = pvy[last];
+            pLife[i] = pLife[last];
+            emitterOf[i] = emitterOf[last];
+        }
+    }
+    // Kills every particle; budgets and emitters are kept
+    void Clear()
+    {
+        size = 0;
+        std::fill( emitterLive.begin(), emitterLive.end(), 0 );
+    }
+    int GetSize() const
+    {
+        return size;
+    }
+    int GetCapacity() const
+    {
+        return capacity;
+    }
+    int GetLiveCount( Emitter e ) const
+    {
+        return emitterLive[e];
+    }
+    int GetBudget( Emitter e ) const
+    {
+        return emitterBudget[e];
+    }
+    void SetBudget( Emitter e, int budget )
+    {
+        emitterBudget[e] = std::max( budget, 0 );
+    }
+    // The live particles are [0, GetSize()) of each array
+    const float* GetX() const
+    {
+        return px;
+    }
+    const float* GetY() const
+    {
+        return py;
+    }
+    const float* GetVelocityX() const
+    {
+        return pvx;
+    }
+    const float* GetVelocityY() const
+    {
+        return pvy;
+    }
+    const float* GetLifetime() const
+    {
+        return pLife;
+    }
+    Emitter GetEmitter( int i ) const
+    {
+        return emitterOf[i];
+    }
+
+private:
+    int capacity;
+    int stride;
+    int size = 0;
+    // Five arrays of stride floats, plus slack to align the first
+    std::vector<float> storage;
+    float* px;
+    float* py;
+    float* pvx;
+    float* pvy;
+    float* pLife;
+    std::vector<std::uint16_t> emitterOf;
+    std::vector<int> emitterBudget;
+    std::vector<int> emitterLive;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Colors.h"
+#include "Graphics.h"
+
+class WorkerPool;
+
+// Full-frame effects on the CPU back buffer, run by Graphics in EndFrame
+// (Graphics::SetPostProcess) or by hand through Apply. The chain is
+//
+//   blur -> bloom -> color grade
+//
+// with each stage optional. Blurs are separable Gaussians in 8.8 fixed
+// point, with SSE2/AVX2 kernels over 4 pixels at a time. The vertical pass
+// works in column strips so the rows under the kernel stay in L1. Bloom
+// takes a thresholded bright pass at half resolution, blurs it and adds it
+// back with bilinear upsampling. The grade is a 3D LUT sampled trilinearly
+// (AVX2 gathers, or SSE2 lerps four pixels wide), or three per-channel
+// curves when the grade is separable, which is exact and needs no gathers.
+// Every stage is split into row bands across a worker pool (with bloom on,
+// each band grades its rows right after adding the glow to them), and all
+// code paths produce identical bytes.
+class PostProcess
+{
+public:
+    // Kernels are cut off at this many pixels either side of the center
+    static constexpr int MaxBlurRadius = 32;
+
+public:
+    // threadCount 0 picks one per hardware thread
+    explicit PostProcess( unsigned int threadCount = 0u );
+    PostProcess( const PostProcess& ) = delete;
+    PostProcess& operator=( const PostProcess& ) = delete;
+    ~PostProcess();
+    // Gaussian blur of the whole frame; sigma 0 turns it off
+    void SetBlur( float sigma );
+    // Pixels with a luma (0..255) above threshold glow: their excess
+    // brightness is blurred by sigma (in frame pixels) and added back,
+    // scaled by intensity (0..4). Intensity 0 turns bloom off.
+    void SetBloom( int threshold, float intensity, float sigma = 8.0f );
+    // grade maps an input color to its graded color; it is sampled on a
+    // lutSize^3 lattice (2..33) once, here, and interpolated per pixel
+    void SetColorGrade( const std::function<Color( Color )>& grade, int lutSize = 17 );
+    void ClearColorGrade();
+    bool IsActive() const;
+    // Runs the chain on src into an internal buffer with src's layout and
+    // returns it; with nothing enabled src itself comes back. The result
+    // stays valid until the next Apply.
+    Graphics::RawSurface Apply( const Graphics::RawSurface& src );
+
+private:
+    using Kernel = std::array<std::uint16_t, 2 * MaxBlurRadius + 1>;
+
+private:
+    static int MakeKernel( float sigma, Kernel& weights );
+    void Blur( const std::uint32_t* pSrc, std::uint32_t* pTemp, std::uint32_t* pDst,
+        int width, int height, int pitch, const Kernel& weights, int radius );
+    void BrightPass( const std::uint32_t* pSrc, int width, int height, int pitch );
+    void AddBloom( const std::uint32_t* pSrc, std::uint32_t* pDst, int width, int height, int pitch );
+    void Grade( const std::uint32_t* pSrc, std::uint32_t* pDst, int width, int height, int pitch );
+    // One row through whichever grade path applies; pDst may be pSrc
+    void GradeLine( std::uint32_t* pDst, const std::uint32_t* pSrc, int width ) const;
+    template<typename F>
+    void ForEachBand( int height, F&& fn );
+
+private:
+    unsigned int threadCount;
+    std::unique_ptr<WorkerPool> pPool;
+    Kernel blurWeights = {};
+    int blurRadius = 0;
+    Kernel bloomWeights = {};
+    int bloomRadius = 0;
+    int bloomThreshold = 255;
+    // Bloom scale in 2.6 fixed point
+    int bloomIntensity = 0;
+    // Trilinear lattice, red fastest; lutCoord packs a channel value's
+    // cell (low half) and 8.8 fraction (high half)
+    std::vector<std::uint32_t> lut;
+    int lutSize = 0;
+    std::array<std::uint32_t, 256> lutCoord = {};
+    // Set when each output channel of the grade depends only on the same
+    // input channel; the grade then runs as these red, green and blue
+    // curves, each 256 entries already shifted to its channel's bits
+    bool separableGrade = false;
+    std::array<std::uint32_t, 3 * 256> gradeCurves = {};
+    std::vector<std::uint32_t> output;
+    std::vector<std::uint32_t> scratch;
+    // Half resolution bright pass and its blur temporary
+    std::vector<std::uint32_t> bright;
+    std::vector<std::uint32_t> brightScratch;
+    // Per band: a bright pass row pair blended vertically, 16 bits per
+    // channel, for the upsample
+    std::vector<std::uint16_t> bloomRows;
+    int brightWidth = 0;
+    int brightHeight = 0;
+};
+
+#endif
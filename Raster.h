@@ -0,0 +1,304 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include "BitmapFont.h"
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+#include <immintrin.h>
+#endif
+
+// Clipped span, rect, line, circle and glyph rasterizers shared by Graphics
+// and FixedGraphics. They are templates over the surface type, so a surface
+// whose pitch and size are compile-time constants gets its address math and
+// clipping folded at compile time.
+namespace Raster
+{
+    // Half-open pixel rectangle that every rasterizer below clips against
+    struct ClipRect
+    {
+        int left;
+        int top;
+        int right;
+        int bottom;
+    };
+
+    inline void FillSpan( std::uint32_t* pDst, int count, std::uint32_t value )
+    {
+#if defined( __AVX2__ )
+        while( count > 0 && (reinterpret_cast<std::uintptr_t>(pDst) & 31u) != 0u )
+        {
+            *pDst++ = value;
+            --count;
+        }
+        const __m256i v = _mm256_set1_epi32( static_cast<int>(value) );
+        for( ; count >= 32; count -= 32, pDst += 32 )
+        {
+            _mm256_store_si256( reinterpret_cast<__m256i*>(pDst), v );
+            _mm256_store_si256( reinterpret_cast<__m256i*>(pDst + 8), v );
+            _mm256_store_si256( reinterpret_cast<__m256i*>(pDst + 16), v );
+            _mm256_store_si256( reinterpret_cast<__m256i*>(pDst + 24), v );
+        }
+        for( ; count >= 8; count -= 8, pDst += 8 )
+        {
+            _mm256_store_si256( reinterpret_cast<__m256i*>(pDst), v );
+        }
+#elif defined( __SSE2__ )
+        while( count > 0 && (reinterpret_cast<std::uintptr_t>(pDst) & 15u) != 0u )
+        {
+            *pDst++ = value;
+            --count;
+        }
+        const __m128i v = _mm_set1_epi32( static_cast<int>(value) );
+        for( ; count >= 16; count -= 16, pDst += 16 )
+        {
+            _mm_store_si128( reinterpret_cast<__m128i*>(pDst), v );
+            _mm_store_si128( reinterpret_cast<__m128i*>(pDst + 4), v );
+            _mm_store_si128( reinterpret_cast<__m128i*>(pDst + 8), v );
+            _mm_store_si128( reinterpret_cast<__m128i*>(pDst + 12), v );
+        }
+        for( ; count >= 4; count -= 4, pDst += 4 )
+        {
+            _mm_store_si128( reinterpret_cast<__m128i*>(pDst), v );
+        }
+#endif
+        // Tail, or the whole span on targets without SSE2 (the compiler
+        // vectorizes this loop for NEON on Apple silicon)
+        for( ; count > 0; --count )
+        {
+            *pDst++ = value;
+        }
+    }
+
+    // Indexed surfaces: memset already uses the widest stores available
+    inline void FillSpan( std::uint8_t* pDst, int count, std::uint32_t value )
+    {
+        std::memset( pDst, static_cast<int>(value), std::size_t( count ) );
+    }
+
+    // The rasterizers below take any surface with pixels, pitch, width and
+    // height members: Graphics::RawSurface, Graphics::RawIndexSurface or
+    // FixedGraphics' compile-time surfaces. c is a packed color or a
+    // palette index to match.
+    template<typename S>
+    using PixelOf = std::remove_pointer_t<decltype( S::pixels )>;
+
+    template<typename S>
+    void RasterSpan( const S& s, const ClipRect& clip, int x0, int x1, int y, std::uint32_t c )
+    {
+        if( y < clip.top || y >= clip.bottom )
+        {
+            return;
+        }
+        if( x0 > x1 )
+        {
+            std::swap( x0, x1 );
+        }
+        x0 = std::max( x0, clip.left );
+        x1 = std::min( x1, clip.right - 1 );
+        if( x0 <= x1 )
+        {
+            FillSpan( s.pixels + y * s.pitch + x0, x1 - x0 + 1, c );
+        }
+    }
+
+    template<typename S>
+    void RasterRect( const S& s, const ClipRect& clip, int x, int y, int width, int height, std::uint32_t c )
+    {
+        const int left = std::max( x, clip.left );
+        const int top = std::max( y, clip.top );
+        const int right = std::min( x + width, clip.right );
+        const int bottom = std::min( y + height, clip.bottom );
+        if( left >= right || top >= bottom )
+        {
+            return;
+        }
+        PixelOf<S>* pRow = s.pixels + top * s.pitch + left;
+        for( int py = top; py < bottom; ++py, pRow += s.pitch )
+        {
+            FillSpan( pRow, right - left, c );
+        }
+    }
+
+    template<typename S>
+    void RasterLine( const S& s, const ClipRect& clip, int x0, int y0, int x1, int y1, std::uint32_t c )
+    {
+        if( y0 == y1 )
+        {
+            RasterSpan( s, clip, x0, x1, y0, c );
+            return;
+        }
+        if( std::max( x0, x1 ) < clip.left || std::min( x0, x1 ) >= clip.right ||
+            std::max( y0, y1 ) < clip.top || std::min( y0, y1 ) >= clip.bottom )
+        {
+            return;
+        }
+        // Plain Bresenham with a per-pixel clip test, so a line crossing a
+        // clip edge lights exactly the pixels the unclipped line would
+        const int dx = std::abs( x1 - x0 );
+        const int dy = -std::abs( y1 - y0 );
+        const int sx = x0 < x1 ? 1 : -1;
+        const int sy = y0 < y1 ? 1 : -1;
+        int err = dx + dy;
+        for( ;; )
+        {
+            if( x0 >= clip.left && x0 < clip.right && y0 >= clip.top && y0 < clip.bottom )
+            {
+                s.pixels[y0 * s.pitch + x0] = static_cast<PixelOf<S>>(c);
+            }
+            if( x0 == x1 && y0 == y1 )
+            {
+                break;
+            }
+            // Both coordinates move monotonically, so once either has left
+            // the clip rect on the far side nothing more can land inside
+            if( (sx > 0 ? x0 >= clip.right : x0 < clip.left) || (sy > 0 ? y0 >= clip.bottom : y0 < clip.top) )
+            {
+                break;
+            }
+            const int e2 = 2 * err;
+            if( e2 >= dy )
+            {
+                err += dy;
+                x0 += sx;
+            }
+            if( e2 <= dx )
+            {
+                err += dx;
+                y0 += sy;
+            }
+        }
+    }
+
+    template<typename S>
+    void RasterCircle( const S& s, const ClipRect& clip, int cx, int cy, int radius, std::uint32_t c )
+    {
+        if( radius < 0 || cx + radius < clip.left || cx - radius >= clip.right ||
+            cy + radius < clip.top || cy - radius >= clip.bottom )
+        {
+            return;
+        }
+        auto plot = [&]( int px, int py )
+        {
+            if( px >= clip.left && px < clip.right && py >= clip.top && py < clip.bottom )
+            {
+                s.pixels[py * s.pitch + px] = static_cast<PixelOf<S>>(c);
+            }
+        };
+        // Midpoint circle, one octant mirrored eight ways
+        int x = radius;
+        int y = 0;
+        int err = 1 - radius;
+        while( x >= y )
+        {
+            plot( cx + x, cy + y );
+            plot( cx - x, cy + y );
+            plot( cx + x, cy - y );
+            plot( cx - x, cy - y );
+            plot( cx + y, cy + x );
+            plot( cx - y, cy + x );
+            plot( cx + y, cy - x );
+            plot( cx - y, cy - x );
+            ++y;
+            if( err < 0 )
+            {
+                err += 2 * y + 1;
+            }
+            else
+            {
+                --x;
+                err += 2 * (y - x) + 1;
+            }
+        }
+    }
+
+    template<typename S>
+    void RasterFilledCircle( const S& s, const ClipRect& clip, int cx, int cy, int radius, std::uint32_t c )
+    {
+        if( radius < 0 || cx + radius < clip.left || cx - radius >= clip.right ||
+            cy + radius < clip.top || cy - radius >= clip.bottom )
+        {
+            return;
+        }
+        // Half-width per row shrinks monotonically, so walk it down instead
+        // of taking a square root for every span
+        const int limit = radius * radius + radius;
+        int halfWidth = radius;
+        for( int dy = 0; dy <= radius; ++dy )
+        {
+            while( halfWidth * halfWidth + dy * dy > limit )
+            {
+                --halfWidth;
+            }
+            RasterSpan( s, clip, cx - halfWidth, cx + halfWidth, cy + dy, c );
+            if( dy != 0 )
+            {
+                RasterSpan( s, clip, cx - halfWidth, cx + halfWidth, cy - dy, c );
+            }
+        }
+    }
+
+    // Each set bit of a glyph becomes a scale x scale block, and a run of
+    // set bits in a glyph row goes out as a single rect
+    template<typename S>
+    void RasterGlyph( const S& s, const ClipRect& clip, int x, int y, const std::uint8_t* pRows, int scale, std::uint32_t c )
+    {
+        for( int row = 0; row < BitmapFont::GlyphSize; ++row )
+        {
+            const unsigned int bits = pRows[row];
+            int col = 0;
+            while( col < BitmapFont::GlyphSize )
+            {
+                if( (bits >> col & 1u) == 0u )
+                {
+                    ++col;
+                    continue;
+                }
+                const int start = col;
+                while( col < BitmapFont::GlyphSize && (bits >> col & 1u) != 0u )
+                {
+                    ++col;
+                }
+                RasterRect( s, clip, x + start * scale, y + row * scale, (col - start) * scale, scale, c );
+            }
+        }
+    }
+
+    // Splits a line into one conservative rectangle per band of bandSize
+    // rows (a row of tiles), used both to mark dirty tiles and to bin lines
+    // without covering their whole bounding box. On shallow lines one
+    // scanline covers a run of dx / dy pixels, which sets the horizontal
+    // slack.
+    template<typename F>
+    void ForEachLineBand( int x0, int y0, int x1, int y1, int height, int bandSize, F&& fn )
+    {
+        if( y0 > y1 )
+        {
+            std::swap( x0, x1 );
+            std::swap( y0, y1 );
+        }
+        const int slack = (y1 != y0 ? std::abs( x1 - x0 ) / (2 * (y1 - y0)) : 0) + 1;
+        const int top = std::max( y0, 0 );
+        const int bottom = std::min( y1, height - 1 );
+        for( int bandTop = top; bandTop <= bottom; bandTop = (bandTop / bandSize + 1) * bandSize )
+        {
+            const int bandBottom = std::min( (bandTop / bandSize + 1) * bandSize - 1, bottom );
+            int xa = x0;
+            int xb = x1;
+            if( y1 != y0 )
+            {
+                xa = x0 + static_cast<int>(static_cast<long long>(x1 - x0) * (bandTop - y0) / (y1 - y0));
+                xb = x0 + static_cast<int>(static_cast<long long>(x1 - x0) * (bandBottom - y0) / (y1 - y0));
+            }
+            const int left = std::min( xa, xb ) - slack;
+            const int right = std::max( xa, xb ) + slack;
+            fn( left, bandTop, right - left + 1, bandBottom - bandTop + 1 );
+        }
+    }
+}
+
+#endif
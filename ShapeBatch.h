@@ -0,0 +1,314 @@
+#ifndef SHAPEBATCH_H
+#define SHAPEBATCH_H
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Rectangles, circles, lines and textured quads for SFML render targets,
+// gathered into one vertex buffer and drawn with one draw call per run of
+// render state instead of one per shape. A state is a texture plus a blend
+// mode (SetState); a primitive takes the state and layer current when it
+// is added.
+//
+// Drawing orders the primitives by layer, then by the order their state
+// was first used (the default untextured state counting as first), with a
+// stable radix sort; primitives sharing a layer and a state keep the order
+// they were added in. So a batch that sticks to one state is drawn exactly
+// in submission order with a single call, and shapes that must cover
+// others under a different state go on a higher layer. Clear keeps every
+// buffer, so a batch rebuilt each frame stops allocating once it has seen
+// its largest frame.
+class ShapeBatch : public sf::Drawable
+{
+public:
+    // Segments used for every circle, as for sf::CircleShape's default
+    explicit ShapeBatch( int circleSegments = 30 )
+    {
+        // Unit circle computed once; AddCircle scales and offsets it
+        const int segments = std::max( circleSegments, 3 );
+        unitCircle.reserve( std::size_t( segments ) + 1u );
+        for( int i = 0; i <= segments; ++i )
+        {
+            const float angle = 6.28318531f * static_cast<float>(i % segments) / static_cast<float>(segments);
+            unitCircle.push_back( { std::cos( angle ), std::sin( angle ) } );
+        }
+        Clear();
+    }
+    // Drops every primitive; the state and layer go back to untextured
+    // alpha blending on layer 0
+    void Clear()
+    {
+        vertices.clear();
+        items.clear();
+        states.clear();
+        states.push_back( { nullptr, sf::BlendAlpha } );
+        state = 0u;
+        layer = 0u;
+        sorted = false;
+    }
+    // Texture (nullptr for none) and blend mode for the primitives added
+    // after this call
+    void SetState( const sf::Texture* pTexture, const sf::BlendMode& blend = sf::BlendAlpha )
+    {
+        for( std::size_t i = 0; i < states.size(); ++i )
+        {
+            if( states[i].pTexture == pTexture && states[i].blend == blend )
+            {
+                state = static_cast<std::uint32_t>(i);
+                return;
+            }
+        }
+        state = static_cast<std::uint32_t>(states.size() & 0xFFFFu);
+        states.push_back( { pTexture, blend } );
+    }
+    // Primitives on higher layers are drawn over lower ones (0 to 65535)
+    void SetLayer( int newLayer )
+    {
+        layer = static_cast<std::uint32_t>(std::clamp( newLayer, 0, 0xFFFF ));
+    }
+    // Axis-aligned rectangle, as sf::RectangleShape with the top-left at pos
+    void AddRect( sf::Vector2f pos, sf::Vector2f size, sf::Color color )
+    {
+        const std::size_t first = Append( 6u );
+        WriteQuad( &vertices[first], pos, { pos.x + size.x, pos.y }, { pos.x, pos.y + size.y },
+            { pos.x + size.x, pos.y + size.y }, color );
+        End( first );
+    }
+    // Rectangle whose origin (in its own coordinates) sits at pos, turned
+    // by degrees clockwise about it, as a rotated sf::RectangleShape
+    void AddRect( sf::Vector2f pos, sf::Vector2f size, sf::Vector2f origin, float degrees, sf::Color color )
+    {
+        const float radians = degrees * 0.0174532925f;
+        const float c = std::cos( radians );
+        const float s = std::sin( radians );
+        const auto corner = [&]( float x, float y ) -> sf::Vector2f
+        {
+            x -= origin.x;
+            y -= origin.y;
+            return { pos.x + x * c - y * s, pos.y + x * s + y * c };
+        };
+        const std::size_t first = Append( 6u );
+        WriteQuad( &vertices[first], corner( 0.0f, 0.0f ), corner( size.x, 0.0f ), corner( 0.0f, size.y ),
+            corner( size.x, size.y ), color );
+        End( first );
+    }
+    // Quad with its own texture coordinates and colors, corners in order
+    // around the edge
+    void AddQuad( const sf::Vertex& v0, const sf::Vertex& v1, const sf::Vertex& v2, const sf::Vertex& v3 )
+    {
+        const std::size_t first = Append( 6u );
+        sf::Vertex* pOut = &vertices[first];
+        pOut[0] = v0;
+        pOut[1] = v1;
+        pOut[2] = v2;
+        pOut[3] = v0;
+        pOut[4] = v2;
+        pOut[5] = v3;
+        End( first );
+    }
+    // Filled circle around center
+    void AddCircle( sf::Vector2f center, float radius, sf::Color color )
+    {
+        const std::size_t segments = unitCircle.size() - 1u;
+        const std::size_t first = Append( segments * 3u );
+        sf::Vertex* pOut = &vertices[first];
+        sf::Vector2f prev{ center.x + unitCircle[0].x * radius, center.y + unitCircle[0].y * radius };
+        for( std::size_t i = 1; i <= segments; ++i, pOut += 3 )
+        {
+            const sf::Vector2f next{ center.x + unitCircle[i].x * radius, center.y + unitCircle[i].y * radius };
+            pOut[0] = { center, color, {} };
+            pOut[1] = { prev, color, {} };
+            pOut[2] = { next, color, {} };
+            prev = next;
+        }
+        End( first );
+    }
+    // Line from a to b drawn as a thin quad, so it batches with the
+    // triangles instead of needing a draw call of its own
+    void AddLine( sf::Vector2f a, sf::Vector2f b, sf::Color color, float thickness = 1.0f )
+    {
+        const sf::Vector2f d = b - a;
+        const float length = std::sqrt( d.x * d.x + d.y * d.y );
+        if( length <= 0.0f )
+        {
+            return;
+        }
+        const float half = thickness * 0.5f / length;
+        const sf::Vector2f n{ -d.y * half, d.x * half };
+        const std::size_t first = Append( 6u );
+        WriteQuad( &vertices[first], a + n, b + n, a - n, b - n, color );
+        End( first );
+    }
+    // Sorts the primitives into draw order. Drawing does this when the
+    // batch changed; calling it first moves the work out of the draw.
+    void Sort() const
+    {
+        if( sorted )
+        {
+            return;
+        }
+        sorted = true;
+        runs.clear();
+        if( items.empty() )
+        {
+            return;
+        }
+        RadixSortItems();
+        // Merge neighbouring items of one state into runs. While the sorted
+        // items are still in submission order the runs point straight into
+        // vertices; otherwise the vertices are gathered into draw order.
+        std::size_t next = 0u;
+        inOrder = true;
+        for( const Item& item : items )
+        {
+            inOrder = inOrder && item.first == next;
+            next += item.count;
+        }
+        drawVertices.clear();
+        for( const Item& item : items )
+        {
+            const std::uint32_t itemState = item.key & 0xFFFFu;
+            const std::size_t first = inOrder ? item.first : drawVertices.size();
+            if( runs.empty() || runs.back().state != itemState )
+            {
+                runs.push_back( { itemState, first, 0u } );
+            }
+            if( !inOrder )
+            {
+                drawVertices.insert( drawVertices.end(), vertices.begin() + std::ptrdiff_t( item.first ),
+                    vertices.begin() + std::ptrdiff_t( item.first + item.count ) );
+            }
+            runs.back().count += item.count;
+        }
+    }
+    // Draw calls the batch makes
+    std::size_t GetRunCount() const
+    {
+        Sort();
+        return runs.size();
+    }
+    std::size_t GetVertexCount() const
+    {
+        return vertices.size();
+    }
+
+private:
+    struct State
+    {
+        const sf::Texture* pTexture;
+        sf::BlendMode blend;
+    };
+    // A primitive (or several added back to back under one layer and
+    // state), as a range of vertices and its sort key: layer in the high
+    // 16 bits, state index in the low 16
+    struct Item
+    {
+        std::uint32_t key;
+        std::size_t first;
+        std::size_t count;
+    };
+    struct Run
+    {
+        std::uint32_t state;
+        std::size_t first;
+        std::size_t count;
+    };
+
+private:
+    // Grows vertices by count and returns the index of the first new one
+    std::size_t Append( std::size_t count )
+    {
+        const std::size_t first = vertices.size();
+        vertices.resize( first + count );
+        return first;
+    }
+    // Two triangles covering the four corners of a quad
+    static void WriteQuad( sf::Vertex* pOut, sf::Vector2f topLeft, sf::Vector2f topRight, sf::Vector2f bottomLeft,
+        sf::Vector2f bottomRight, sf::Color color )
+    {
+        pOut[0] = { topLeft, color, {} };
+        pOut[1] = { topRight, color, {} };
+        pOut[2] = { bottomLeft, color, {} };
+        pOut[3] = { bottomLeft, color, {} };
+        pOut[4] = { topRight, color, {} };
+        pOut[5] = { bottomRight, color, {} };
+    }
+    void End( std::size_t first )
+    {
+        const std::uint32_t key = layer << 16 | state;
+        // Extend the previous item when nothing about the state changed,
+        // which keeps items few for the common single-state batch
+        if( !items.empty() && items.back().key == key && items.back().first + items.back().count == first )
+        {
+            items.back().count += vertices.size() - first;
+        }
+        else
+        {
+            items.push_back( { key, first, vertices.size() - first } );
+        }
+        sorted = false;
+    }
+    // Stable LSD radix sort of items by key, eight bits per pass; passes
+    // where every key has the same byte are skipped, so one layer and a
+    // handful of states cost a single pass
+    void RadixSortItems() const
+    {
+        scratch.resize( items.size() );
+        for( int shift = 0; shift < 32; shift += 8 )
+        {
+            std::size_t counts[257] = {};
+            for( const Item& item : items )
+            {
+                ++counts[(item.key >> shift & 0xFFu) + 1u];
+            }
+            if( counts[(items.front().key >> shift & 0xFFu) + 1u] == items.size() )
+            {
+                continue;
+            }
+            for( int i = 1; i < 257; ++i )
+            {
+                counts[i] += counts[i - 1];
+            }
+            for( const Item& item : items )
+            {
+                scratch[counts[item.key >> shift & 0xFFu]++] = item;
+            }
+            items.swap( scratch );
+        }
+    }
+    void draw( sf::RenderTarget& target, sf::RenderStates renderStates ) const override
+    {
+        Sort();
+        const sf::Vertex* pVertices = inOrder ? vertices.data() : drawVertices.data();
+        for( const Run& run : runs )
+        {
+            renderStates.texture = states[run.state].pTexture;
+            renderStates.blendMode = states[run.state].blend;
+            target.draw( pVertices + run.first, run.count, sf::PrimitiveType::Triangles, renderStates );
+        }
+    }
+
+private:
+    std::vector<sf::Vector2f> unitCircle;
+    // Vertices in the order they were added
+    std::vector<sf::Vertex> vertices;
+    std::vector<State> states;
+    std::uint32_t state = 0u;
+    std::uint32_t layer = 0u;
+    // Sorting only reorders this bookkeeping, not what the batch draws, so
+    // it may happen inside the const draw. items is in submission order
+    // until sorted; inOrder says the sort left it that way.
+    mutable std::vector<Item> items;
+    mutable std::vector<Item> scratch;
+    mutable bool sorted = false;
+    mutable bool inOrder = true;
+    // Built by Sort: vertices in draw order when they had to move, and one
+    // run per draw call
+    mutable std::vector<sf::Vertex> drawVertices;
+    mutable std::vector<Run> runs;
+};
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Broadphase for many circles: a uniform grid of square cells, hashed into
+// a fixed number of buckets so the plane is unbounded and the table never
+// grows. Build re-buckets every circle from scratch with a counting sort
+// (meant to run once per tick after things moved), and Query only looks at
+// the cells a query circle can reach, so its cost follows how crowded that
+// neighbourhood is rather than how many circles there are.
+//
+// Circles are bucketed by center alone; Query widens its search by the
+// largest radius seen in Build so that big circles are still found. Cells
+// around the size of a typical query keep the candidate lists short.
+class SpatialHash
+{
+public:
+    struct Circle
+    {
+        float x;
+        float y;
+        float radius;
+    };
+
+public:
+    // bucketCount is rounded up to a power of two
+    explicit SpatialHash( float cellSize, int bucketCount = 4096 )
+        : cellSize( cellSize ),
+          invCellSize( 1.0f / cellSize )
+    {
+        int buckets = 1;
+        while( buckets < bucketCount )
+        {
+            buckets *= 2;
+        }
+        bucketStart.resize( std::size_t( buckets ) + 1u );
+    }
+    // Replaces the contents with count circles, circleOf( i ) giving the
+    // i-th as a Circle. Storage grows to the largest count seen and is then
+    // reused.
+    template<typename CircleFn>
+    void Build( int count, CircleFn circleOf )
+    {
+        const std::size_t n = std::size_t( std::max( count, 0 ) );
+        staged.resize( n );
+        entries.resize( n );
+        std::fill( bucketStart.begin(), bucketStart.end(), 0 );
+        maxRadius = 0.0f;
+        for( std::size_t i = 0; i < n; ++i )
+        {
+            const Circle c = circleOf( static_cast<int>(i) );
+            Entry& e = staged[i];
+            e.x = c.x;
+            e.y = c.y;
+            e.radius = c.radius;
+            e.cellX = CellOf( c.x );
+            e.cellY = CellOf( c.y );
+            e.index = static_cast<int>(i);
+            maxRadius = std::max( maxRadius, c.radius );
+            ++bucketStart[BucketOf( e.cellX, e.cellY ) + 1u];
+        }
+        for( std::size_t b = 1; b < bucketStart.size(); ++b )
+        {
+            bucketStart[b] += bucketStart[b - 1];
+        }
+        // Scatter, leaving each bucket's entries contiguous and in index
+        // order; bucketStart ends up shifted down one bucket and is put
+        // back after
+        for( const Entry& e : staged )
+        {
+            entries[bucketStart[BucketOf( e.cellX, e.cellY )]++] = e;
+        }
+        for( std::size_t b = bucketStart.size() - 1u; b > 0; --b )
+        {
+            bucketStart[b] = bucketStart[b - 1];
+        }
+        bucketStart[0] = 0;
+    }
+    // Calls fn( index ) for every circle that overlaps the circle at (x, y)
+    // with the given radius, that is whose center is closer than the sum of
+    // the radii. Distances are compared squared. Each circle is reported
+    // at most once, in no particular order.
+    template<typename Fn>
+    void Query( float x, float y, float radius, Fn&& fn ) const
+    {
+        if( entries.empty() )
+        {
+            return;
+        }
+        const float reach = radius + maxRadius;
+        const int left = CellOf( x - reach );
+        const int right = CellOf( x + reach );
+        const int top = CellOf( y - reach );
+        const int bottom = CellOf( y + reach );
+        const std::int64_t cells = (std::int64_t( right ) - left + 1) * (std::int64_t( bottom ) - top + 1);
+        if( cells >= std::int64_t( bucketStart.size() - 1u ) )
+        {
+            // The search covers more cells than there are buckets: every
+            // bucket would be visited anyway, so test everything once
+            for( const Entry& e : entries )
+            {
+                Test( e, x, y, radius, fn );
+            }
+            return;
+        }
+        for( int cy = top; cy <= bottom; ++cy )
+        {
+            for( int cx = left; cx <= right; ++cx )
+            {
+                const std::uint32_t b = BucketOf( cx, cy );
+                for( int i = bucketStart[b]; i < bucketStart[b + 1u]; ++i )
+                {
+                    // Other cells hashed into this bucket are skipped, so
+                    // a circle is only seen from its own cell
+                    const Entry& e = entries[i];
+                    if( e.cellX == cx && e.cellY == cy )
+                    {
+                        Test( e, x, y, radius, fn );
+                    }
+                }
+            }
+        }
+    }
+    int GetSize() const
+    {
+        return static_cast<int>(entries.size());
+    }
+    float GetCellSize() const
+    {
+        return cellSize;
+    }
+
+private:
+    struct Entry
+    {
+        float x;
+        float y;
+        float radius;
+        int cellX;
+        int cellY;
+        int index;
+    };
+
+private:
+    int CellOf( float v ) const
+    {
+        // Clamped so far-off or non-finite coordinates still land in a cell
+        const float cell = std::floor( v * invCellSize );
+        if( !(cell > -1.0e9f) )
+        {
+            return -1000000000;
+        }
+        return cell < 1.0e9f ? static_cast<int>(cell) : 1000000000;
+    }
+    std::uint32_t BucketOf( int cx, int cy ) const
+    {
+        const std::uint32_t h = static_cast<std::uint32_t>(cx) * 73856093u ^ static_cast<std::uint32_t>(cy) * 19349663u;
+        return h & static_cast<std::uint32_t>(bucketStart.size() - 2u);
+    }
+    template<typename Fn>
+    static void Test( const Entry& e, float x, float y, float radius, Fn& fn )
+    {
+        const float dx = e.x - x;
+        const float dy = e.y - y;
+        const float r = e.radius + radius;
+        if( dx * dx + dy * dy < r * r )
+        {
+            fn( e.index );
+        }
+    }
+
+private:
+    float cellSize;
+    float invCellSize;
+    float maxRadius = 0.0f;
+    // Counting-sort output: entries of bucket b are
+    // [bucketStart[b], bucketStart[b + 1])
+    std::vector<int> bucketStart;
+    std::vector<Entry> entries;
+    std::vector<Entry> staged;
+};
+
+#endif
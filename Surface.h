@@ -0,0 +1,44 @@
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <string>
+#include "Colors.h"
+
+// CPU-side image that Graphics can blit from. Pixels are stored with
+// premultiplied alpha, and every row starts on a 64-byte boundary so the
+// blit kernels can stream whole cache lines.
+class Surface
+{
+public:
+    Surface( int width, int height );
+    // Decodes a PNG/JPEG/... through stb_image; throws std::runtime_error
+    // if the file cannot be read.
+    explicit Surface( const std::string& filename );
+    Surface( const Surface& rhs );
+    Surface( Surface&& donor ) noexcept;
+    Surface& operator=( const Surface& rhs );
+    Surface& operator=( Surface&& rhs ) noexcept;
+    ~Surface();
+    // Colors passed in and out are premultiplied
+    void PutPixel( int x, int y, Color c );
+    Color GetPixel( int x, int y ) const;
+    void Fill( Color c );
+    int GetWidth() const;
+    int GetHeight() const;
+    // Row stride in pixels
+    int GetPitch() const;
+    const Color* Data() const;
+    Color* Data();
+
+private:
+    void Allocate( int w, int h );
+    void Release();
+
+private:
+    Color* pPixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int pitch = 0;
+};
+
+#endif
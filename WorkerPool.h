@@ -0,0 +1,122 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of threads that split an index range between them. The thread
+// calling ParallelFor takes part too, so a pool of one runs everything
+// inline without ever touching a lock.
+class WorkerPool
+{
+public:
+    explicit WorkerPool( unsigned int threadCount )
+    {
+        for( unsigned int i = 1; i < threadCount; ++i )
+        {
+            threads.emplace_back( [this] { WorkerLoop(); } );
+        }
+    }
+    WorkerPool( const WorkerPool& ) = delete;
+    WorkerPool& operator=( const WorkerPool& ) = delete;
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock( mtx );
+            quit = true;
+        }
+        wake.notify_all();
+        for( auto& t : threads )
+        {
+            t.join();
+        }
+    }
+    unsigned int GetThreadCount() const
+    {
+        return static_cast<unsigned int>(threads.size()) + 1u;
+    }
+    // Calls fn( i ) once for every i in [0, count) and returns when all
+    // calls have finished. Indices are handed out dynamically, so fn must
+    // not depend on which thread runs it or in what order.
+    template<typename F>
+    void ParallelFor( int count, F&& fn )
+    {
+        if( count <= 0 )
+        {
+            return;
+        }
+        if( threads.empty() || count == 1 )
+        {
+            for( int i = 0; i < count; ++i )
+            {
+                fn( i );
+            }
+            return;
+        }
+        using Fn = std::remove_reference_t<F>;
+        {
+            std::lock_guard<std::mutex> lock( mtx );
+            pJobContext = const_cast<void*>(static_cast<const void*>(&fn));
+            pJobInvoke = []( void* pCtx, int i ) { (*static_cast<Fn*>(pCtx))( i ); };
+            jobCount = count;
+            nextIndex.store( 0, std::memory_order_relaxed );
+            busyWorkers = static_cast<int>(threads.size());
+            ++generation;
+        }
+        wake.notify_all();
+        RunIndices();
+        std::unique_lock<std::mutex> lock( mtx );
+        done.wait( lock, [this] { return busyWorkers == 0; } );
+    }
+
+private:
+    void RunIndices()
+    {
+        for( int i = nextIndex.fetch_add( 1, std::memory_order_relaxed ); i < jobCount;
+             i = nextIndex.fetch_add( 1, std::memory_order_relaxed ) )
+        {
+            pJobInvoke( pJobContext, i );
+        }
+    }
+    void WorkerLoop()
+    {
+        unsigned long long seenGeneration = 0u;
+        for( ;; )
+        {
+            {
+                std::unique_lock<std::mutex> lock( mtx );
+                wake.wait( lock, [&] { return quit || generation != seenGeneration; } );
+                if( quit )
+                {
+                    return;
+                }
+                seenGeneration = generation;
+            }
+            RunIndices();
+            {
+                std::lock_guard<std::mutex> lock( mtx );
+                --busyWorkers;
+            }
+            done.notify_one();
+        }
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned long long generation = 0u;
+    int busyWorkers = 0;
+    bool quit = false;
+    void* pJobContext = nullptr;
+    void (*pJobInvoke)( void*, int ) = nullptr;
+    int jobCount = 0;
+    std::atomic<int> nextIndex { 0 };
+};
+
+#endif
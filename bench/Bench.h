@@ -0,0 +1,45 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Minimal benchmark harness. Each benchmark registers a function that does
+// one repetition of work on `itemsPerRep` items; the runner warms it up,
+// times a number of repetitions and prints one JSON object per benchmark:
+//
+//   {"name":"...","reps":N,"items_per_rep":K,"min_ns":..,"median_ns":..,
+//    "p99_ns":..,"median_ns_per_item":..,"simd":"avx2|sse2|scalar"}
+//
+// simd is the widest vector path the build compiled in (see SIMD in the
+// Makefile), which is the one the SIMD kernels ran.
+namespace bench
+{
+    using BenchFn = std::function<void()>;
+
+    struct Registrar
+    {
+        Registrar( const std::string& name, std::int64_t itemsPerRep, BenchFn fn );
+    };
+
+    // Keeps the optimizer from discarding results the benchmark computed
+    template<typename T>
+    inline void DoNotOptimize( const T& value )
+    {
+#if defined( __GNUC__ )
+        asm volatile( "" : : "g"( &value ) : "memory" );
+#else
+        volatile const T* p = &value;
+        (void)p;
+#endif
+    }
+}
+
+#define BENCH_CONCAT_INNER( a, b ) a##b
+#define BENCH_CONCAT( a, b ) BENCH_CONCAT_INNER( a, b )
+// Variadic so that commas inside the lambda body need no extra parentheses
+#define BENCHMARK( name, itemsPerRep, ... ) \
+    static ::bench::Registrar BENCH_CONCAT( benchRegistrar, __LINE__ )( name, itemsPerRep, __VA_ARGS__ )
+
+#endif
@@ -0,0 +1,72 @@
+#include "Bench.h"
+// See BenchHarpoon.cpp for why the headers are included up front
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <optional>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "../ShapeBatch.h"
+
+namespace adventure
+{
+#define main adventure_main
+#include "../Adventure.cpp"
+#undef main
+}
+
+namespace
+{
+    constexpr int Steps = 10000;
+
+    // The centre room of the real map: border walls with four doors, the
+    // open box and the pillar
+    adventure::Room MakeCentreRoom()
+    {
+        adventure::Room r;
+        r.exits = { 3, 5, 1, 7 };
+        adventure::addBorderWallsWithDoors( r, { 320u, 210u } );
+        r.walls.push_back( sf::FloatRect( { 70.f, 60.f }, { 180.f, 10.f } ) );
+        r.walls.push_back( sf::FloatRect( { 70.f, 140.f }, { 77.f, 10.f } ) );
+        r.walls.push_back( sf::FloatRect( { 173.f, 140.f }, { 77.f, 10.f } ) );
+        r.walls.push_back( sf::FloatRect( { 70.f, 60.f }, { 10.f, 90.f } ) );
+        r.walls.push_back( sf::FloatRect( { 240.f, 60.f }, { 10.f, 90.f } ) );
+        r.walls.push_back( sf::FloatRect( { 150.f, 95.f }, { 20.f, 20.f } ) );
+        return r;
+    }
+
+    const adventure::Room& CentreRoom()
+    {
+        static const adventure::Room room = MakeCentreRoom();
+        return room;
+    }
+}
+
+BENCHMARK( "adventure/hits_wall", Steps, []
+{
+    const adventure::Room& room = CentreRoom();
+    int hits = 0;
+    for( int i = 0; i < Steps; ++i )
+    {
+        const float x = static_cast<float>(i % 310);
+        const float y = static_cast<float>((i / 310) * 7 % 200);
+        hits += adventure::hitsWall( sf::FloatRect( { x, y }, { 10.f, 10.f } ), room ) ? 1 : 0;
+    }
+    bench::DoNotOptimize( hits );
+} );
+
+// The player zig-zags around the room bumping into walls, as when the
+// arrow keys are held
+BENCHMARK( "adventure/move_with_collision", Steps, []
+{
+    const adventure::Room& room = CentreRoom();
+    adventure::Player p;
+    p.pos = { 155.f, 105.f };
+    for( int i = 0; i < Steps; ++i )
+    {
+        const float angle = static_cast<float>(i) * 0.01f;
+        adventure::moveWithCollision( p, room, { std::cos( angle ) * 2.f, std::sin( angle * 1.3f ) * 2.f } );
+    }
+    bench::DoNotOptimize( p.pos );
+} );
@@ -0,0 +1,62 @@
+#include "Bench.h"
+// See BenchHarpoon.cpp for why the headers are included up front
+#include <iostream>
+#include <sstream>
+
+namespace coding
+{
+#define main coding_main
+#include "../coding.cpp"
+#undef main
+}
+
+namespace
+{
+    constexpr int Depth = 12;
+    constexpr int NodeCount = (1 << Depth) - 1;
+
+    coding::Node* Build( int depth, int& next )
+    {
+        if( depth == 0 )
+        {
+            return nullptr;
+        }
+        coding::Node* pNode = new coding::Node( next++ );
+        pNode->left = Build( depth - 1, next );
+        pNode->right = Build( depth - 1, next );
+        return pNode;
+    }
+
+    coding::Node* Tree()
+    {
+        static coding::Node* pRoot = []
+        {
+            int next = 1;
+            return Build( Depth, next );
+        }();
+        return pRoot;
+    }
+
+    // The traversals print every value; send that into a reused string
+    // stream rather than the terminal
+    template<typename F>
+    void WithCoutCaptured( F&& fn )
+    {
+        static std::ostringstream sink;
+        sink.str( std::string() );
+        std::streambuf* pOld = std::cout.rdbuf( sink.rdbuf() );
+        fn();
+        std::cout.rdbuf( pOld );
+        bench::DoNotOptimize( sink );
+    }
+}
+
+BENCHMARK( "coding/preorder", NodeCount, []
+{
+    WithCoutCaptured( [] { coding::preorder( Tree() ); } );
+} );
+
+BENCHMARK( "coding/postorder", NodeCount, []
+{
+    WithCoutCaptured( [] { coding::postorder( Tree() ); } );
+} );
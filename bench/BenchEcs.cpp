@@ -0,0 +1,89 @@
+#include "Bench.h"
+#include "../Ecs.h"
+#include <cstdint>
+#include <vector>
+
+// Ecs::World at 100k entities: a movement system over two components, the
+// same through the per-chunk arrays, and a churn of destroy and create
+namespace
+{
+    constexpr int Entities = 100000;
+    constexpr float Dt = 1.0f / 60.0f;
+
+    struct Position
+    {
+        float x;
+        float y;
+    };
+    struct Velocity
+    {
+        float x;
+        float y;
+    };
+    struct Health
+    {
+        int value;
+    };
+
+    struct EcsFixture
+    {
+        EcsFixture()
+        {
+            std::uint32_t state = 12345u;
+            for( int i = 0; i < Entities; ++i )
+            {
+                state = state * 1664525u + 1013904223u;
+                const Position p{ static_cast<float>(state >> 8 & 0x3FFu), static_cast<float>(state >> 18 & 0x3FFu) };
+                const Velocity v{ static_cast<float>(state & 0xFFu) - 128.0f, static_cast<float>(state >> 24) - 128.0f };
+                // A quarter also carry health, so the view spans two archetypes
+                entities.push_back( i % 4 == 0 ? world.Create( p, v, Health{ 100 } ) : world.Create( p, v ) );
+            }
+        }
+        Ecs::World world;
+        std::vector<Ecs::Entity> entities;
+    };
+
+    EcsFixture& Fixture()
+    {
+        static EcsFixture f;
+        return f;
+    }
+}
+
+BENCHMARK( "ecs/move_100k", Entities, []
+{
+    Ecs::World& world = Fixture().world;
+    world.Query<Position, Velocity>().ForEach( []( Position& p, const Velocity& v )
+    {
+        p.x += v.x * Dt;
+        p.y += v.y * Dt;
+    } );
+    bench::DoNotOptimize( world );
+} );
+
+BENCHMARK( "ecs/move_100k_chunks", Entities, []
+{
+    Ecs::World& world = Fixture().world;
+    world.Query<Position, Velocity>().ForEachChunk( []( int count, const Ecs::Entity*, Position* p, const Velocity* v )
+    {
+        for( int i = 0; i < count; ++i )
+        {
+            p[i].x += v[i].x * Dt;
+            p[i].y += v[i].y * Dt;
+        }
+    } );
+    bench::DoNotOptimize( world );
+} );
+
+// Destroys and recreates a thousand entities spread over the store
+BENCHMARK( "ecs/churn_1k", 1000, []
+{
+    EcsFixture& f = Fixture();
+    for( int i = 0; i < 1000; ++i )
+    {
+        Ecs::Entity& e = f.entities[std::size_t( i ) * 97u % f.entities.size()];
+        f.world.Destroy( e );
+        e = f.world.Create( Position{ 0.0f, 0.0f }, Velocity{ 1.0f, 1.0f } );
+    }
+    bench::DoNotOptimize( f.world );
+} );
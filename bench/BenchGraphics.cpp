@@ -0,0 +1,194 @@
+#include "Bench.h"
+#include "../Mainwindow.h"
+#include "../Graphics.h"
+#include "../FixedGraphics.h"
+#include "../Surface.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+// Graphics is driven through the headless backend, so these run on
+// machines without a display and measure CPU work only
+namespace
+{
+    constexpr int Width = 800;
+    constexpr int Height = 600;
+    constexpr int PixelsPerRep = 100000;
+    constexpr int ShapesPerRep = 1000;
+    constexpr int SpriteSize = 48;
+
+    struct GraphicsFixture
+    {
+        GraphicsFixture()
+            : wnd( Width, Height, "bench", MainWindow::Backend::Headless ),
+              gfx( wnd ),
+              fixedWnd( Width, Height, "bench", MainWindow::Backend::Headless ),
+              fixedGfx( fixedWnd ),
+              sprite( SpriteSize, SpriteSize )
+        {
+            // Scattered but repeatable coordinates, like particles or stars
+            std::uint32_t state = 12345u;
+            coords.reserve( PixelsPerRep );
+            for( int i = 0; i < PixelsPerRep; ++i )
+            {
+                state = state * 1664525u + 1013904223u;
+                coords.push_back( { int( (state >> 8) % Width ), int( (state >> 20) % Height ) } );
+            }
+            // Origin plus a signed extent of up to 100 pixels, some of them
+            // off screen so clipping is exercised too
+            shapes.reserve( ShapesPerRep );
+            for( int i = 0; i < ShapesPerRep; ++i )
+            {
+                state = state * 1664525u + 1013904223u;
+                const int x = int( (state >> 8) % (Width + 64) ) - 32;
+                const int y = int( (state >> 20) % (Height + 64) ) - 32;
+                state = state * 1664525u + 1013904223u;
+                shapes.push_back( { x, y, int( (state >> 8) % 201 ) - 100, int( (state >> 20) % 201 ) - 100 } );
+            }
+            // A ball: opaque inside, a soft premultiplied rim, clear corners
+            for( int y = 0; y < SpriteSize; ++y )
+            {
+                for( int x = 0; x < SpriteSize; ++x )
+                {
+                    const float d = std::hypot( x + 0.5f - SpriteSize / 2, y + 0.5f - SpriteSize / 2 );
+                    const int a = std::clamp( int( (SpriteSize / 2 - d) * 64.0f ), 0, 255 );
+                    sprite.PutPixel( x, y, Color( std::uint8_t( a * 3 / 4 ), std::uint8_t( a / 2 ), std::uint8_t( a * x / SpriteSize ), std::uint8_t( a ) ) );
+                }
+            }
+        }
+        MainWindow wnd;
+        Graphics gfx;
+        // The same size with compile-time dimensions, on its own window
+        MainWindow fixedWnd;
+        FixedGraphics<Width, Height> fixedGfx;
+        std::vector<sf::Vector2i> coords;
+        std::vector<std::array<int, 4>> shapes;
+        Surface sprite;
+    };
+
+    GraphicsFixture& Fixture()
+    {
+        static GraphicsFixture fixture;
+        return fixture;
+    }
+}
+
+BENCHMARK( "graphics/put_pixel", PixelsPerRep, []
+{
+    GraphicsFixture& f = Fixture();
+    for( const auto& p : f.coords )
+    {
+        f.gfx.PutPixel( p.x, p.y, 255, 255, 255 );
+    }
+    bench::DoNotOptimize( f.gfx );
+} );
+
+BENCHMARK( "graphics/frame_put_pixel_present", PixelsPerRep, []
+{
+    GraphicsFixture& f = Fixture();
+    f.gfx.BeginFrame();
+    for( const auto& p : f.coords )
+    {
+        f.gfx.PutPixel( p.x, p.y, 255, 255, 255 );
+    }
+    f.gfx.EndFrame();
+} );
+
+// Runtime-sized Graphics against FixedGraphics<800, 600> on identical work
+
+BENCHMARK( "graphics/fixed_put_pixel", PixelsPerRep, []
+{
+    GraphicsFixture& f = Fixture();
+    for( const auto& p : f.coords )
+    {
+        f.fixedGfx.PutPixel( p.x, p.y, Colors::White );
+    }
+    bench::DoNotOptimize( f.fixedGfx );
+} );
+
+BENCHMARK( "graphics/draw_rect", ShapesPerRep, []
+{
+    GraphicsFixture& f = Fixture();
+    for( const auto& s : f.shapes )
+    {
+        f.gfx.DrawRect( s[0], s[1], std::abs( s[2] ), std::abs( s[3] ), Colors::Cyan );
+    }
+    bench::DoNotOptimize( f.gfx );
+} );
+
+BENCHMARK( "graphics/fixed_draw_rect", ShapesPerRep, []
+{
+    GraphicsFixture& f = Fixture();
+    for( const auto& s : f.shapes )
+    {
+        f.fixedGfx.DrawRect( s[0], s[1], std::abs( s[2] ), std::abs( s[3] ), Colors::Cyan );
+    }
+    bench::DoNotOptimize( f.fixedGfx );
+} );
+
+BENCHMARK( "graphics/draw_line", ShapesPerRep, []
+{
+    GraphicsFixture& f = Fixture();
+    for( const auto& s : f.shapes )
+    {
+        f.gfx.DrawLine( s[0], s[1], s[0] + s[2], s[1] + s[3], Colors::Yellow );
+    }
+    bench::DoNotOptimize( f.gfx );
+} );
+
+BENCHMARK( "graphics/fixed_draw_line", ShapesPerRep, []
+{
+    GraphicsFixture& f = Fixture();
+    for( const auto& s : f.shapes )
+    {
+        f.fixedGfx.DrawLine( s[0], s[1], s[0] + s[2], s[1] + s[3], Colors::Yellow );
+    }
+    bench::DoNotOptimize( f.fixedGfx );
+} );
+
+BENCHMARK( "graphics/frame_fixed_put_pixel_present", PixelsPerRep, []
+{
+    GraphicsFixture& f = Fixture();
+    f.fixedGfx.BeginFrame();
+    for( const auto& p : f.coords )
+    {
+        f.fixedGfx.PutPixel( p.x, p.y, Colors::White );
+    }
+    f.fixedGfx.EndFrame();
+} );
+
+// Axis-aligned blits against the affine path at the same size, rotated by
+// each shape's own angle
+BENCHMARK( "graphics/draw_sprite", ShapesPerRep, []
+{
+    GraphicsFixture& f = Fixture();
+    for( const auto& s : f.shapes )
+    {
+        f.gfx.DrawSprite( s[0], s[1], f.sprite );
+    }
+    bench::DoNotOptimize( f.gfx );
+} );
+
+BENCHMARK( "graphics/draw_sprite_rotated", ShapesPerRep, []
+{
+    GraphicsFixture& f = Fixture();
+    for( const auto& s : f.shapes )
+    {
+        f.gfx.DrawSpriteTransformed( float( s[0] ), float( s[1] ), f.sprite, s[2] * 0.0314f, 1.0f, Graphics::TextureFilter::Nearest );
+    }
+    bench::DoNotOptimize( f.gfx );
+} );
+
+BENCHMARK( "graphics/draw_sprite_rotated_bilinear", ShapesPerRep, []
+{
+    GraphicsFixture& f = Fixture();
+    for( const auto& s : f.shapes )
+    {
+        f.gfx.DrawSpriteTransformed( float( s[0] ), float( s[1] ), f.sprite, s[2] * 0.0314f, 1.0f, Graphics::TextureFilter::Bilinear );
+    }
+    bench::DoNotOptimize( f.gfx );
+} );
@@ -0,0 +1,136 @@
+#include "Bench.h"
+// Everything purple2.cpp includes comes in first, so that the #includes
+// inside the namespace below are no-ops and only the game code is wrapped
+#include <SFML/Graphics.hpp>
+#include <SFML/Window.hpp>
+#include <SFML/System.hpp>
+#include <SFML/Audio.hpp>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <cstdint>
+#include "../Input.h"
+#include "../BitmapFont.h"
+#include "../FramePacer.h"
+#include "../ParticlePool.h"
+#include "../ShapeBatch.h"
+#include "../SpatialHash.h"
+#include "../Ecs.h"
+#include "../JobSystem.h"
+
+namespace harpoon
+{
+#define main harpoon_main
+#include "../purple2.cpp"
+#undef main
+}
+
+namespace
+{
+    constexpr int Explosions = 100;
+    constexpr int ParticlesPerExplosion = 30;
+    constexpr float Dt = 1.0f / 60.0f;
+
+    JobSystem& Jobs()
+    {
+        static JobSystem jobs;
+        return jobs;
+    }
+}
+
+BENCHMARK( "harpoon/particles_emit", Explosions * ParticlesPerExplosion, []
+{
+    static harpoon::ParticleSystem ps;
+    std::srand( 1u );
+    ps.pool.Clear();
+    for( int i = 0; i < Explosions; ++i )
+    {
+        ps.emit( { 400.0f, 300.0f } );
+    }
+    bench::DoNotOptimize( ps.pool );
+} );
+
+// One second of simulation of 100 overlapping explosions, including the
+// removal of particles as they expire
+BENCHMARK( "harpoon/particles_update", Explosions * ParticlesPerExplosion * 60, []
+{
+    static harpoon::ParticleSystem ps;
+    std::srand( 1u );
+    ps.pool.Clear();
+    for( int i = 0; i < Explosions; ++i )
+    {
+        ps.emit( { 400.0f, 300.0f } );
+    }
+    for( int frame = 0; frame < 60; ++frame )
+    {
+        ps.update( Dt, Jobs() );
+    }
+    bench::DoNotOptimize( ps.pool );
+} );
+
+// Filling a frame's shape batch with 100 explosions' particles and sorting
+// it, everything but the one draw call
+BENCHMARK( "harpoon/particles_draw", Explosions * ParticlesPerExplosion, []
+{
+    static harpoon::ParticleSystem ps;
+    static ShapeBatch shapes;
+    if( ps.pool.GetSize() == 0 )
+    {
+        std::srand( 1u );
+        for( int i = 0; i < Explosions; ++i )
+        {
+            ps.emit( { 400.0f, 300.0f } );
+        }
+    }
+    shapes.Clear();
+    ps.draw( shapes );
+    shapes.Sort();
+    bench::DoNotOptimize( shapes );
+} );
+
+namespace
+{
+    constexpr int HordeSize = 5000;
+    constexpr int HordeQueries = 1000;
+
+    harpoon::Horde& Horde()
+    {
+        static harpoon::Horde horde = []
+        {
+            std::srand( 1u );
+            return harpoon::Horde( HordeSize );
+        }();
+        return horde;
+    }
+}
+
+// A horde-mode tick: every target moves, the hash is rebuilt and the
+// player and harpoon are tested against it
+BENCHMARK( "harpoon/horde_tick", HordeSize, []
+{
+    harpoon::Horde& horde = Horde();
+    horde.update( Dt, Jobs() );
+    int hits = horde.findHit( { 100.0f, 300.0f }, 12.0f ).IsNull() ? 0 : 1;
+    hits += horde.findHit( { 300.0f, 300.0f }, 12.0f ).IsNull() ? 0 : 1;
+    bench::DoNotOptimize( hits );
+} );
+
+// Hit tests alone, spread over the field, against a hash already built
+BENCHMARK( "harpoon/horde_hit_test", HordeQueries, []
+{
+    harpoon::Horde& horde = Horde();
+    int hits = 0;
+    for( int i = 0; i < HordeQueries; ++i )
+    {
+        const sf::Vector2f p{ static_cast<float>(i * 37 % 800), static_cast<float>(i * 53 % 600) };
+        hits += horde.findHit( p, 12.0f ).IsNull() ? 0 : 1;
+    }
+    bench::DoNotOptimize( hits );
+} );
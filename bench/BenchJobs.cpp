@@ -0,0 +1,45 @@
+#include "Bench.h"
+#include "../JobSystem.h"
+#include <vector>
+
+// JobSystem overheads: a ParallelFor over a million floats in 16k ranges,
+// and a chain of jobs each depending on the one before
+namespace
+{
+    constexpr int Elements = 1000000;
+    constexpr int Grain = 16384;
+    constexpr int ChainLength = 1000;
+
+    JobSystem& Jobs()
+    {
+        static JobSystem jobs;
+        return jobs;
+    }
+}
+
+BENCHMARK( "jobs/parallel_for_1m", Elements, []
+{
+    static std::vector<float> values( Elements, 1.0f );
+    float* pValues = values.data();
+    Jobs().ParallelFor( Elements, Grain, [pValues]( int first, int last )
+    {
+        for( int i = first; i < last; ++i )
+        {
+            pValues[i] = pValues[i] * 0.999f + 0.001f;
+        }
+    } );
+    bench::DoNotOptimize( values );
+} );
+
+BENCHMARK( "jobs/dependency_chain", ChainLength, []
+{
+    JobSystem& jobs = Jobs();
+    int counter = 0;
+    JobSystem::Job previous;
+    for( int i = 0; i < ChainLength; ++i )
+    {
+        previous = jobs.Submit( [&counter] { ++counter; }, { previous } );
+    }
+    jobs.Wait( previous );
+    bench::DoNotOptimize( counter );
+} );
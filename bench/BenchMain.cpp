@@ -0,0 +1,90 @@
+#include "Bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Usage: bench [--reps N] [--warmup N] [--filter substring]
+namespace
+{
+    struct Entry
+    {
+        std::string name;
+        std::int64_t itemsPerRep;
+        bench::BenchFn fn;
+    };
+
+    std::vector<Entry>& Registry()
+    {
+        static std::vector<Entry> entries;
+        return entries;
+    }
+
+    // The same checks the kernels make, so results say which path ran
+#if defined( __AVX2__ )
+    constexpr const char* SimdPath = "avx2";
+#elif defined( __SSE2__ )
+    constexpr const char* SimdPath = "sse2";
+#else
+    constexpr const char* SimdPath = "scalar";
+#endif
+}
+
+bench::Registrar::Registrar( const std::string& name, std::int64_t itemsPerRep, BenchFn fn )
+{
+    Registry().push_back( { name, itemsPerRep, std::move( fn ) } );
+}
+
+int main( int argc, char* argv[] )
+{
+    int reps = 101;
+    int warmup = 10;
+    const char* pFilter = "";
+    for( int i = 1; i + 1 < argc; i += 2 )
+    {
+        if( std::strcmp( argv[i], "--reps" ) == 0 )
+        {
+            reps = std::max( 1, std::atoi( argv[i + 1] ) );
+        }
+        else if( std::strcmp( argv[i], "--warmup" ) == 0 )
+        {
+            warmup = std::max( 0, std::atoi( argv[i + 1] ) );
+        }
+        else if( std::strcmp( argv[i], "--filter" ) == 0 )
+        {
+            pFilter = argv[i + 1];
+        }
+    }
+
+    auto& entries = Registry();
+    std::sort( entries.begin(), entries.end(), []( const Entry& a, const Entry& b ) { return a.name < b.name; } );
+    std::vector<double> samples( reps );
+    for( const Entry& e : entries )
+    {
+        if( e.name.find( pFilter ) == std::string::npos )
+        {
+            continue;
+        }
+        for( int i = 0; i < warmup; ++i )
+        {
+            e.fn();
+        }
+        for( int i = 0; i < reps; ++i )
+        {
+            const auto start = std::chrono::steady_clock::now();
+            e.fn();
+            samples[i] = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count();
+        }
+        std::sort( samples.begin(), samples.end() );
+        const double median = samples[reps / 2];
+        const double p99 = samples[std::max( 0, (reps * 99 + 99) / 100 - 1 )];
+        std::printf( "{\"name\":\"%s\",\"reps\":%d,\"items_per_rep\":%lld,\"min_ns\":%.0f,"
+                     "\"median_ns\":%.0f,\"p99_ns\":%.0f,\"median_ns_per_item\":%.3f,\"simd\":\"%s\"}\n",
+            e.name.c_str(), reps, static_cast<long long>(e.itemsPerRep), samples[0], median, p99,
+            median / static_cast<double>(std::max<std::int64_t>( e.itemsPerRep, 1 )), SimdPath );
+        std::fflush( stdout );
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "Bench.h"
+#include "../ParticlePool.h"
+#include <cstdint>
+
+// ParticlePool at 100k live particles: a steady update where nothing dies,
+// and a churning one where a sixtieth of the particles expire and are
+// respawned every frame, as with one-second effects at 60 Hz
+namespace
+{
+    constexpr int Particles = 100000;
+    constexpr float Dt = 1.0f / 60.0f;
+
+    struct ParticleFixture
+    {
+        ParticleFixture()
+        {
+            steadyEmitter = steady.AddEmitter( Particles );
+            churnEmitter = churn.AddEmitter( Particles );
+            Fill( steady, steadyEmitter, 1.0e9f );
+            Fill( churn, churnEmitter, 1.0f );
+        }
+        void Fill( ParticlePool& pool, ParticlePool::Emitter e, float lifetime )
+        {
+            // Spread the deaths evenly over the frames of a lifetime
+            while( pool.GetSize() < Particles )
+            {
+                const float age = static_cast<float>(pool.GetSize() % 60) * Dt;
+                Spawn( pool, e, lifetime - age + Dt * 0.5f );
+            }
+        }
+        void Spawn( ParticlePool& pool, ParticlePool::Emitter e, float lifetime )
+        {
+            state = state * 1664525u + 1013904223u;
+            const float vx = static_cast<float>(state >> 16 & 0x1FFu) - 256.0f;
+            const float vy = static_cast<float>(state >> 7 & 0x1FFu) - 256.0f;
+            pool.Spawn( e, 400.0f, 300.0f, vx, vy, lifetime );
+        }
+        ParticlePool steady{ Particles };
+        ParticlePool churn{ Particles };
+        ParticlePool::Emitter steadyEmitter;
+        ParticlePool::Emitter churnEmitter;
+        std::uint32_t state = 12345u;
+    };
+
+    ParticleFixture& Fixture()
+    {
+        static ParticleFixture f;
+        return f;
+    }
+}
+
+BENCHMARK( "particles/update_100k", Particles, []
+{
+    ParticleFixture& f = Fixture();
+    f.steady.Update( Dt, 0.92f );
+    bench::DoNotOptimize( f.steady );
+} );
+
+BENCHMARK( "particles/update_100k_churn", Particles, []
+{
+    ParticleFixture& f = Fixture();
+    f.churn.Update( Dt, 0.92f );
+    while( f.churn.GetSize() < Particles )
+    {
+        f.Spawn( f.churn, f.churnEmitter, 1.0f );
+    }
+    bench::DoNotOptimize( f.churn );
+} );
@@ -0,0 +1,108 @@
+#include "Bench.h"
+#include "../Graphics.h"
+#include "../PostProcess.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// The post-process chain on an 800x600 frame of noise with a few bright
+// blocks, one stage at a time and all together. The grade (and the chain's)
+// is per-channel, which runs as three curves; grade_3d mixes channels
+// (sepia) so it times the trilinear LUT path.
+namespace
+{
+    constexpr int Width = 800;
+    constexpr int Height = 600;
+
+    struct PostFixture
+    {
+        PostFixture()
+            : frame( std::size_t( Width ) * Height )
+        {
+            std::uint32_t state = 12345u;
+            for( auto& p : frame )
+            {
+                state = state * 1664525u + 1013904223u;
+                p = (state >> 8 & 0x003F3F3Fu) | 0xFF000000u;
+            }
+            for( int i = 0; i < 40; ++i )
+            {
+                const int x0 = (i * 97) % (Width - 24);
+                const int y0 = (i * 61) % (Height - 24);
+                for( int y = y0; y < y0 + 24; ++y )
+                {
+                    for( int x = x0; x < x0 + 24; ++x )
+                    {
+                        frame[std::size_t( y ) * Width + x] = 0xFFE0F0FFu;
+                    }
+                }
+            }
+            blur.SetBlur( 3.0f );
+            bloom.SetBloom( 180, 1.5f, 12.0f );
+            grade.SetColorGrade( []( Color c )
+            {
+                return Color( c.GetR(), static_cast<unsigned char>(c.GetG() * 3 / 4), static_cast<unsigned char>(255 - c.GetB() / 2) );
+            } );
+            gradeMixed.SetColorGrade( []( Color c )
+            {
+                const int r = c.GetR(), g = c.GetG(), b = c.GetB();
+                return Color(
+                    static_cast<unsigned char>(std::min( (r * 101 + g * 197 + b * 48) / 256, 255 )),
+                    static_cast<unsigned char>(std::min( (r * 89 + g * 176 + b * 43) / 256, 255 )),
+                    static_cast<unsigned char>(std::min( (r * 70 + g * 137 + b * 33) / 256, 255 )) );
+            } );
+            chain.SetBlur( 1.0f );
+            chain.SetBloom( 180, 1.5f, 12.0f );
+            chain.SetColorGrade( []( Color c )
+            {
+                return Color( c.GetR(), static_cast<unsigned char>(c.GetG() * 3 / 4), static_cast<unsigned char>(255 - c.GetB() / 2) );
+            } );
+        }
+        Graphics::RawSurface Source()
+        {
+            return { frame.data(), Width, Width, Height };
+        }
+        std::vector<std::uint32_t> frame;
+        PostProcess blur;
+        PostProcess bloom;
+        PostProcess grade;
+        PostProcess gradeMixed;
+        PostProcess chain;
+    };
+
+    PostFixture& Fixture()
+    {
+        static PostFixture fixture;
+        return fixture;
+    }
+}
+
+BENCHMARK( "postprocess/blur", Width * Height, []
+{
+    PostFixture& f = Fixture();
+    bench::DoNotOptimize( f.blur.Apply( f.Source() ) );
+} );
+
+BENCHMARK( "postprocess/bloom", Width * Height, []
+{
+    PostFixture& f = Fixture();
+    bench::DoNotOptimize( f.bloom.Apply( f.Source() ) );
+} );
+
+BENCHMARK( "postprocess/grade", Width * Height, []
+{
+    PostFixture& f = Fixture();
+    bench::DoNotOptimize( f.grade.Apply( f.Source() ) );
+} );
+
+BENCHMARK( "postprocess/grade_3d", Width * Height, []
+{
+    PostFixture& f = Fixture();
+    bench::DoNotOptimize( f.gradeMixed.Apply( f.Source() ) );
+} );
+
+BENCHMARK( "postprocess/chain", Width * Height, []
+{
+    PostFixture& f = Fixture();
+    bench::DoNotOptimize( f.chain.Apply( f.Source() ) );
+} );
@@ -0,0 +1,60 @@
+#include "Bench.h"
+#include "../ShapeBatch.h"
+
+// Building and sorting ShapeBatch frames: 10k rectangles under one state,
+// and the same spread over eight layers and three states so the radix sort
+// and the vertex gather both run
+namespace
+{
+    constexpr int Shapes = 10000;
+
+    struct ShapeFixture
+    {
+        sf::Texture texture;
+        ShapeBatch batch;
+    };
+
+    ShapeFixture& Fixture()
+    {
+        static ShapeFixture f;
+        return f;
+    }
+}
+
+BENCHMARK( "shapes/rects_one_state", Shapes, []
+{
+    ShapeBatch& batch = Fixture().batch;
+    batch.Clear();
+    for( int i = 0; i < Shapes; ++i )
+    {
+        batch.AddRect( { static_cast<float>(i % 800), static_cast<float>(i / 800) }, { 4.0f, 4.0f }, sf::Color::White );
+    }
+    batch.Sort();
+    bench::DoNotOptimize( batch );
+} );
+
+BENCHMARK( "shapes/rects_layered", Shapes, []
+{
+    ShapeFixture& f = Fixture();
+    f.batch.Clear();
+    for( int i = 0; i < Shapes; ++i )
+    {
+        f.batch.SetLayer( i * 7 % 8 );
+        f.batch.SetState( i % 3 == 0 ? nullptr : &f.texture, i % 3 == 2 ? sf::BlendAdd : sf::BlendAlpha );
+        f.batch.AddRect( { static_cast<float>(i % 800), static_cast<float>(i / 800) }, { 4.0f, 4.0f }, sf::Color::White );
+    }
+    f.batch.Sort();
+    bench::DoNotOptimize( f.batch );
+} );
+
+BENCHMARK( "shapes/circles", Shapes, []
+{
+    ShapeBatch& batch = Fixture().batch;
+    batch.Clear();
+    for( int i = 0; i < Shapes; ++i )
+    {
+        batch.AddCircle( { static_cast<float>(i % 800), static_cast<float>(i / 800) }, 10.0f, sf::Color::Yellow );
+    }
+    batch.Sort();
+    bench::DoNotOptimize( batch );
+} );
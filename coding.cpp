@@ -25,10 +25,11 @@ void postorder(Node*root){
 }
 
 int main (){
-    //Build this tree:
-    //  1
-    // / \
-    //2   3
+    /* Build this tree:
+         1
+        / \
+       2   3
+    */
 
     Node*root = new Node(1);
     root->left = new Node(2);
@@ -4,13 +4,23 @@
 #include <SFML/Audio.hpp>
 #include <vector>
 #include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <algorithm>
 #include <iostream>
 #include <memory>
 #include <optional> // Required for SFML 3.0
 #include <cstdint>  // Required for std::uint8_t
+#include "Input.h"
+#include "BitmapFont.h"
+#include "FramePacer.h"
+#include "ParticlePool.h"
+#include "ShapeBatch.h"
+#include "SpatialHash.h"
+#include "Ecs.h"
+#include "JobSystem.h"
 
 // --- Constants ---
 const unsigned int WIDTH = 800;
@@ -22,94 +32,218 @@ float getVecLength(const sf::Vector2f& v) {
     return std::sqrt(v.x * v.x + v.y * v.y);
 }
 
+// Systems run as jobs, off the main thread, while SFML calls belong on it:
+// sounds are queued for the main thread to play once the tick is done
+void playSound(JobSystem& jobs, sf::Sound* sound, float pitch) {
+    if (!sound) return;
+    jobs.PostToMainThread([sound, pitch] {
+        sound->setPitch(pitch);
+        sound->play();
+    });
+}
+
 // --- Enums ---
 enum class GameState { SWIMMING, FIRING, STRUGGLING, RETRACTING };
+enum PlayerAction { MoveUp, MoveDown, MoveLeft, MoveRight, AimUp, AimDown, AimLeft, AimRight, Fire, ActionCount };
+
+// --- Input Bindings ---
+Input::ActionMap makeActionMap() {
+    Input::ActionMap actions(ActionCount);
+    actions.BindKey(MoveUp, sf::Keyboard::Key::W);
+    actions.BindKey(MoveDown, sf::Keyboard::Key::S);
+    actions.BindKey(MoveLeft, sf::Keyboard::Key::A);
+    actions.BindKey(MoveRight, sf::Keyboard::Key::D);
+    actions.BindKey(AimUp, sf::Keyboard::Key::Up);
+    actions.BindKey(AimDown, sf::Keyboard::Key::Down);
+    actions.BindKey(AimLeft, sf::Keyboard::Key::Left);
+    actions.BindKey(AimRight, sf::Keyboard::Key::Right);
+    actions.BindKey(Fire, sf::Keyboard::Key::Space);
+    // Right trigger pulled past halfway
+    actions.BindAxis(Fire, sf::Joystick::Axis::V, true);
+    return actions;
+}
 
 // --- Particle System ---
-struct Particle {
-    sf::Vector2f pos;
-    sf::Vector2f vel;
-    float lifetime;
-};
-
+// Explosions draw from a fixed pool, so emitting and updating never
+// allocate once the game is running
 class ParticleSystem {
 public:
-    std::vector<Particle> particles;
+    static constexpr int Capacity = 4096;
+    static constexpr int ParticlesPerExplosion = 30;
+    static constexpr int IntegrateGrain = 2048; // A multiple of ParticlePool::Lanes
+
+    ParticlePool pool{Capacity};
+    ParticlePool::Emitter explosions = pool.AddEmitter(Capacity);
     sf::Sound* explosionSound = nullptr;
 
     void emit(sf::Vector2f pos) {
         // Sound is handled in Player class for timing control
-        for (int i = 0; i < 30; ++i) {
+        for (int i = 0; i < ParticlesPerExplosion; ++i) {
             float angle = (static_cast<float>(rand()) / RAND_MAX * 360.0f) * PI / 180.0f;
             float speed = (static_cast<float>(rand()) / RAND_MAX * 300.0f) + 100.0f;
             
-            Particle p;
-            p.pos = pos;
-            p.vel = { std::cos(angle) * speed, std::sin(angle) * speed };
-            p.lifetime = 1.0f;
-            particles.push_back(p);
+            if (!pool.Spawn(explosions, pos.x, pos.y, std::cos(angle) * speed, std::sin(angle) * speed, 1.0f)) {
+                break; // Budget spent; the rest of this explosion is skipped
+            }
         }
     }
 
-    void update(float dt) {
-        for (int i = particles.size() - 1; i >= 0; i--) {
-            particles[i].lifetime -= dt;
-            particles[i].pos += particles[i].vel * dt;
-            particles[i].vel *= 0.92f; // Friction
-
-            if (particles[i].lifetime <= 0) {
-                particles.erase(particles.begin() + i);
-            }
-        }
+    // Integration is split across the job system's threads; removing the
+    // dead reorders the pool, so that stays on one
+    void update(float dt, JobSystem& jobs) {
+        jobs.ParallelFor(pool.GetSize(), IntegrateGrain, [this, dt](int first, int last) {
+            pool.Integrate(dt, 0.92f, first, last); // Friction
+        });
+        pool.RemoveDead();
     }
 
-    void draw(sf::RenderWindow& window) {
-        sf::RectangleShape rect({4.f, 4.f});
-        for (const auto& p : particles) {
-            rect.setPosition(p.pos);
+    void draw(ShapeBatch& batch) {
+        const float* x = pool.GetX();
+        const float* y = pool.GetY();
+        const float* lifetime = pool.GetLifetime();
+        for (int i = 0; i < pool.GetSize(); ++i) {
             sf::Color c = sf::Color::White;
-            c.a = static_cast<std::uint8_t>(std::max(0.0f, p.lifetime) * 255);
-            rect.setFillColor(c);
-            window.draw(rect);
+            c.a = static_cast<std::uint8_t>(std::max(0.0f, lifetime[i]) * 255);
+            batch.AddRect({x[i], y[i]}, {4.f, 4.f}, c);
         }
     }
 };
 
-// --- Target Class ---
-class Target {
+// --- Target Components ---
+// Targets are entities in the horde's Ecs::World; these are their parts
+struct Position { sf::Vector2f value; };
+struct Velocity { sf::Vector2f value; };
+struct Body { float radius = 10.0f; };
+struct Caught {}; // On the harpoon, so the horde does not move it
+
+// --- Horde ---
+// All targets. Systems walk the component arrays chunk by chunk, and hit
+// tests go through a spatial hash rebuilt once targets have moved, so a
+// test only looks at the targets near the point and the cost follows how
+// crowded it is there rather than how many targets exist.
+class Horde {
 public:
-    sf::Vector2f pos;
-    sf::Vector2f vel;
-    float radius = 10.0f;
-    bool isCaught = false;
+    static constexpr float CellSize = 32.0f;
+
+    Ecs::World world;
+
+    // One target is the classic game; more are scattered over the field
+    explicit Horde(int count = 1) : grid(CellSize) {
+        count = std::max(count, 1);
+        for (int i = 0; i < count; ++i) {
+            Ecs::Entity e = world.Create(Position{}, Velocity{}, Body{});
+            if (count > 1) scatter(e);
+            else respawn(e);
+        }
+    }
 
-    Target() {
-        reset();
+    // Movement system: bounce off the walls, then move. Each chunk of
+    // targets is its own piece of work for the job system.
+    void update(float dt, JobSystem& jobs) {
+        chunks.clear();
+        world.Query<Position, Velocity, Body>().Exclude<Caught>().ForEachChunk(
+            [this](int count, const Ecs::Entity*, Position* p, Velocity* v, Body* b) {
+                chunks.push_back({ count, p, v, b });
+            });
+        jobs.ParallelFor(static_cast<int>(chunks.size()), 1, [this, dt](int first, int last) {
+            for (int c = first; c < last; ++c) {
+                const MoveChunk& chunk = chunks[c];
+                for (int i = 0; i < chunk.count; ++i) {
+                    Position& p = chunk.p[i];
+                    Velocity& v = chunk.v[i];
+                    const float r = chunk.b[i].radius;
+                    if (p.value.x - r <= 0 || p.value.x + r >= WIDTH) v.value.x *= -1;
+                    if (p.value.y - r <= 0 || p.value.y + r >= HEIGHT) v.value.y *= -1;
+                    p.value += v.value * dt;
+                }
+            }
+        });
+        dirty = true;
     }
 
-    void reset() {
+    // First target (in hash order) closer to p than r plus its radius, or
+    // a null entity
+    Ecs::Entity findHit(sf::Vector2f p, float r) {
+        if (dirty) {
+            hashed.clear();
+            circles.clear();
+            world.Query<Position, Body>().ForEachEntity([this](Ecs::Entity e, const Position& pos, const Body& b) {
+                hashed.push_back(e);
+                circles.push_back({ pos.value.x, pos.value.y, b.radius });
+            });
+            grid.Build(static_cast<int>(circles.size()), [this](int i) { return circles[i]; });
+            dirty = false;
+        }
+        int hit = -1;
+        grid.Query(p.x, p.y, r, [&hit](int i) {
+            if (hit < 0 || i < hit) hit = i;
+        });
+        return hit >= 0 ? hashed[hit] : Ecs::Entity{};
+    }
+
+    // Sends a target back to the right-hand side, released
+    void respawn(Ecs::Entity e) {
         float randomY = (static_cast<float>(rand()) / RAND_MAX * 500.0f) + 50.0f;
-        pos = { 700.0f, randomY };
-        vel = { -160.0f, 120.0f };
-        isCaught = false;
+        world.Get<Position>(e).value = { 700.0f, randomY };
+        world.Get<Velocity>(e).value = { -160.0f, 120.0f };
+        release(e);
+        dirty = true;
+    }
+
+    // Somewhere random on the field, heading in a random direction at the
+    // usual speed, for horde mode; stays clear of the player's start
+    void scatter(Ecs::Entity e) {
+        sf::Vector2f pos;
+        do {
+            pos = { (static_cast<float>(rand()) / RAND_MAX * (WIDTH - 100.0f)) + 50.0f,
+                    (static_cast<float>(rand()) / RAND_MAX * (HEIGHT - 100.0f)) + 50.0f };
+        } while (getVecLength(pos - sf::Vector2f(100.0f, 300.0f)) < 120.0f);
+        float angle = static_cast<float>(rand()) / RAND_MAX * 2.0f * PI;
+        world.Get<Position>(e).value = pos;
+        world.Get<Velocity>(e).value = { std::cos(angle) * 200.0f, std::sin(angle) * 200.0f };
+        dirty = true;
     }
 
-    void update(float dt) {
-        if (isCaught) return;
+    void grab(Ecs::Entity e) {
+        world.Add(e, Caught{});
+        dirty = true;
+    }
+
+    void release(Ecs::Entity e) {
+        world.Remove<Caught>(e);
+        dirty = true;
+    }
 
-        if (pos.x - radius <= 0 || pos.x + radius >= WIDTH) vel.x *= -1;
-        if (pos.y - radius <= 0 || pos.y + radius >= HEIGHT) vel.y *= -1;
+    sf::Vector2f position(Ecs::Entity e) {
+        return world.Get<Position>(e).value;
+    }
 
-        pos += vel * dt;
+    void moveTo(Ecs::Entity e, sf::Vector2f p) {
+        world.Get<Position>(e).value = p;
+        dirty = true;
     }
 
-    void draw(sf::RenderWindow& window) {
-        sf::CircleShape circle(radius);
-        circle.setOrigin({radius, radius});
-        circle.setPosition(pos);
-        circle.setFillColor(sf::Color::Yellow);
-        window.draw(circle);
+    // Render system
+    void draw(ShapeBatch& batch) {
+        world.Query<Position, Body>().ForEach([&batch](const Position& p, const Body& b) {
+            batch.AddCircle(p.value, b.radius, sf::Color::Yellow);
+        });
     }
+
+private:
+    struct MoveChunk {
+        int count;
+        Position* p;
+        Velocity* v;
+        const Body* b;
+    };
+
+    std::vector<MoveChunk> chunks; // Kept between ticks, so it stops allocating
+    SpatialHash grid;
+    // Filled with the hash: the entity and circle behind each hash index
+    std::vector<Ecs::Entity> hashed;
+    std::vector<SpatialHash::Circle> circles;
+    bool dirty = true;
 };
 
 // --- Player Class ---
@@ -124,7 +258,7 @@ public:
     
     GameState state = GameState::SWIMMING;
     float struggleProgress = 0.0f;
-    bool canTap = true;
+    Ecs::Entity caught; // Target on the harpoon, if any
     
     // Timing variables
     float explosionTimer = 0.0f; 
@@ -136,7 +270,7 @@ public:
 
     sf::Sound* shootSound = nullptr;
 
-    void handleInput(float dt, Target& target, ParticleSystem& ps) {
+    void handleInput(float dt, const Input::Snapshot& in, const Input::ActionMap& actions, Horde& horde, ParticleSystem& ps, JobSystem& jobs) {
         
         // --- DEATH CHECK ---
         if (isDead) {
@@ -153,45 +287,35 @@ public:
 
         sf::Vector2f moveVec(0.0f, 0.0f);
         sf::Vector2f aimVec(0.0f, 0.0f);
-        bool fireTriggered = false;
-        bool struggleButton = false;
-
-        // --- 1. Keyboard Input ---
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::W)) moveVec.y -= 1;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::S)) moveVec.y += 1;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::A)) moveVec.x -= 1;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::D)) moveVec.x += 1;
-
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Up)) aimVec.y -= 1;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Down)) aimVec.y += 1;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Left)) aimVec.x -= 1;
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Right)) aimVec.x += 1;
-
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Space)) {
-            fireTriggered = true;
-            struggleButton = true;
-        }
 
-        // --- 2. Controller Input ---
-        if (sf::Joystick::isConnected(0)) {
-            float joyX = sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::X);
-            float joyY = sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::Y);
+        // --- 1. Digital Input (keys, buttons, trigger pulled past halfway) ---
+        if (in.IsDown(actions[MoveUp])) moveVec.y -= 1;
+        if (in.IsDown(actions[MoveDown])) moveVec.y += 1;
+        if (in.IsDown(actions[MoveLeft])) moveVec.x -= 1;
+        if (in.IsDown(actions[MoveRight])) moveVec.x += 1;
+
+        if (in.IsDown(actions[AimUp])) aimVec.y -= 1;
+        if (in.IsDown(actions[AimDown])) aimVec.y += 1;
+        if (in.IsDown(actions[AimLeft])) aimVec.x -= 1;
+        if (in.IsDown(actions[AimRight])) aimVec.x += 1;
+
+        // Every press this frame counts, even taps shorter than a frame
+        const int firePresses = in.PressCount(actions[Fire]);
+
+        // --- 2. Controller Sticks ---
+        if (in.IsJoystickConnected()) {
+            float joyX = in.GetAxis(sf::Joystick::Axis::X);
+            float joyY = in.GetAxis(sf::Joystick::Axis::Y);
             if (std::abs(joyX) > 15.f) moveVec.x += joyX / 100.f;
             if (std::abs(joyY) > 15.f) moveVec.y += joyY / 100.f;
 
-            float aimX = sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::Z);
-            float aimY = sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::R);
+            float aimX = in.GetAxis(sf::Joystick::Axis::Z);
+            float aimY = in.GetAxis(sf::Joystick::Axis::R);
 
             if (std::abs(aimX) > 20.f || std::abs(aimY) > 20.f) {
                 aimVec.x = aimX;
                 aimVec.y = aimY;
             }
-
-            float rightTrigger = sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::V);
-            if (rightTrigger > 50.0f) {
-                fireTriggered = true;
-                struggleButton = true;
-            }
         }
 
         // --- Logic ---
@@ -201,22 +325,16 @@ public:
                 aimAngle = std::round(rawAngle / 45.0f) * 45.0f;
             }
 
-            if (fireTriggered && state == GameState::SWIMMING) {
-                if (canTap) {
-                    state = GameState::FIRING;
-                    harpoonPos = pos;
-                    float rad = aimAngle * PI / 180.0f;
-                    harpoonVel = { std::cos(rad) * 1000.0f, std::sin(rad) * 1000.0f };
-                    
-                    if (shootSound) {
-                        float pitch = (static_cast<float>(rand()) / RAND_MAX * 0.2f) + 0.9f; 
-                        shootSound->setPitch(pitch);
-                        shootSound->play();
-                    }
-                    canTap = false;
+            if (firePresses > 0 && state == GameState::SWIMMING) {
+                state = GameState::FIRING;
+                harpoonPos = pos;
+                float rad = aimAngle * PI / 180.0f;
+                harpoonVel = { std::cos(rad) * 1000.0f, std::sin(rad) * 1000.0f };
+                
+                if (shootSound) {
+                    float pitch = (static_cast<float>(rand()) / RAND_MAX * 0.2f) + 0.9f; 
+                    playSound(jobs, shootSound, pitch);
                 }
-            } else if (!fireTriggered) {
-                canTap = true;
             }
         }
 
@@ -226,19 +344,13 @@ public:
 
             struggleProgress -= 55.0f * dt;
             
-            if (struggleButton) {
-                if (canTap) {
-                    struggleProgress += 32.0f; 
-                    canTap = false; 
-                }
-            } else {
-                canTap = true; 
-            }
+            struggleProgress += 32.0f * firePresses;
 
             // Target lost
             if (struggleProgress <= 0.0f) {
                 state = GameState::RETRACTING;
-                target.isCaught = false;
+                horde.release(caught);
+                caught = {};
                 explosionSoundPlayed = false; 
             }
             
@@ -249,8 +361,7 @@ public:
                 if (!explosionSoundPlayed) {
                      if (ps.explosionSound) {
                          float pitch = (static_cast<float>(rand()) / RAND_MAX * 0.4f) + 0.8f;
-                         ps.explosionSound->setPitch(pitch);
-                         ps.explosionSound->play();
+                         playSound(jobs, ps.explosionSound, pitch);
                      }
                      explosionSoundPlayed = true;
                      explosionTimer = 0.001f; // 1ms delay
@@ -261,24 +372,24 @@ public:
 
                 // 3. Trigger Visuals after delay
                 if (explosionTimer <= 0.0f) {
-                    ps.emit(target.pos); 
-                    target.reset(); 
-                    target.isCaught = false; 
+                    ps.emit(horde.position(caught)); 
+                    horde.respawn(caught); 
+                    caught = {}; 
                     state = GameState::RETRACTING;
                     struggleProgress = 0.0f;
                     explosionSoundPlayed = false; 
                 }
             }
             
-            if (target.isCaught) {
-                harpoonPos = target.pos;
+            if (!caught.IsNull()) {
+                harpoonPos = horde.position(caught);
             }
         }
 
-        updatePhysics(moveVec, dt, target, ps);
+        updatePhysics(moveVec, dt, horde, ps, jobs);
     }
 
-    void updatePhysics(sf::Vector2f moveVec, float dt, Target& target, ParticleSystem& ps) {
+    void updatePhysics(sf::Vector2f moveVec, float dt, Horde& horde, ParticleSystem& ps, JobSystem& jobs) {
         float len = getVecLength(moveVec);
         if (len > 0) {
             if (len > 1.0f) moveVec /= len; 
@@ -290,16 +401,13 @@ public:
         pos.y = std::max(radius, std::min((float)HEIGHT - radius, pos.y));
 
         // --- PLAYER DEATH CHECK ---
-        float distToEnemy = getVecLength(pos - target.pos);
-        if (distToEnemy < (radius + target.radius)) {
+        Ecs::Entity enemy = horde.findHit(pos, radius);
+        if (!enemy.IsNull()) {
             // 1. Visual Explosion
             ps.emit(pos);
             
             // 2. Play Sound
-            if (ps.explosionSound) {
-                ps.explosionSound->setPitch(1.0f);
-                ps.explosionSound->play();
-            }
+            playSound(jobs, ps.explosionSound, 1.0f);
             
             // 3. Set Death State
             isDead = true;
@@ -313,18 +421,21 @@ public:
             explosionSoundPlayed = false;
             
             // 5. Move Enemy Away (so we don't die instantly upon respawn)
-            target.reset(); 
-            target.isCaught = false;
+            // and let go of whatever was on the harpoon
+            if (!caught.IsNull()) horde.release(caught);
+            caught = {};
+            horde.respawn(enemy); 
         }
         // --------------------------
 
         if (state == GameState::FIRING) {
             harpoonPos += harpoonVel * dt;
 
-            float dist = getVecLength(harpoonPos - target.pos);
-            if (dist < (radius + target.radius)) {
+            Ecs::Entity hit = horde.findHit(harpoonPos, radius);
+            if (!hit.IsNull()) {
                 state = GameState::STRUGGLING;
-                target.isCaught = true;
+                caught = hit;
+                horde.grab(caught);
                 struggleProgress = 30.0f;
             }
 
@@ -336,37 +447,29 @@ public:
         if (state == GameState::RETRACTING) {
             sf::Vector2f dir = pos - harpoonPos;
             float dist = getVecLength(dir);
-            float speed = target.isCaught ? 1400.0f : 900.0f;
+            float speed = !caught.IsNull() ? 1400.0f : 900.0f;
 
             if (dist < 15.0f) {
                 state = GameState::SWIMMING;
-                if (target.isCaught) {
+                if (!caught.IsNull()) {
                     ps.emit(pos); 
-                    target.reset();
+                    horde.respawn(caught);
+                    caught = {};
                 }
             } else {
                 harpoonPos += (dir / dist) * speed * dt;
             }
 
-            if (target.isCaught) {
-                target.pos = harpoonPos;
+            if (!caught.IsNull()) {
+                horde.moveTo(caught, harpoonPos);
             }
         }
     }
 
-    void draw(sf::RenderWindow& window) {
+    void draw(ShapeBatch& batch, TextBatch& hud) {
         // Draw harpoon if not dead and not swimming
         if (state != GameState::SWIMMING && !isDead) {
-            sf::Vertex line[] = {
-                sf::Vertex{pos, sf::Color::Yellow},
-                sf::Vertex{harpoonPos, sf::Color::Yellow}
-            };
-            window.draw(line, 2, sf::PrimitiveType::Lines);
-
-            sf::RectangleShape head({20.f, 6.f}); 
-            head.setOrigin({0.f, 3.f});            
-            head.setPosition(harpoonPos);
-            head.setFillColor(sf::Color::Yellow);
+            batch.AddLine(pos, harpoonPos, sf::Color::Yellow);
 
             float rot = 0.f;
             if (state == GameState::RETRACTING) {
@@ -374,44 +477,79 @@ public:
             } else {
                 rot = aimAngle;
             }
-            head.setRotation(sf::degrees(rot)); 
-            window.draw(head);
+            batch.AddRect(harpoonPos, {20.f, 6.f}, {0.f, 3.f}, rot, sf::Color::Yellow);
         }
 
         // Draw Player Body (Only if ALIVE)
         if (!isDead) {
-            sf::CircleShape body(radius);
-            body.setOrigin({radius, radius}); 
-            body.setPosition(pos);
-            body.setFillColor(sf::Color(75, 0, 130)); // Indigo
-            window.draw(body);
+            batch.AddCircle(pos, radius, sf::Color(75, 0, 130)); // Indigo
         }
 
         // Draw Struggle Bar (Only if ALIVE)
         if (state == GameState::STRUGGLING && !isDead) {
-            sf::RectangleShape bg({100.f, 12.f}); 
-            bg.setPosition({pos.x - 50, pos.y - 45}); 
-            bg.setFillColor(sf::Color(50, 50, 50));
-            window.draw(bg);
+            batch.AddRect({pos.x - 50, pos.y - 45}, {100.f, 12.f}, sf::Color(50, 50, 50));
 
             float fillWidth = std::max(0.0f, struggleProgress);
-            sf::RectangleShape fill({fillWidth, 12.f}); 
-            fill.setPosition({pos.x - 50, pos.y - 45}); 
-            fill.setFillColor(sf::Color::Cyan);
-            window.draw(fill);
+            batch.AddRect({pos.x - 50, pos.y - 45}, {fillWidth, 12.f}, sf::Color::Cyan);
+
+            // Percentage label, formatted on the stack and batched with the HUD
+            char label[8];
+            std::snprintf(label, sizeof(label), "%d%%", static_cast<int>(std::clamp(struggleProgress, 0.0f, 100.0f)));
+            hud.Add(label, {pos.x + 56, pos.y - 43}, sf::Color::White);
         }
     }
 };
 
+// --- Headless Script ---
+// Headless runs play themselves: the player swims up and down, turning
+// every second and a half, and taps fire every few frames, which also
+// wins the struggle whenever a target is caught
+void feedScript(Input& input, long long frame) {
+    if (frame % 90 == 0) {
+        const bool down = frame / 90 % 2 == 0;
+        input.Feed(sf::Event::KeyReleased{down ? sf::Keyboard::Key::W : sf::Keyboard::Key::S});
+        input.Feed(sf::Event::KeyPressed{down ? sf::Keyboard::Key::S : sf::Keyboard::Key::W});
+    }
+    if (frame % 6 == 0) input.Feed(sf::Event::KeyPressed{sf::Keyboard::Key::Space});
+    else if (frame % 6 == 3) input.Feed(sf::Event::KeyReleased{sf::Keyboard::Key::Space});
+}
+
 // --- Main Loop ---
-int main() {
-    std::srand(static_cast<unsigned>(std::time(nullptr))); 
+// Usage: purple2 [--horde <count>] [--headless <frames>] [--save-frame <file.png>]
+// --horde plays against that many targets at once.
+// --headless renders that many frames into an offscreen texture instead of
+// a window, at a fixed 60 Hz step with a fixed seed, no sound and the
+// scripted player above, so runs are repeatable; --save-frame then writes
+// the last frame out. The texture (and the font atlas) still need an
+// OpenGL context, so on a machine without a display run it under Xvfb
+// (xvfb-run -a) or with an EGL build of SFML.
+int main(int argc, char* argv[]) {
+    int targetCount = 1;
+    long long headlessFrames = -1;
+    const char* saveFramePath = nullptr;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--horde") == 0) targetCount = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--headless") == 0) headlessFrames = std::atoll(argv[++i]);
+        else if (std::strcmp(argv[i], "--save-frame") == 0) saveFramePath = argv[++i];
+    }
+    const bool headless = headlessFrames >= 0;
+
+    std::srand(headless ? 1u : static_cast<unsigned>(std::time(nullptr))); 
 
-    sf::RenderWindow window(sf::VideoMode({WIDTH, HEIGHT}), "Harpoon Game C++"); 
-    window.setFramerateLimit(60);
+    // Both are render targets; the game only draws to whichever is in use
+    std::optional<sf::RenderWindow> window;
+    std::optional<sf::RenderTexture> offscreen;
+    if (headless) offscreen.emplace(sf::Vector2u{WIDTH, HEIGHT});
+    else window.emplace(sf::VideoMode({WIDTH, HEIGHT}), "Harpoon Game C++");
+    sf::RenderTarget& target = headless ? static_cast<sf::RenderTarget&>(*offscreen) : *window;
+    // Sleep + spin pacing instead of setFramerateLimit, whose coarse sleep jitters
+    FramePacer pacer(60.0);
+
+    // One thread per core; this one runs jobs too while it waits
+    JobSystem jobs;
 
     Player player;
-    Target target;
+    Horde horde(targetCount);
     ParticleSystem ps;
 
     // --- SOUND LOADING ---
@@ -419,27 +557,29 @@ int main() {
     sf::SoundBuffer shootBuffer;
     bool boomLoaded = false;
     bool shootLoaded = false;
-    
-    // 1. Load BOOM (Boom3.wav)
-    if (boomBuffer.loadFromFile("/Users/macbook/Downloads/Boom3.wav")) {
-        boomLoaded = true;
-        std::cout << "Loaded Boom3.wav from Downloads" << std::endl;
-    } else if (boomBuffer.loadFromFile("Boom3.wav")) {
-        boomLoaded = true;
-        std::cout << "Loaded Boom3.wav from local directory" << std::endl;
-    } else {
-        std::cout << "Could not find Boom3.wav!" << std::endl;
-    }
 
-    // 2. Load SHOOT (Shoot11.wav)
-    if (shootBuffer.loadFromFile("/Users/macbook/Downloads/Shoot11.wav")) {
-        shootLoaded = true;
-        std::cout << "Loaded Shoot11.wav from Downloads" << std::endl;
-    } else if (shootBuffer.loadFromFile("Shoot11.wav")) {
-        shootLoaded = true;
-        std::cout << "Loaded Shoot11.wav from local directory" << std::endl;
-    } else {
-        std::cout << "Could not find Shoot11.wav!" << std::endl;
+    if (!headless) {
+        // 1. Load BOOM (Boom3.wav)
+        if (boomBuffer.loadFromFile("/Users/macbook/Downloads/Boom3.wav")) {
+            boomLoaded = true;
+            std::cout << "Loaded Boom3.wav from Downloads" << std::endl;
+        } else if (boomBuffer.loadFromFile("Boom3.wav")) {
+            boomLoaded = true;
+            std::cout << "Loaded Boom3.wav from local directory" << std::endl;
+        } else {
+            std::cout << "Could not find Boom3.wav!" << std::endl;
+        }
+
+        // 2. Load SHOOT (Shoot11.wav)
+        if (shootBuffer.loadFromFile("/Users/macbook/Downloads/Shoot11.wav")) {
+            shootLoaded = true;
+            std::cout << "Loaded Shoot11.wav from Downloads" << std::endl;
+        } else if (shootBuffer.loadFromFile("Shoot11.wav")) {
+            shootLoaded = true;
+            std::cout << "Loaded Shoot11.wav from local directory" << std::endl;
+        } else {
+            std::cout << "Could not find Shoot11.wav!" << std::endl;
+        }
     }
 
     std::optional<sf::Sound> explosionSound;
@@ -454,29 +594,70 @@ int main() {
         player.shootSound = &shootSound.value();
     }
 
+    Input input;
+    Input::ActionMap actions = makeActionMap();
+
+    // Text is drawn from a glyph atlas baked once; the batch keeps its
+    // vertex storage between frames
+    BitmapFont font;
+    TextBatch hud(font);
+    ShapeBatch shapes;
+
     sf::Clock clock;
 
-    while (window.isOpen()) {
-        while (const std::optional event = window.pollEvent()) {
-             if (event->is<sf::Event::Closed>()) {
-                 window.close();
-             }
+    for (long long frame = 0; headless ? frame < headlessFrames : window->isOpen(); ++frame) {
+        if (headless) {
+            feedScript(input, frame);
+        } else {
+            while (const std::optional event = window->pollEvent()) {
+                 input.Feed(*event);
+                 if (event->is<sf::Event::Closed>()) {
+                     window->close();
+                 } else if (event->is<sf::Event::FocusLost>()) {
+                     pacer.SetFocused(false);
+                 } else if (event->is<sf::Event::FocusGained>()) {
+                     pacer.SetFocused(true);
+                 }
+            }
         }
 
-        float dt = clock.restart().asSeconds();
+        float dt = headless ? 1.0f / 60.0f : clock.restart().asSeconds();
         if (dt > 0.1f) dt = 0.1f; 
 
-        target.update(dt);
-        player.handleInput(dt, target, ps);
-        ps.update(dt);
-
-        window.clear(sf::Color::Black); 
+        // The tick as a chain of jobs: targets move, the player reacts to
+        // where they ended up, then the particles (including any the player
+        // just set off) move. Each step waits for the one before, so the
+        // order is the same every frame; the threads share the work inside
+        // the steps.
+        const Input::Snapshot& in = input.NextFrame();
+        JobSystem::Job physics = jobs.Submit([&] { horde.update(dt, jobs); });
+        JobSystem::Job play = jobs.Submit([&] { player.handleInput(dt, in, actions, horde, ps, jobs); }, {physics});
+        JobSystem::Job particles = jobs.Submit([&] { ps.update(dt, jobs); }, {play});
+        jobs.Wait(particles);
+        jobs.RunMainThreadJobs();
+
+        target.clear(sf::Color::Black); 
         
-        target.draw(window);
-        player.draw(window);
-        ps.draw(window);
+        // Every shape goes into one batch, drawn with a single call
+        shapes.Clear();
+        hud.Clear();
+        horde.draw(shapes);
+        player.draw(shapes, hud);
+        ps.draw(shapes);
+        target.draw(shapes);
+        target.draw(hud);
+
+        if (headless) {
+            offscreen->display();
+        } else {
+            window->display();
+            pacer.Wait();
+        }
+    }
 
-        window.display();
+    if (saveFramePath && headless && !offscreen->getTexture().copyToImage().saveToFile(saveFramePath)) {
+        std::cout << "Could not write " << saveFramePath << std::endl;
+        return 1;
     }
 
     return 0;
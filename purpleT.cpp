@@ -5,6 +5,8 @@
 #include <vector>
 #include <iostream>
 #include <ctime>
+#include "ParticlePool.h"
+#include "ShapeBatch.h"
 
 const float PI = 3.14159265f;
 const int WIDTH = 800;
@@ -14,41 +16,35 @@ float getVecLength(sf::Vector2f v) { return std::sqrt(v.x * v.x + v.y * v.y); }
 
 enum class GameState { SWIMMING, FIRING, STRUGGLING, RETRACTING };
 
-struct Particle {
-    sf::RectangleShape shape;
-    sf::Vector2f velocity;
-    float lifetime;
-};
-
 class ParticleSystem {
 public:
-    std::vector<Particle> particles;
+    static constexpr int Capacity = 2048;
+
+    ParticlePool pool{Capacity};
+    ParticlePool::Emitter bursts = pool.AddEmitter(Capacity);
+    // Every particle goes out in one draw call; rebuilt each frame
+    ShapeBatch batch;
 
     void emit(sf::Vector2f pos) {
         for (int i = 0; i < 20; ++i) {
-            Particle p;
-            p.shape.setSize({ 4.f, 4.f });
-            p.shape.setFillColor(sf::Color::White);
-            p.shape.setPosition(pos);
             float angle = (std::rand() % 360) * PI / 180.f;
             float speed = (std::rand() % 300) + 100.f;
-            p.velocity = { std::cos(angle) * speed, std::sin(angle) * speed };
-            p.lifetime = 0.5f; 
-            particles.push_back(p);
+            if (!pool.Spawn(bursts, pos.x, pos.y, std::cos(angle) * speed, std::sin(angle) * speed, 0.5f)) break;
         }
     }
 
     void update(float dt) {
-        for (auto it = particles.begin(); it != particles.end();) {
-            it->lifetime -= dt;
-            it->shape.move(it->velocity * dt);
-            if (it->lifetime <= 0) it = particles.erase(it);
-            else ++it;
-        }
+        pool.Update(dt, 1.0f);
     }
 
     void draw(sf::RenderWindow& window) {
-        for (auto& p : particles) window.draw(p.shape);
+        batch.Clear();
+        const float* x = pool.GetX();
+        const float* y = pool.GetY();
+        for (int i = 0; i < pool.GetSize(); ++i) {
+            batch.AddRect({x[i], y[i]}, {4.f, 4.f}, sf::Color::White);
+        }
+        window.draw(batch);
     }
 };
 
@@ -0,0 +1,246 @@
+#include "../Mainwindow.h"
+#include "../Graphics.h"
+#include "../FixedGraphics.h"
+#include "../PostProcess.h"
+#include "../Surface.h"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Headless checks for the "identical bytes" promises: the binned rasterizer
+// and draw lists on one raster thread and on several, against immediate
+// mode; the post-process chain on one thread and on several; FixedGraphics
+// against Graphics. Frames are compared as presented (MainWindow::GetFrame),
+// so nothing needs a display or GL. Exits nonzero on failure.
+namespace
+{
+    constexpr int Width = 320;
+    constexpr int Height = 200;
+    constexpr int Frames = 3;
+    // Each RecordParallel list draws one slice of the scene
+    constexpr int Slices = 4;
+    constexpr int ItemsPerSlice = 60;
+    constexpr unsigned int ManyThreads = 4u;
+
+    int failures = 0;
+
+    void Check( bool passed, const char* name )
+    {
+        std::printf( "%s %s\n", passed ? "ok  " : "FAIL", name );
+        failures += passed ? 0 : 1;
+    }
+
+    using FrameSet = std::vector<std::vector<std::uint32_t>>;
+
+    // Translucent, color-keyed texture for sprites and textured triangles
+    const Surface& Texture()
+    {
+        static const Surface texture = []
+        {
+            Surface s( 37, 23 );
+            for( int y = 0; y < 23; ++y )
+            {
+                for( int x = 0; x < 37; ++x )
+                {
+                    Color c( static_cast<unsigned char>(x * 7), static_cast<unsigned char>(y * 11), static_cast<unsigned char>((x ^ y) * 5) );
+                    c.SetA( static_cast<unsigned char>((x + y) % 3 == 0 ? 255 : (x * 7 + y * 3) % 256) );
+                    s.PutPixel( x, y, (x + y) % 9 == 0 ? Colors::Magenta : c );
+                }
+            }
+            return s;
+        }();
+        return texture;
+    }
+
+    // One slice of a frame's draw calls, as a Graphics or a DrawList takes
+    // them; shapes run off every edge and overlap across tiles
+    template<typename Target>
+    void DrawSlice( Target& target, int slice, int frame )
+    {
+        const Surface& tex = Texture();
+        for( int n = 0; n < ItemsPerSlice; ++n )
+        {
+            const int i = slice * ItemsPerSlice + n;
+            const int x = (i * 37 + frame * 13) % (Width + 40) - 20;
+            const int y = (i * 53 + frame * 7) % (Height + 40) - 20;
+            const Color c( static_cast<unsigned char>(i * 29), static_cast<unsigned char>(i * 71), static_cast<unsigned char>(i * 113) );
+            target.PutPixel( x, y, c );
+            target.DrawRect( x, y, i % 17 + 1, i % 11 + 1, c );
+            target.DrawLine( x, y, x + i % 90 - 45, y + i % 70 - 35, c );
+            target.DrawCircle( x, y, i % 13, c );
+            target.FillCircle( y, x, i % 7, c );
+            target.DrawHLine( x, x + 30, y + 3, c );
+            switch( i % 4 )
+            {
+            case 0:
+                target.DrawSprite( x, y, tex, static_cast<Graphics::SpriteBlend>(i % 3) );
+                break;
+            case 1:
+                target.DrawSpriteTransformed( float( x ) + 0.5f, float( y ) + 0.25f, tex, float( i ) * 0.37f, 0.5f + float( i % 5 ) * 0.4f,
+                    i % 2 != 0 ? Graphics::TextureFilter::Bilinear : Graphics::TextureFilter::Nearest );
+                break;
+            case 2:
+                target.DrawTexturedTriangle( { float( x ), float( y ), 0.0f, 0.0f }, { float( x + 60 ), float( y + 10 ), 36.0f, 0.0f },
+                    { float( x + 15 ), float( y + 45 ), 0.0f, 22.0f }, tex, Graphics::TextureFilter::Bilinear );
+                break;
+            default:
+                target.DrawText( x, y, "Tiles\n42", c, 1 + i % 2 );
+                break;
+            }
+        }
+    }
+
+    enum class Path
+    {
+        Immediate,
+        Binned,
+        DrawLists
+    };
+
+    FrameSet Render( Graphics::PixelFormat format, Path path, unsigned int threads )
+    {
+        MainWindow wnd( Width, Height, "test", MainWindow::Backend::Headless );
+        Graphics gfx( wnd );
+        gfx.SetPixelFormat( format );
+        gfx.SetRasterThreads( threads );
+        gfx.SetRasterMode( path == Path::Binned ? Graphics::RasterMode::Binned : Graphics::RasterMode::Immediate );
+        FrameSet frames;
+        for( int frame = 0; frame < Frames; ++frame )
+        {
+            gfx.BeginFrame();
+            if( path == Path::DrawLists )
+            {
+                gfx.RecordParallel( Slices, [frame]( Graphics::DrawList& list, int slice )
+                {
+                    DrawSlice( list, slice, frame );
+                } );
+            }
+            else
+            {
+                for( int slice = 0; slice < Slices; ++slice )
+                {
+                    DrawSlice( gfx, slice, frame );
+                }
+            }
+            gfx.EndFrame();
+            gfx.WaitForPresent();
+            frames.push_back( wnd.GetFrame() );
+        }
+        return frames;
+    }
+
+    void RasterThreadsMatch( Graphics::PixelFormat format, const char* name )
+    {
+        const FrameSet reference = Render( format, Path::Immediate, 1u );
+        bool same = true;
+        for( const Path path : { Path::Binned, Path::DrawLists } )
+        {
+            for( const unsigned int threads : { 1u, ManyThreads } )
+            {
+                same = same && Render( format, path, threads ) == reference;
+            }
+        }
+        Check( same, name );
+    }
+
+    void PostProcessThreadsMatch()
+    {
+        std::vector<std::uint32_t> frame( std::size_t( Width ) * Height );
+        std::uint32_t state = 12345u;
+        for( auto& p : frame )
+        {
+            state = state * 1664525u + 1013904223u;
+            p = state >> 8 | 0xFF000000u;
+        }
+        auto run = [&frame]( unsigned int threads, bool mixedGrade )
+        {
+            PostProcess post( threads );
+            post.SetBlur( 2.0f );
+            post.SetBloom( 150, 1.5f, 6.0f );
+            if( mixedGrade )
+            {
+                post.SetColorGrade( []( Color c )
+                {
+                    return Color( c.GetG(), c.GetB(), static_cast<unsigned char>((c.GetR() + c.GetG()) / 2) );
+                } );
+            }
+            else
+            {
+                post.SetColorGrade( []( Color c )
+                {
+                    return Color( c.GetR(), static_cast<unsigned char>(c.GetG() * 3 / 4), static_cast<unsigned char>(255 - c.GetB() / 2) );
+                } );
+            }
+            const Graphics::RawSurface out = post.Apply( { frame.data(), Width, Width, Height } );
+            return std::vector<std::uint32_t>( out.pixels, out.pixels + std::size_t( Width ) * Height );
+        };
+        bool same = true;
+        for( const bool mixedGrade : { false, true } )
+        {
+            same = same && run( 1u, mixedGrade ) == run( ManyThreads, mixedGrade );
+        }
+        Check( same, "PostProcess gives the same bytes on 1 and N threads" );
+    }
+
+    template<typename G, typename V>
+    void DrawFixedScene( G& g, V a, V b, int frame )
+    {
+        g.BeginFrame();
+        g.Clear( a );
+        for( int i = 0; i < 200; ++i )
+        {
+            const int x = (i * 37 + frame * 13) % (Width + 40) - 20;
+            const int y = (i * 53) % (Height + 40) - 20;
+            g.PutPixel( x, y, b );
+            g.DrawRect( x, y, i % 17, i % 11, a );
+            g.DrawLine( x, y, x + i % 90 - 45, y + i % 70 - 35, b );
+            g.DrawCircle( x, y, i % 13, a );
+            g.FillCircle( y, x, i % 7, b );
+            g.DrawHLine( x, x + 30, y + 3, a );
+        }
+        g.DrawText( 5, 5, "Fixed\nsize", b, 2 );
+        g.EndFrame();
+    }
+
+    void FixedGraphicsMatches()
+    {
+        bool same = true;
+        {
+            MainWindow wnd( Width, Height, "runtime", MainWindow::Backend::Headless );
+            MainWindow fixedWnd( Width, Height, "fixed", MainWindow::Backend::Headless );
+            Graphics gfx( wnd );
+            FixedGraphics<Width, Height> fixed( fixedWnd );
+            for( int frame = 0; frame < Frames; ++frame )
+            {
+                DrawFixedScene( gfx, Colors::Cyan, Colors::Red, frame );
+                DrawFixedScene( fixed, Colors::Cyan, Colors::Red, frame );
+                same = same && wnd.GetFrame() == fixedWnd.GetFrame();
+            }
+        }
+        {
+            MainWindow wnd( Width, Height, "runtime", MainWindow::Backend::Headless );
+            MainWindow fixedWnd( Width, Height, "fixed", MainWindow::Backend::Headless );
+            Graphics gfx( wnd );
+            gfx.SetPixelFormat( Graphics::PixelFormat::Indexed8 );
+            FixedGraphics<Width, Height, Graphics::PixelFormat::Indexed8> fixed( fixedWnd );
+            gfx.SetPaletteEntry( 9, Colors::Green );
+            fixed.GetGraphics().SetPaletteEntry( 9, Colors::Green );
+            for( int frame = 0; frame < Frames; ++frame )
+            {
+                DrawFixedScene( gfx, std::uint8_t( 9 ), std::uint8_t( 200 ), frame );
+                DrawFixedScene( fixed, std::uint8_t( 9 ), std::uint8_t( 200 ), frame );
+                same = same && wnd.GetFrame() == fixedWnd.GetFrame();
+            }
+        }
+        Check( same, "FixedGraphics matches Graphics in RGBA32 and Indexed8" );
+    }
+}
+
+int main()
+{
+    RasterThreadsMatch( Graphics::PixelFormat::RGBA32, "binned and draw lists on 1 and N threads match immediate (RGBA32)" );
+    RasterThreadsMatch( Graphics::PixelFormat::Indexed8, "binned and draw lists on 1 and N threads match immediate (Indexed8)" );
+    PostProcessThreadsMatch();
+    FixedGraphicsMatches();
+    return failures == 0 ? 0 : 1;
+}
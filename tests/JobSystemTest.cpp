@@ -0,0 +1,119 @@
+#include "../JobSystem.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Behavior checks for JobSystem: results that must not depend on the
+// thread count, dependency order, and what the destructor does with jobs
+// still pending. Prints one line per check and exits nonzero on failure.
+namespace
+{
+    int failures = 0;
+
+    void Check( bool passed, const char* name )
+    {
+        std::printf( "%s %s\n", passed ? "ok  " : "FAIL", name );
+        failures += passed ? 0 : 1;
+    }
+
+    // Each range writes a running hash of its own elements, so a range run
+    // twice, skipped or cut differently changes the output
+    std::vector<std::uint32_t> HashRanges( unsigned int threads, int count, int grain )
+    {
+        JobSystem jobs( threads );
+        std::vector<std::uint32_t> out( std::size_t( count ), 0u );
+        std::uint32_t* pOut = out.data();
+        jobs.ParallelFor( count, grain, [pOut]( int first, int last )
+        {
+            std::uint32_t h = 2166136261u;
+            for( int i = first; i < last; ++i )
+            {
+                h = (h ^ std::uint32_t( i )) * 16777619u;
+                pOut[i] += h;
+            }
+        } );
+        return out;
+    }
+
+    void ParallelForMatchesSerial()
+    {
+        bool same = true;
+        for( const int count : { 1, 7, 1000, 100003 } )
+        {
+            const std::vector<std::uint32_t> serial = HashRanges( 1u, count, 97 );
+            for( const unsigned int threads : { 2u, 4u, 7u } )
+            {
+                same = same && HashRanges( threads, count, 97 ) == serial;
+            }
+        }
+        Check( same, "ParallelFor gives the same result on 1 and N threads" );
+    }
+
+    void DependentsRunAfterDependencies()
+    {
+        JobSystem jobs( 4u );
+        bool ordered = true;
+        for( int round = 0; round < 200; ++round )
+        {
+            // Diamond: top, then left and right in any order, then bottom
+            std::atomic<int> clock { 0 };
+            int top = -1;
+            int left = -1;
+            int right = -1;
+            int bottom = -1;
+            const JobSystem::Job a = jobs.Submit( [&] { top = clock++; } );
+            const JobSystem::Job b = jobs.Submit( [&] { left = clock++; }, { a } );
+            const JobSystem::Job c = jobs.Submit( [&] { right = clock++; }, { a } );
+            const JobSystem::Job d = jobs.Submit( [&] { bottom = clock++; }, { b, c } );
+            jobs.Wait( d );
+            ordered = ordered && top < left && top < right && left < bottom && right < bottom;
+        }
+        // A chain longer than the slot count, each link seeing the last
+        JobSystem small( 3u, 8 );
+        int value = 0;
+        bool chained = true;
+        JobSystem::Job previous;
+        for( int i = 0; i < 100; ++i )
+        {
+            previous = small.Submit( [&value, &chained, i]
+            {
+                chained = chained && value == i;
+                value = i + 1;
+            }, { previous } );
+        }
+        small.Wait( previous );
+        Check( ordered && chained && value == 100, "dependent jobs run after their dependencies" );
+    }
+
+    void DestructorRunsPendingJobs()
+    {
+        bool drained = true;
+        // One thread has no workers, so nothing runs before the destructor
+        for( const unsigned int threads : { 1u, 3u } )
+        {
+            auto token = std::make_shared<int>( 0 );
+            std::atomic<int> ran { 0 };
+            {
+                JobSystem jobs( threads, 64 );
+                JobSystem::Job previous;
+                for( int i = 0; i < 50; ++i )
+                {
+                    // Each callable holds a reference to token until destroyed
+                    previous = jobs.Submit( [token, &ran] { ran.fetch_add( 1 ); }, { previous } );
+                }
+            }
+            drained = drained && ran.load() == 50 && token.use_count() == 1;
+        }
+        Check( drained, "destructor runs and destroys pending jobs" );
+    }
+}
+
+int main()
+{
+    ParallelForMatchesSerial();
+    DependentsRunAfterDependencies();
+    DestructorRunsPendingJobs();
+    return failures == 0 ? 0 : 1;
+}